@@ -0,0 +1,316 @@
+/* fsbench.c - benchmarks the kernel's filesystem code on a Linux host
+ *
+ * Links student-distrib/filesys.c and block_cache.c (as fskern.o, see the Makefile), maps a
+ * filesystem image the way the bootloader hands it to the kernel and times the lookup, read
+ * and directory paths. Results go to stdout as one flat JSON object, so runs can be saved
+ * and compared between revisions without booting the kernel. For compressed images the block
+ * cache counters show how well the cache (CACHE_BLOCKS, settable through KDEFS) holds up.
+ *
+ * usage: fsbench [-t <ms per test>] [image]
+ *        image defaults to ../student-distrib/filesys_img
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* must match student-distrib/filesys.h */
+#define NAME_LEN            32
+#define FS_MAX_DENTRIES     4095
+#define MAX_FILE_BLOCKS     1023
+#define BLOCK_SIZE          4096
+#define REG_FILE            2
+#define FS_COMPRESSED       0x2
+
+#define DEFAULT_IMAGE       "../student-distrib/filesys_img"
+#define DEFAULT_MS          200
+#define CHUNK_SIZE          4096
+#define MISS_NAMES          64
+#define DIR_FD              2   /* descriptor the directory is opened in */
+
+typedef struct dentry {
+    uint8_t filename[NAME_LEN];
+    uint32_t filetype;
+    uint32_t inode_num;
+    uint8_t reserved[24];
+} dentry_t;
+
+/* must match student-distrib/block_cache.h */
+typedef struct cache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t flushes;
+    uint32_t writebacks;
+    uint32_t readaheads;
+} cache_stats_t;
+
+/* the kernel routines exported from fskern.o (fskern.syms) */
+extern void* cur_pcb;
+int32_t init_filesys(uint32_t* ptr);
+int32_t get_file_size(dentry_t* dentry);
+int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
+int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
+int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+int32_t dir_open(int32_t fd, const uint8_t* filename);
+int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t dir_getdents(int32_t fd, void* buf, int32_t nbytes);
+int32_t dir_close(int32_t fd);
+uint32_t get_fs_flags(void);
+void cache_get_stats(cache_stats_t* stats);
+
+/* one directory entry of the mounted image */
+typedef struct bench_entry {
+    char name[NAME_LEN + 1];
+    uint32_t type;
+    uint32_t inode;
+    uint32_t size;
+} bench_entry_t;
+
+static bench_entry_t entries[FS_MAX_DENTRIES];
+static uint32_t n_entries;
+static char miss_names[MISS_NAMES][NAME_LEN + 1];
+
+/* stands in for the running process's pcb; zeroed, so every fd starts closed */
+static uint64_t pcb_mem[8192 / sizeof(uint64_t)];
+static uint8_t data_buf[MAX_FILE_BLOCKS * BLOCK_SIZE];
+
+static double min_time;
+static uint32_t read_errors;
+
+/*
+ * now
+ * DESCRIPTION: reads the monotonic clock
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: seconds since an arbitrary point
+ */
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * load_entries
+ * DESCRIPTION: lists the mounted directory with read_dentry_by_index and records each entry
+ *              and its size, and makes up names that are not in the directory
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void load_entries(void) {
+    dentry_t dentry;
+    uint32_t idx;
+
+    for (n_entries = 0; n_entries < FS_MAX_DENTRIES && read_dentry_by_index(n_entries, &dentry) == 0; n_entries++) {
+        memcpy(entries[n_entries].name, dentry.filename, NAME_LEN);
+        entries[n_entries].name[NAME_LEN] = '\0';
+        entries[n_entries].type = dentry.filetype;
+        entries[n_entries].inode = dentry.inode_num;
+        entries[n_entries].size = get_file_size(&dentry);
+    }
+
+    for (idx = 0; idx < MISS_NAMES; idx++) {
+        snprintf(miss_names[idx], sizeof(miss_names[idx]), "fsbench.missing.%u", idx);
+    }
+}
+
+/*
+ * bench_lookup
+ * DESCRIPTION: looks up names with read_dentry_by_name for at least min_time
+ * INPUTS: hits: 1 to look up every name in the directory, 0 for names that are not there
+ * OUTPUTS: none
+ * RETURN VALUE: lookups per second
+ */
+static double bench_lookup(int hits) {
+    dentry_t dentry;
+    uint64_t ops = 0;
+    uint32_t idx;
+    uint32_t n_names = hits ? n_entries : MISS_NAMES;
+    double start = now();
+    double elapsed;
+
+    do {
+        for (idx = 0; idx < n_names; idx++) {
+            if (hits) {
+                if (read_dentry_by_name((const uint8_t*) entries[idx].name, &dentry) != 0) {
+                    read_errors++;
+                }
+            } else if (read_dentry_by_name((const uint8_t*) miss_names[idx], &dentry) == 0) {
+                read_errors++;
+            }
+        }
+        ops += n_names;
+    } while ((elapsed = now() - start) < min_time);
+
+    return ops / elapsed;
+}
+
+/*
+ * bench_read
+ * DESCRIPTION: reads every regular file with read_data for at least min_time
+ * INPUTS: chunk: bytes per read_data call, or 0 to read each file in one call
+ * OUTPUTS: none
+ * RETURN VALUE: megabytes (10^6 bytes) per second
+ */
+static double bench_read(uint32_t chunk) {
+    uint64_t bytes = 0;
+    uint32_t idx;
+    uint32_t offset;
+    uint32_t length;
+    int32_t ret;
+    double start = now();
+    double elapsed;
+
+    do {
+        for (idx = 0; idx < n_entries; idx++) {
+            if (entries[idx].type != REG_FILE) {
+                continue;
+            }
+            for (offset = 0; offset < entries[idx].size; offset += ret) {
+                length = entries[idx].size - offset;
+                if (chunk != 0 && length > chunk) {
+                    length = chunk;
+                }
+                ret = read_data(entries[idx].inode, offset, data_buf, length);
+                if (ret <= 0) {
+                    read_errors++;
+                    break;
+                }
+                bytes += ret;
+            }
+        }
+    } while ((elapsed = now() - start) < min_time || bytes == 0);
+
+    return bytes / elapsed / 1e6;
+}
+
+/*
+ * bench_dir
+ * DESCRIPTION: lists the directory through dir_open and dir_read or dir_getdents for at least
+ *              min_time
+ * INPUTS: getdents: 1 to use dir_getdents with a one-block buffer, 0 for dir_read
+ * OUTPUTS: none
+ * RETURN VALUE: microseconds per full listing
+ */
+static double bench_dir(int getdents) {
+    uint64_t listings = 0;
+    uint32_t seen;
+    int32_t ret;
+    double start = now();
+    double elapsed;
+
+    do {
+        if (dir_open(DIR_FD, (const uint8_t*) ".") != 0) {
+            read_errors++;
+            return 0;
+        }
+        seen = 0;
+        if (getdents) {
+            while ((ret = dir_getdents(DIR_FD, data_buf, BLOCK_SIZE)) > 0) {
+                seen++;
+            }
+        } else {
+            while ((ret = dir_read(DIR_FD, data_buf, NAME_LEN)) > 0) {
+                seen++;
+            }
+        }
+        if (ret < 0 || (!getdents && seen != n_entries)) {
+            read_errors++;
+        }
+        dir_close(DIR_FD);
+        listings++;
+    } while ((elapsed = now() - start) < min_time);
+
+    return elapsed * 1e6 / listings;
+}
+
+int main(int argc, char* argv[]) {
+    const char* image_name = DEFAULT_IMAGE;
+    struct stat st;
+    uint32_t* image;
+    uint32_t idx;
+    uint32_t n_files = 0;
+    uint64_t file_bytes = 0;
+    double mount_us;
+    double dir_read_us;
+    cache_stats_t stats;
+    int opt;
+    int fd;
+
+    min_time = DEFAULT_MS / 1e3;
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        if (opt == 't' && atoi(optarg) > 0) {
+            min_time = atoi(optarg) / 1e3;
+        } else {
+            fprintf(stderr, "usage: %s [-t <ms per test>] [image]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc) {
+        image_name = argv[optind];
+    }
+
+    /* a private writable mapping, like the image the kernel gets from the bootloader */
+    if ((fd = open(image_name, O_RDONLY)) < 0 || fstat(fd, &st) != 0) {
+        perror(image_name);
+        return 1;
+    }
+    image = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror(image_name);
+        return 1;
+    }
+
+    cur_pcb = pcb_mem;
+    mount_us = now();
+    if (init_filesys(image) != 0) {
+        fprintf(stderr, "fsbench: %s: not a valid filesystem image\n", image_name);
+        return 1;
+    }
+    mount_us = (now() - mount_us) * 1e6;
+
+    load_entries();
+    for (idx = 0; idx < n_entries; idx++) {
+        if (entries[idx].type == REG_FILE) {
+            n_files++;
+            file_bytes += entries[idx].size;
+        }
+    }
+
+    printf("{\n");
+    printf("  \"image\": \"%s\",\n", image_name);
+    printf("  \"image_bytes\": %lld,\n", (long long) st.st_size);
+    printf("  \"inodes\": %u,\n", image[1]);
+    printf("  \"data_blocks\": %u,\n", image[2]);
+    printf("  \"entries\": %u,\n", n_entries);
+    printf("  \"files\": %u,\n", n_files);
+    printf("  \"file_bytes\": %llu,\n", (unsigned long long) file_bytes);
+    printf("  \"mount_us\": %.1f,\n", mount_us);
+    printf("  \"lookup_hits_per_sec\": %.0f,\n", bench_lookup(1));
+    printf("  \"lookup_misses_per_sec\": %.0f,\n", bench_lookup(0));
+    printf("  \"read_data_mb_per_sec\": %.1f,\n", bench_read(0));
+    printf("  \"read_data_4k_mb_per_sec\": %.1f,\n", bench_read(CHUNK_SIZE));
+    dir_read_us = bench_dir(0);
+    printf("  \"dir_read_us\": %.2f,\n", dir_read_us);
+    printf("  \"dir_read_ns_per_entry\": %.1f,\n", n_entries ? dir_read_us * 1e3 / n_entries : 0.0);
+    printf("  \"getdents_us\": %.2f,\n", bench_dir(1));
+    cache_get_stats(&stats);
+    printf("  \"compressed\": %u,\n", (get_fs_flags() & FS_COMPRESSED) ? 1 : 0);
+    printf("  \"cache_hits\": %u,\n", stats.hits);
+    printf("  \"cache_misses\": %u,\n", stats.misses);
+    printf("  \"cache_evictions\": %u,\n", stats.evictions);
+    printf("  \"errors\": %u\n", read_errors);
+    printf("}\n");
+
+    return read_errors != 0;
+}
@@ -0,0 +1,93 @@
+/* fskhost.c - host versions of the lib.c routines used by filesys.c and block_cache.c
+ *
+ * The kernel's lib.c copies and fills memory with inline asm written for i386 addresses
+ * (%edi/%esi), which truncates 64-bit host pointers, and its other routines would clash
+ * with the C library. These do the same work with the same signatures and are built
+ * -nostdinc against the kernel headers; the Makefile localizes them in fskern.o so the
+ * benchmark's own libc calls never reach them. file_mmap stands in for the one mmap.c
+ * routine filesys.c refers to.
+ */
+
+#include "types.h"
+
+/* strlen: length of a NUL-terminated string, as in lib.c */
+uint32_t strlen(const int8_t* s) {
+    uint32_t len = 0;
+    while (s[len] != '\0')
+        len++;
+    return len;
+}
+
+/* memset: fills the unaligned head and tail bytewise and the rest with rep stosl, as in lib.c */
+void* memset(void* s, int32_t c, uint32_t n) {
+    uint8_t* dst = (uint8_t*) s;
+    unsigned long words;
+    uint32_t fill;
+
+    c &= 0xFF;
+    while (n != 0 && ((unsigned long) dst & 0x3) != 0) {
+        *dst++ = c;
+        n--;
+    }
+    fill = c * 0x01010101;
+    words = n >> 2;
+    asm volatile ("cld; rep stosl"
+            : "+D" (dst), "+c" (words)
+            : "a" (fill)
+            : "memory", "cc");
+    for (n &= 0x3; n != 0; n--) {
+        *dst++ = c;
+    }
+    return s;
+}
+
+/* memcpy: copies the unaligned head and tail bytewise and the rest with rep movsl, as in lib.c */
+void* memcpy(void* dest, const void* src, uint32_t n) {
+    uint8_t* dst = (uint8_t*) dest;
+    const uint8_t* from = (const uint8_t*) src;
+    unsigned long words;
+
+    while (n != 0 && ((unsigned long) dst & 0x3) != 0) {
+        *dst++ = *from++;
+        n--;
+    }
+    words = n >> 2;
+    asm volatile ("cld; rep movsl"
+            : "+D" (dst), "+S" (from), "+c" (words)
+            :
+            : "memory", "cc");
+    for (n &= 0x3; n != 0; n--) {
+        *dst++ = *from++;
+    }
+    return dest;
+}
+
+/* strncmp: compares at most n characters, as in lib.c */
+int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if ((s1[i] != s2[i]) || (s1[i] == '\0')) {
+            return s1[i] - s2[i];
+        }
+    }
+    return 0;
+}
+
+/* strncpy: copies at most n characters and pads dest with NULs, as in lib.c */
+int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
+    uint32_t i = 0;
+    while (src[i] != '\0' && i < n) {
+        dest[i] = src[i];
+        i++;
+    }
+    while (i < n) {
+        dest[i] = '\0';
+        i++;
+    }
+    return dest;
+}
+
+/* file_mmap: mapping needs the kernel's page tables (mmap.c); the host can't map files */
+int32_t file_mmap(int32_t fd, uint8_t** start) {
+    return -1;
+}
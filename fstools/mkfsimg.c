@@ -0,0 +1,869 @@
+/* mkfsimg.c - builds a filesystem image for the kernel from a directory of files
+ *
+ * The image uses the format read by student-distrib/filesys.c: a 4kB boot block with
+ * the statistics header and up to 63 dentries, N 4kB inodes, then D 4kB data blocks.
+ * Directories with more entries than fit in the boot block continue in chained
+ * directory data blocks (see bblock_t in filesys.h).
+ *
+ * Files are sorted by name, numbered in that order and given contiguous data blocks in the
+ * same order, so a file's data is one run and the dentries, inodes and data of a directory
+ * listing are all walked front to back. A layout report for the new image (or, with -r, for
+ * an existing one such as a createfs image) shows how fragmented the file data is.
+ *
+ * With -z the image is written compressed: each inode and data block is packed on its own
+ * in the LZ format of student-distrib/lz.h behind a table of block offsets (see filesys.h),
+ * which the kernel unpacks into its block cache as files are read.
+ *
+ * usage: mkfsimg -i <input dir> -o <output image> [-n <inodes>] [-s <spare blocks>] [-z] [-v]
+ *        mkfsimg -r <image> [-v]
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* must match student-distrib/filesys.h */
+#define BLOCK_SIZE          4096
+#define NAME_LEN            32
+#define DENTRY_SIZE         64
+#define MAX_DENTRIES        63
+#define FS_MAX_DIR_BLOCKS   64
+#define FS_MAX_DENTRIES     (MAX_DENTRIES*(FS_MAX_DIR_BLOCKS + 1))
+#define MAX_FILE_BLOCKS     1023
+#define FS_MAX_INODES       4096
+#define FS_MAX_BLOCKS       16384
+#define DIR_NEXT_OFFSET     3
+#define FS_Z_MAGIC_OFFSET   4
+#define FS_Z_MAGIC          0x315A5346
+
+/* must match student-distrib/lz.h */
+#define LZ_MIN_MATCH        4
+#define LZ_NIBBLE_MAX       15
+#define LZ_MAX_OFFSET       0xFFFF
+#define LZ_HASH_BITS        12
+
+#define RTC_FILE            0
+#define DIR_FILE            1
+#define REG_FILE            2
+
+#define FS_REV_OFFSET       5
+#define FS_REV_SHARED       1
+#define INODE_INLINE        0x80000000
+#define INODE_LENGTH_MASK   0x7FFFFFFF
+#define FS_INLINE_MAX       (BLOCK_SIZE - 4)
+
+#define DEFAULT_INODES      64
+#define NO_BLOCK            0xFFFFFFFF
+#define FIXED_ENTRIES       2   /* "." and "rtc" lead the directory */
+
+/* one directory entry of the image being built */
+typedef struct fs_entry {
+    char name[NAME_LEN + 1];    /* name as stored, cut to NAME_LEN characters       */
+    uint32_t type;              /* RTC_FILE, DIR_FILE or REG_FILE                   */
+    uint32_t inode;             /* inode number for regular files                   */
+    char* path;                 /* host path of a regular file                      */
+    uint32_t length;            /* size of a regular file                           */
+} fs_entry_t;
+
+/* how to lay out the image being built */
+typedef struct image_opts {
+    uint32_t n_inodes;          /* inodes in the image (at least one per file)      */
+    uint32_t n_spare;           /* free data blocks to add at the end               */
+    uint32_t inline_max;        /* largest file stored in its inode, 0 for none     */
+    int share;                  /* store each distinct data block once              */
+    int compress;               /* write the image compressed                       */
+    int verbose;                /* list every file in the layout report             */
+} image_opts_t;
+
+static fs_entry_t entries[FS_MAX_DENTRIES];
+static uint32_t n_entries;
+
+/*
+ * add_entry
+ * DESCRIPTION: appends an entry to the directory of the image
+ * INPUTS: name: file name, cut to NAME_LEN characters
+ *         type: file type
+ * OUTPUTS: none
+ * RETURN VALUE: the new entry, or NULL if the directory is full
+ */
+static fs_entry_t* add_entry(const char* name, uint32_t type) {
+    fs_entry_t* entry;
+
+    if (n_entries >= FS_MAX_DENTRIES) {
+        fprintf(stderr, "mkfsimg: more than %d directory entries\n", FS_MAX_DENTRIES);
+        return NULL;
+    }
+    entry = &entries[n_entries++];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->name, name, NAME_LEN);
+    entry->type = type;
+    return entry;
+}
+
+/*
+ * compare_entries
+ * DESCRIPTION: qsort comparison putting entries in name order
+ * INPUTS: a, b: entries to compare
+ * OUTPUTS: none
+ * RETURN VALUE: <0, 0 or >0 as a sorts before, with or after b
+ */
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const fs_entry_t*) a)->name, ((const fs_entry_t*) b)->name);
+}
+
+/*
+ * scan_dir
+ * DESCRIPTION: adds "." and "rtc" and then every regular file of the input directory, sorted
+ *              by name, to the directory of the image
+ * INPUTS: dir_name: input directory
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+static int scan_dir(const char* dir_name) {
+    DIR* dir;
+    struct dirent* de;
+    struct stat st;
+    fs_entry_t* entry;
+    char* path;
+    uint32_t n_files = 0;
+    uint32_t idx;
+
+    if (add_entry(".", DIR_FILE) == NULL || add_entry("rtc", RTC_FILE) == NULL) {
+        return -1;
+    }
+
+    if ((dir = opendir(dir_name)) == NULL) {
+        perror(dir_name);
+        return -1;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if ((path = malloc(strlen(dir_name) + strlen(de->d_name) + 2)) == NULL) {
+            closedir(dir);
+            return -1;
+        }
+        sprintf(path, "%s/%s", dir_name, de->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+        if (st.st_size > (off_t) MAX_FILE_BLOCKS*BLOCK_SIZE) {
+            fprintf(stderr, "mkfsimg: %s is larger than %d blocks\n", path, MAX_FILE_BLOCKS);
+            closedir(dir);
+            return -1;
+        }
+        if ((entry = add_entry(de->d_name, REG_FILE)) == NULL) {
+            closedir(dir);
+            return -1;
+        }
+        entry->path = path;
+        entry->length = st.st_size;
+    }
+    closedir(dir);
+
+    /* files are numbered in name order, so inode and data order follow the directory */
+    qsort(entries + FIXED_ENTRIES, n_entries - FIXED_ENTRIES, sizeof(fs_entry_t), compare_entries);
+    for (idx = FIXED_ENTRIES; idx < n_entries; idx++) {
+        entries[idx].inode = n_files++;
+    }
+
+    return 0;
+}
+
+/*
+ * report_compressed
+ * DESCRIPTION: prints how well a compressed image packed, from its block offset table
+ * INPUTS: name: image name for the report
+ *         image: the whole compressed image
+ *         size: bytes in it
+ * OUTPUTS: the report on stdout
+ * RETURN VALUE: 0 if the table is consistent, -1 otherwise
+ */
+static int report_compressed(const char* name, const uint8_t* image, size_t size) {
+    const uint32_t* words = (const uint32_t*) image;
+    const uint32_t* offsets = words + BLOCK_SIZE/4;
+    uint32_t n_blocks = words[1] + words[2];
+    uint32_t n_raw = 0;
+    uint32_t idx;
+
+    if ((uint64_t) BLOCK_SIZE + (uint64_t) (n_blocks + 1)*4 > size || offsets[n_blocks] > size) {
+        fprintf(stderr, "mkfsimg: %s: truncated compressed image\n", name);
+        return -1;
+    }
+    for (idx = 0; idx < n_blocks; idx++) {
+        if (offsets[idx + 1] < offsets[idx]) {
+            fprintf(stderr, "mkfsimg: %s: block offset table out of order at block %u\n", name, idx + 1);
+            return -1;
+        }
+        n_raw += (offsets[idx + 1] - offsets[idx] >= BLOCK_SIZE);
+    }
+
+    printf("%s: compressed, %u inodes and %u data blocks (%u stored unpacked) in %u bytes, %.1f%% of %llu\n",
+           name, words[1], words[2], n_raw, offsets[n_blocks],
+           100.0 * offsets[n_blocks] / ((uint64_t) (1 + n_blocks) * BLOCK_SIZE),
+           (unsigned long long) (1 + n_blocks) * BLOCK_SIZE);
+    return 0;
+}
+
+/*
+ * report_image
+ * DESCRIPTION: walks the directory of an image and prints how its file data is laid out:
+ *              the runs (extents) of consecutive blocks each file's data takes, how many
+ *              files are split into several runs, how many files in directory order start
+ *              right where the previous one ended, the files stored inline in their inode,
+ *              and the free, shared and invalid blocks
+ * INPUTS: name: image name for the report
+ *         image: the whole image
+ *         size: bytes in the image
+ *         verbose: also print one line per file
+ * OUTPUTS: the report on stdout
+ * RETURN VALUE: 0 if the image is consistent, -1 if it is truncated or has invalid references
+ */
+static int report_image(const char* name, const uint8_t* image, size_t size, int verbose) {
+    const uint32_t* words = (const uint32_t*) image;
+    const uint32_t* inode_ptr;
+    const uint8_t* dir_block;
+    const uint8_t* dentry_ptr;
+    const uint8_t* data;
+    uint8_t* refs;
+    uint32_t n_inodes, n_data;
+    uint32_t n_dir_blocks = 1;
+    uint32_t count, next;
+    uint32_t idx, block_idx, block;
+    uint32_t n_blocks, extents, last_block = 0;
+    uint32_t n_dentries = 0, n_files = 0, n_with_data = 0;
+    uint32_t file_blocks = 0, total_extents = 0, fragmented = 0, max_extents = 0;
+    uint32_t transitions = 0, sequential = 0, have_last = 0;
+    uint32_t n_free = 0, n_shared = 0, n_invalid = 0, n_inline = 0;
+    uint32_t length, is_inline;
+    char file_name[NAME_LEN + 1];
+
+    if (size < BLOCK_SIZE) {
+        fprintf(stderr, "mkfsimg: %s: no boot block\n", name);
+        return -1;
+    }
+    n_inodes = words[1];
+    n_data = words[2];
+    if (words[FS_Z_MAGIC_OFFSET] == FS_Z_MAGIC) {
+        return report_compressed(name, image, size);
+    }
+    if ((uint64_t) (1 + n_inodes + n_data) * BLOCK_SIZE > size) {
+        fprintf(stderr, "mkfsimg: %s: truncated, %u inodes and %u data blocks need %llu bytes\n", name,
+                n_inodes, n_data, (unsigned long long) (1 + n_inodes + n_data) * BLOCK_SIZE);
+        return -1;
+    }
+    data = image + (size_t) (1 + n_inodes) * BLOCK_SIZE;
+    /* references to each data block, saturating at 2 */
+    if ((refs = calloc(n_data + 1, 1)) == NULL) {
+        return -1;
+    }
+
+    for (dir_block = image; ; n_dir_blocks++) {
+        count = ((const uint32_t*) dir_block)[0];
+        if (count > MAX_DENTRIES) {
+            n_invalid++;
+            break;
+        }
+        for (idx = 0; idx < count; idx++, n_dentries++) {
+            dentry_ptr = dir_block + DENTRY_SIZE * (idx + 1);
+            if (((const uint32_t*) dentry_ptr)[8] != REG_FILE) {
+                continue;
+            }
+            if (((const uint32_t*) dentry_ptr)[9] >= n_inodes) {
+                n_invalid++;
+                continue;
+            }
+            inode_ptr = (const uint32_t*) (image + (size_t) (1 + ((const uint32_t*) dentry_ptr)[9]) * BLOCK_SIZE);
+            length = inode_ptr[0] & INODE_LENGTH_MASK;
+            is_inline = (inode_ptr[0] & INODE_INLINE) != 0;
+            n_blocks = is_inline ? 0 : (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            if (n_blocks > MAX_FILE_BLOCKS || (is_inline && (words[FS_REV_OFFSET] < FS_REV_SHARED || length > FS_INLINE_MAX))) {
+                n_invalid++;
+                continue;
+            }
+
+            extents = 0;
+            for (block_idx = 0; block_idx < n_blocks; block_idx++) {
+                block = inode_ptr[1 + block_idx];
+                if (block >= n_data) {
+                    n_invalid++;
+                    continue;
+                }
+                if (refs[block] < 2) {
+                    refs[block]++;
+                }
+                if (block_idx == 0 || block != last_block + 1) {
+                    extents++;
+                }
+                if (block_idx == 0 && have_last) {
+                    transitions++;
+                    sequential += (block == last_block + 1);
+                }
+                last_block = block;
+            }
+
+            n_files++;
+            n_inline += is_inline;
+            if (n_blocks != 0) {
+                n_with_data++;
+                have_last = 1;
+            }
+            file_blocks += n_blocks;
+            total_extents += extents;
+            fragmented += (extents > 1);
+            if (extents > max_extents) {
+                max_extents = extents;
+            }
+            if (verbose) {
+                memcpy(file_name, dentry_ptr, NAME_LEN);
+                file_name[NAME_LEN] = '\0';
+                printf("  %-32s inode %4u %8u bytes %4u blocks %3u extents",
+                       file_name, ((const uint32_t*) dentry_ptr)[9], length, n_blocks, extents);
+                if (is_inline) {
+                    printf(", inline");
+                }
+                else if (n_blocks != 0) {
+                    printf(", first block %u", inode_ptr[1]);
+                }
+                printf("\n");
+            }
+        }
+
+        /* chained directory blocks count as used data blocks */
+        next = ((const uint32_t*) dir_block)[DIR_NEXT_OFFSET];
+        if (next == 0) {
+            break;
+        }
+        if (next - 1 >= n_data || n_dir_blocks > FS_MAX_DIR_BLOCKS) {
+            n_invalid++;
+            break;
+        }
+        refs[next - 1] = 2;
+        dir_block = data + (size_t) (next - 1) * BLOCK_SIZE;
+    }
+
+    for (block = 0; block < n_data; block++) {
+        n_free += (refs[block] == 0);
+        n_shared += (refs[block] > 1);
+    }
+    free(refs);
+    n_shared -= n_dir_blocks - 1;
+
+    printf("%s: %u entries in %u directory blocks, %u files, %u inodes, %u data blocks\n",
+           name, n_dentries, n_dir_blocks, n_files, n_inodes, n_data);
+    printf("  file data: %u blocks in %u extents, %.2f extents per file, %u fragmented files (at most %u extents)\n",
+           file_blocks, total_extents, n_with_data ? (double) total_extents / n_with_data : 0.0, fragmented, max_extents);
+    printf("  directory order: %u of %u files start right after the previous file's data\n",
+           sequential, transitions);
+    printf("  revision %u: %u files inline\n", words[FS_REV_OFFSET], n_inline);
+    printf("  blocks: %u free, %u shared, %u invalid references\n", n_free, n_shared, n_invalid);
+
+    return (n_invalid == 0) ? 0 : -1;
+}
+
+/*
+ * put_length
+ * DESCRIPTION: writes the extra bytes of a literal or match length whose nibble was
+ *              LZ_NIBBLE_MAX
+ * INPUTS: len: what is left of the length after the nibble
+ *         dst, out, max: output buffer, write position (advanced) and its size
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the output is full
+ */
+static int put_length(uint32_t len, uint8_t* dst, uint32_t* out, uint32_t max) {
+    for (; len >= 255; len -= 255) {
+        if (*out >= max) {
+            return -1;
+        }
+        dst[(*out)++] = 255;
+    }
+    if (*out >= max) {
+        return -1;
+    }
+    dst[(*out)++] = len;
+    return 0;
+}
+
+/*
+ * put_sequence
+ * DESCRIPTION: writes one sequence: token, literals and, unless match_len is 0, the match
+ * INPUTS: lit: literal bytes; n_lit: how many
+ *         offset, match_len: distance back to the match and its length
+ *         dst, out, max: output buffer, write position (advanced) and its size
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the output is full
+ */
+static int put_sequence(const uint8_t* lit, uint32_t n_lit, uint32_t offset, uint32_t match_len,
+                        uint8_t* dst, uint32_t* out, uint32_t max) {
+    uint32_t match_code = (match_len != 0) ? match_len - LZ_MIN_MATCH : 0;
+    uint8_t token;
+
+    token = ((n_lit < LZ_NIBBLE_MAX) ? n_lit : LZ_NIBBLE_MAX) << 4;
+    token |= (match_code < LZ_NIBBLE_MAX) ? match_code : LZ_NIBBLE_MAX;
+    if (*out >= max) {
+        return -1;
+    }
+    dst[(*out)++] = token;
+    if (n_lit >= LZ_NIBBLE_MAX && put_length(n_lit - LZ_NIBBLE_MAX, dst, out, max) != 0) {
+        return -1;
+    }
+    if (n_lit > max - *out) {
+        return -1;
+    }
+    memcpy(dst + *out, lit, n_lit);
+    *out += n_lit;
+
+    if (match_len == 0) {
+        return 0;
+    }
+    if (max - *out < 2) {
+        return -1;
+    }
+    dst[(*out)++] = offset & 0xFF;
+    dst[(*out)++] = offset >> 8;
+    if (match_code >= LZ_NIBBLE_MAX && put_length(match_code - LZ_NIBBLE_MAX, dst, out, max) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * lz_compress_block
+ * DESCRIPTION: packs one block, greedily taking the match found through a hash of the next
+ *              LZ_MIN_MATCH bytes
+ * INPUTS: src: BLOCK_SIZE bytes to pack
+ *         dst: output buffer
+ *         max: size of dst
+ * OUTPUTS: none
+ * RETURN VALUE: packed length, or 0 if it doesn't fit in max bytes
+ */
+static uint32_t lz_compress_block(const uint8_t* src, uint8_t* dst, uint32_t max) {
+    int32_t table[1 << LZ_HASH_BITS];
+    uint32_t pos = 0;
+    uint32_t anchor = 0;
+    uint32_t out = 0;
+    uint32_t hash;
+    uint32_t len;
+    int32_t cand;
+
+    memset(table, -1, sizeof(table));
+    while (pos + LZ_MIN_MATCH <= BLOCK_SIZE) {
+        hash = ((src[pos] | src[pos + 1] << 8 | src[pos + 2] << 16 | (uint32_t) src[pos + 3] << 24)
+                * 2654435761U) >> (32 - LZ_HASH_BITS);
+        cand = table[hash];
+        table[hash] = pos;
+        if (cand < 0 || pos - cand > LZ_MAX_OFFSET || memcmp(src + cand, src + pos, LZ_MIN_MATCH) != 0) {
+            pos++;
+            continue;
+        }
+
+        for (len = LZ_MIN_MATCH; pos + len < BLOCK_SIZE && src[cand + len] == src[pos + len]; len++) {
+        }
+        if (put_sequence(src + anchor, pos - anchor, pos - cand, len, dst, &out, max) != 0) {
+            return 0;
+        }
+        pos += len;
+        anchor = pos;
+    }
+
+    /* the last literals fill the block */
+    if (anchor < BLOCK_SIZE && put_sequence(src + anchor, BLOCK_SIZE - anchor, 0, 0, dst, &out, max) != 0) {
+        return 0;
+    }
+    return out;
+}
+
+/*
+ * compress_image
+ * DESCRIPTION: packs a built image: the boot block as is but marked with FS_Z_MAGIC, the table
+ *              of block offsets, then each inode and data block packed on its own, or stored
+ *              unpacked if packing doesn't save anything; chained directory blocks are always
+ *              stored unpacked so the kernel can read their dentries in place
+ * INPUTS: image: the uncompressed image
+ *         n_inodes, n_data: inodes and data blocks in it
+ *         n_dir_blocks: chained directory blocks, which are data blocks 0 on
+ *         z_size: set to the size of the compressed image
+ * OUTPUTS: none
+ * RETURN VALUE: the compressed image, or NULL if out of memory
+ */
+static uint8_t* compress_image(const uint8_t* image, uint32_t n_inodes, uint32_t n_data,
+                               uint32_t n_dir_blocks, size_t* z_size) {
+    uint32_t n_blocks = n_inodes + n_data;
+    uint32_t* offsets;
+    uint8_t* z_image;
+    const uint8_t* block;
+    size_t pos;
+    uint32_t idx;
+    uint32_t len;
+
+    /* worst case every block is stored unpacked */
+    z_image = calloc(1, BLOCK_SIZE + (size_t) (n_blocks + 1)*4 + (size_t) n_blocks*BLOCK_SIZE);
+    if (z_image == NULL) {
+        return NULL;
+    }
+    memcpy(z_image, image, BLOCK_SIZE);
+    ((uint32_t*) z_image)[FS_Z_MAGIC_OFFSET] = FS_Z_MAGIC;
+    offsets = (uint32_t*) (z_image + BLOCK_SIZE);
+
+    pos = BLOCK_SIZE + (size_t) (n_blocks + 1)*4;
+    for (idx = 0; idx < n_blocks; idx++) {
+        offsets[idx] = pos;
+        block = image + (size_t) (1 + idx)*BLOCK_SIZE;
+        len = 0;
+        if (idx < n_inodes || idx - n_inodes >= n_dir_blocks) {
+            /* packed blocks must come out shorter than BLOCK_SIZE even after padding */
+            len = lz_compress_block(block, z_image + pos, BLOCK_SIZE - 4);
+        }
+        if (len == 0) {
+            memcpy(z_image + pos, block, BLOCK_SIZE);
+            len = BLOCK_SIZE;
+        }
+        pos += (len + 3) & ~3;
+    }
+    offsets[n_blocks] = pos;
+
+    *z_size = pos;
+    return z_image;
+}
+
+/*
+ * find_block
+ * DESCRIPTION: looks for a data block already in the image with the same contents
+ * INPUTS: data: the data blocks of the image
+ *         block: contents to look for
+ *         hash: FNV-1a hash of block
+ *         heads, next: hash table over the blocks stored so far
+ *         n_buckets: buckets in heads, a power of two
+ * OUTPUTS: none
+ * RETURN VALUE: data block number, or NO_BLOCK if there's no such block
+ */
+static uint32_t find_block(const uint8_t* data, const uint8_t* block, uint32_t hash,
+                           const uint32_t* heads, const uint32_t* next, uint32_t n_buckets) {
+    uint32_t cand;
+
+    for (cand = heads[hash & (n_buckets - 1)]; cand != NO_BLOCK; cand = next[cand]) {
+        if (memcmp(data + (size_t) cand*BLOCK_SIZE, block, BLOCK_SIZE) == 0) {
+            return cand;
+        }
+    }
+    return NO_BLOCK;
+}
+
+/*
+ * hash_block
+ * DESCRIPTION: hashes the contents of a data block (FNV-1a)
+ * INPUTS: block: BLOCK_SIZE bytes
+ * OUTPUTS: none
+ * RETURN VALUE: the hash
+ */
+static uint32_t hash_block(const uint8_t* block) {
+    uint32_t hash = 2166136261U;
+    uint32_t idx;
+
+    for (idx = 0; idx < BLOCK_SIZE; idx++) {
+        hash = (hash ^ block[idx]) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * write_image
+ * DESCRIPTION: lays out the image and writes it: the boot block, the inodes, the chained
+ *              directory blocks, each file's data blocks in directory order, then any spare
+ *              blocks left free for the kernel to allocate. With opts->share a block whose
+ *              contents are already in the image points at that copy instead, and files of at
+ *              most opts->inline_max bytes are stored in their inode; either makes the image
+ *              revision FS_REV_SHARED
+ * INPUTS: out_name: output image
+ *         opts: layout options
+ * OUTPUTS: a summary and layout report on stdout
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+static int write_image(const char* out_name, const image_opts_t* opts) {
+    uint8_t* image;
+    uint8_t* data;
+    uint8_t* file_buf;
+    uint32_t* words;
+    uint32_t* inode_ptr;
+    uint8_t* dentry_ptr;
+    uint8_t* dir_block;
+    uint32_t* heads = NULL;
+    uint32_t* next = NULL;
+    uint32_t n_buckets = 1;
+    uint32_t n_dir_blocks;
+    uint32_t n_data;
+    uint32_t next_block;
+    uint32_t n_shared = 0;
+    uint32_t n_inline = 0;
+    uint32_t idx;
+    uint32_t block_idx;
+    uint32_t n_blocks;
+    uint32_t hash;
+    uint32_t block;
+    size_t size;
+    uint8_t* z_image = NULL;
+    size_t z_size = 0;
+    FILE* in;
+    FILE* out;
+
+    /* room for every block; sharing only makes the image shorter */
+    n_dir_blocks = (n_entries + MAX_DENTRIES - 1) / MAX_DENTRIES - 1;
+    n_data = n_dir_blocks + opts->n_spare;
+    for (idx = 0; idx < n_entries; idx++) {
+        n_data += (entries[idx].length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+
+    size = (size_t) (1 + opts->n_inodes + n_data) * BLOCK_SIZE;
+    image = calloc(1, size);
+    file_buf = malloc((size_t) MAX_FILE_BLOCKS * BLOCK_SIZE);
+    if (opts->share) {
+        while (n_buckets < 2*n_data) {
+            n_buckets <<= 1;
+        }
+        heads = malloc(n_buckets * sizeof(uint32_t));
+        next = malloc((n_data + 1) * sizeof(uint32_t));
+    }
+    if (image == NULL || file_buf == NULL || (opts->share && (heads == NULL || next == NULL))) {
+        free(image);
+        free(file_buf);
+        free(heads);
+        free(next);
+        return -1;
+    }
+    if (opts->share) {
+        memset(heads, 0xFF, n_buckets * sizeof(uint32_t));
+    }
+    words = (uint32_t*) image;
+    words[1] = opts->n_inodes;
+    if (opts->share || opts->inline_max != 0) {
+        words[FS_REV_OFFSET] = FS_REV_SHARED;
+    }
+    data = image + (size_t) (1 + opts->n_inodes) * BLOCK_SIZE;
+
+    /* dentries fill the boot block, then each chained directory block, 63 at a time */
+    dir_block = image;
+    for (idx = 0; idx < n_entries; idx++) {
+        if (idx != 0 && idx % MAX_DENTRIES == 0) {
+            /* chained directory block k is data block k - 1, linked from the one before as k */
+            ((uint32_t*) dir_block)[DIR_NEXT_OFFSET] = idx / MAX_DENTRIES;
+            dir_block = data + (size_t) (idx / MAX_DENTRIES - 1) * BLOCK_SIZE;
+        }
+        ((uint32_t*) dir_block)[0]++;
+        dentry_ptr = dir_block + DENTRY_SIZE * (idx % MAX_DENTRIES + 1);
+        memcpy(dentry_ptr, entries[idx].name, strlen(entries[idx].name));
+        ((uint32_t*) dentry_ptr)[8] = entries[idx].type;
+        ((uint32_t*) dentry_ptr)[9] = entries[idx].inode;
+    }
+
+    /* file data follows the directory blocks */
+    next_block = n_dir_blocks;
+    for (idx = 0; idx < n_entries; idx++) {
+        if (entries[idx].type != REG_FILE) {
+            continue;
+        }
+        inode_ptr = (uint32_t*) (image + (1 + entries[idx].inode) * BLOCK_SIZE);
+        inode_ptr[0] = entries[idx].length;
+        n_blocks = (entries[idx].length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        if ((in = fopen(entries[idx].path, "rb")) == NULL) {
+            perror(entries[idx].path);
+            break;
+        }
+        memset(file_buf, 0, (size_t) n_blocks * BLOCK_SIZE);
+        if (fread(file_buf, 1, entries[idx].length, in) != entries[idx].length) {
+            fprintf(stderr, "mkfsimg: short read on %s\n", entries[idx].path);
+            fclose(in);
+            break;
+        }
+        fclose(in);
+
+        if (entries[idx].length != 0 && entries[idx].length <= opts->inline_max) {
+            memcpy(inode_ptr + 1, file_buf, entries[idx].length);
+            inode_ptr[0] |= INODE_INLINE;
+            n_inline++;
+            continue;
+        }
+
+        for (block_idx = 0; block_idx < n_blocks; block_idx++) {
+            block = NO_BLOCK;
+            if (opts->share) {
+                hash = hash_block(file_buf + (size_t) block_idx * BLOCK_SIZE);
+                block = find_block(data, file_buf + (size_t) block_idx * BLOCK_SIZE, hash, heads, next, n_buckets);
+            }
+            if (block != NO_BLOCK) {
+                n_shared++;
+            }
+            else {
+                block = next_block++;
+                memcpy(data + (size_t) block * BLOCK_SIZE, file_buf + (size_t) block_idx * BLOCK_SIZE, BLOCK_SIZE);
+                if (opts->share) {
+                    next[block] = heads[hash & (n_buckets - 1)];
+                    heads[hash & (n_buckets - 1)] = block;
+                }
+            }
+            inode_ptr[1 + block_idx] = block;
+        }
+    }
+    free(file_buf);
+    free(heads);
+    free(next);
+    if (idx != n_entries) {
+        free(image);
+        return -1;
+    }
+
+    /* the spare blocks follow the last block used, already zeroed */
+    n_data = next_block + opts->n_spare;
+    words[2] = n_data;
+    size = (size_t) (1 + opts->n_inodes + n_data) * BLOCK_SIZE;
+    if (n_data > FS_MAX_BLOCKS) {
+        fprintf(stderr, "mkfsimg: warning: more than %d data blocks, the kernel mounts it read-only\n", FS_MAX_BLOCKS);
+    }
+
+    if (opts->compress && (z_image = compress_image(image, opts->n_inodes, n_data, n_dir_blocks, &z_size)) == NULL) {
+        free(image);
+        return -1;
+    }
+
+    if ((out = fopen(out_name, "wb")) == NULL) {
+        perror(out_name);
+        free(image);
+        free(z_image);
+        return -1;
+    }
+    if (fwrite(opts->compress ? z_image : image, 1, opts->compress ? z_size : size, out) !=
+        (opts->compress ? z_size : size)) {
+        fprintf(stderr, "mkfsimg: short write on %s\n", out_name);
+        fclose(out);
+        free(image);
+        free(z_image);
+        return -1;
+    }
+    fclose(out);
+
+    printf("%s: %u entries (%u directory blocks), %u inodes, %u data blocks (%u spare)",
+           out_name, n_entries, n_dir_blocks + 1, opts->n_inodes, n_data, opts->n_spare);
+    if (words[FS_REV_OFFSET] == FS_REV_SHARED) {
+        printf(", %u file blocks stored once, %u files inline", n_shared, n_inline);
+    }
+    printf("\n");
+    report_image(out_name, image, size, opts->verbose);
+    if (opts->compress) {
+        report_image(out_name, z_image, z_size, opts->verbose);
+    }
+    free(image);
+    free(z_image);
+    return 0;
+}
+
+/*
+ * report_file
+ * DESCRIPTION: loads an existing image and prints its layout report
+ * INPUTS: name: image to read
+ *         verbose: list every file in the report
+ * OUTPUTS: the layout report on stdout
+ * RETURN VALUE: 0 if the image is consistent, -1 otherwise
+ */
+static int report_file(const char* name, int verbose) {
+    uint8_t* image;
+    struct stat st;
+    FILE* in;
+    int ret;
+
+    if (stat(name, &st) != 0 || (in = fopen(name, "rb")) == NULL) {
+        perror(name);
+        return -1;
+    }
+    if ((image = malloc(st.st_size + 1)) == NULL) {
+        fclose(in);
+        return -1;
+    }
+    if (fread(image, 1, st.st_size, in) != (size_t) st.st_size) {
+        fprintf(stderr, "mkfsimg: short read on %s\n", name);
+        fclose(in);
+        free(image);
+        return -1;
+    }
+    fclose(in);
+
+    ret = report_image(name, image, st.st_size, verbose);
+    free(image);
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    const char* in_dir = NULL;
+    const char* out_name = NULL;
+    const char* report_name = NULL;
+    image_opts_t opts = { DEFAULT_INODES, 0, 0, 0, 0, 0 };
+    uint32_t n_files;
+    int it;
+
+    for (it = 1; it < argc; it++) {
+        if (strcmp(argv[it], "-v") == 0) {
+            opts.verbose = 1;
+            continue;
+        }
+        if (strcmp(argv[it], "-z") == 0) {
+            opts.compress = 1;
+            continue;
+        }
+        if (strcmp(argv[it], "-d") == 0) {
+            opts.share = 1;
+            continue;
+        }
+        if (it + 1 >= argc) {
+            break;
+        }
+        if (strcmp(argv[it], "-i") == 0) {
+            in_dir = argv[it + 1];
+        }
+        else if (strcmp(argv[it], "-o") == 0) {
+            out_name = argv[it + 1];
+        }
+        else if (strcmp(argv[it], "-n") == 0) {
+            opts.n_inodes = strtoul(argv[it + 1], NULL, 0);
+        }
+        else if (strcmp(argv[it], "-s") == 0) {
+            opts.n_spare = strtoul(argv[it + 1], NULL, 0);
+        }
+        else if (strcmp(argv[it], "-l") == 0) {
+            opts.inline_max = strtoul(argv[it + 1], NULL, 0);
+        }
+        else if (strcmp(argv[it], "-r") == 0) {
+            report_name = argv[it + 1];
+        }
+        else {
+            break;
+        }
+        it++;
+    }
+    if (it != argc || (report_name == NULL) == (in_dir == NULL || out_name == NULL) || opts.inline_max > FS_INLINE_MAX) {
+        fprintf(stderr, "usage: %s -i <input dir> -o <output image> [-n <inodes>] [-s <spare blocks>]\n", argv[0]);
+        fprintf(stderr, "       %*s [-l <inline bytes, at most %d>] [-d] [-z] [-v]\n", (int) strlen(argv[0]), "", FS_INLINE_MAX);
+        fprintf(stderr, "       %s -r <image> [-v]\n", argv[0]);
+        return 1;
+    }
+
+    if (report_name != NULL) {
+        return (report_file(report_name, opts.verbose) == 0) ? 0 : 1;
+    }
+
+    if (scan_dir(in_dir) != 0) {
+        return 1;
+    }
+
+    /* every regular file needs its own inode */
+    n_files = n_entries - FIXED_ENTRIES;
+    if (opts.n_inodes < n_files) {
+        opts.n_inodes = n_files;
+    }
+    if (opts.n_inodes > FS_MAX_INODES) {
+        fprintf(stderr, "mkfsimg: the kernel mounts at most %d inodes\n", FS_MAX_INODES);
+        return 1;
+    }
+
+    return (write_image(out_name, &opts) == 0) ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+#include "ata.h"
+#include "pci.h"
+#include "i8259.h"
+#include "lib.h"
+
+cache_backend_t ata_backend = {&ata_read_block, &ata_write_block, &ata_read_blocks};
+
+static uint32_t n_blocks;               /* 4kB blocks on the drive, 0 if there is none          */
+static uint32_t bm_base;                /* bus master registers, 0 if there is no DMA           */
+static int32_t use_dma;
+static blk_stats_t stats;
+static ata_prd_t prdt[ATA_MAX_BLOCKS] __attribute__((aligned(sizeof(ata_prd_t) * ATA_MAX_BLOCKS)));
+
+/* set by the interrupt handler, with the status registers it read */
+static volatile uint32_t irq_pending;
+static volatile uint32_t irq_status;
+static volatile uint32_t irq_bm_status;
+
+/*
+ * find_bus_master
+ * DESCRIPTION: finds the IDE controller among the PCI functions, turns on its bus mastering
+ *              and returns the I/O base of its bus master registers
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the I/O base, or 0 if there is no controller that can do DMA
+ */
+static uint32_t find_bus_master(void) {
+    pci_dev_t* ide;
+    uint32_t base;
+
+    if ((ide = pci_find_class(PCI_CLASS_IDE)) == NULL || (base = pci_io_base(ide, ATA_BM_BAR)) == 0) {
+        return 0;
+    }
+    pci_enable(ide);
+    return base;
+}
+
+/*
+ * wait_idle
+ * DESCRIPTION: polls the alternate status until the drive isn't busy, without acknowledging
+ *              an interrupt
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the status, or -1 on timeout
+ */
+static int32_t wait_idle(void) {
+    uint32_t spins;
+    uint32_t status;
+
+    for (spins = 0; spins < ATA_TIMEOUT; spins++) {
+        if (((status = inb(ATA_CTRL_PORT)) & ATA_SR_BSY) == 0) {
+            return status;
+        }
+    }
+    return -1;
+}
+
+/*
+ * select_drive
+ * DESCRIPTION: selects the drive and gives it the 400ns it needs to put its status on the bus
+ * INPUTS: lba_high: bits 24-27 of the LBA of the next command
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void select_drive(uint32_t lba_high) {
+    uint32_t it;
+
+    outb(ATA_DRIVE_LBA | (ATA_DRIVE << 4) | (lba_high & 0x0F), ATA_IO_BASE + ATA_REG_DRIVE);
+    for (it = 0; it < 4; it++) {
+        inb(ATA_CTRL_PORT);
+    }
+}
+
+/*
+ * wait_irq
+ * DESCRIPTION: spins until the drive interrupts, like rtc_read waits for the RTC
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if the drive reported no error, else -1 (also on timeout)
+ */
+static int32_t wait_irq(void) {
+    uint32_t spins;
+
+    for (spins = 0; spins < ATA_TIMEOUT; spins++) {
+        cli();
+        if (irq_pending) {
+            irq_pending = 0;
+            sti();
+            return (irq_status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+        }
+        sti();
+    }
+    return -1;
+}
+
+/*
+ * issue
+ * DESCRIPTION: selects the drive and sends a read or write command for a run of sectors
+ * INPUTS: lba: first sector
+ *         sectors: number of sectors, 1 to 256
+ *         command: ATA_CMD_*
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the drive stayed busy
+ */
+static int32_t issue(uint32_t lba, uint32_t sectors, uint32_t command) {
+    select_drive(lba >> 24);
+    if (wait_idle() == -1) {
+        return -1;
+    }
+    irq_pending = 0;
+    outb(sectors & 0xFF, ATA_IO_BASE + ATA_REG_COUNT);
+    outb(lba & 0xFF, ATA_IO_BASE + ATA_REG_LBA0);
+    outb((lba >> 8) & 0xFF, ATA_IO_BASE + ATA_REG_LBA1);
+    outb((lba >> 16) & 0xFF, ATA_IO_BASE + ATA_REG_LBA2);
+    outb(command, ATA_IO_BASE + ATA_REG_COMMAND);
+    return 0;
+}
+
+/*
+ * pio_transfer
+ * DESCRIPTION: moves whole blocks with programmed I/O, one interrupt per sector
+ * INPUTS: block: first block
+ *         count: number of blocks, at most ATA_MAX_BLOCKS
+ *         bufs: one CACHE_BLOCK_SIZE buffer per block
+ *         write: nonzero to write the buffers to the disk
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+static int32_t pio_transfer(uint32_t block, uint32_t count, uint8_t** bufs, int32_t write) {
+    uint32_t sectors = count * ATA_BLOCK_SECTORS;
+    uint16_t* words;
+    uint32_t sector;
+    uint32_t it;
+
+    if (issue(block * ATA_BLOCK_SECTORS, sectors, write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO) != 0) {
+        return -1;
+    }
+
+    for (sector = 0; sector < sectors; sector++) {
+        words = (uint16_t*) (bufs[sector / ATA_BLOCK_SECTORS] + (sector % ATA_BLOCK_SECTORS) * ATA_SECTOR_SIZE);
+        if (write) {
+            /* the drive asks for the first sector without interrupting */
+            if ((sector == 0 ? wait_idle() : wait_irq()) == -1 || (inb(ATA_CTRL_PORT) & ATA_SR_DRQ) == 0) {
+                return -1;
+            }
+            for (it = 0; it < ATA_SECTOR_SIZE / 2; it++) {
+                outw(words[it], ATA_IO_BASE + ATA_REG_DATA);
+            }
+        }
+        else {
+            if (wait_irq() == -1) {
+                return -1;
+            }
+            for (it = 0; it < ATA_SECTOR_SIZE / 2; it++) {
+                words[it] = inw(ATA_IO_BASE + ATA_REG_DATA);
+            }
+        }
+    }
+
+    /* after the last sector written, wait for it and for the drive's write cache */
+    if (write && (wait_irq() == -1 || issue(0, 0, ATA_CMD_FLUSH) != 0 || wait_irq() == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * dma_transfer
+ * DESCRIPTION: moves whole blocks with one bus master DMA command, the PRD table scattering
+ *              them into (or gathering them from) the buffers; one interrupt at the end
+ * INPUTS: block: first block
+ *         count: number of blocks, at most ATA_MAX_BLOCKS
+ *         bufs: one CACHE_BLOCK_SIZE buffer per block, at its physical address
+ *         write: nonzero to write the buffers to the disk
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+static int32_t dma_transfer(uint32_t block, uint32_t count, uint8_t** bufs, int32_t write) {
+    uint32_t direction = write ? 0 : BM_CMD_READ;
+    uint32_t it;
+    int32_t ret;
+
+    for (it = 0; it < count; it++) {
+        prdt[it].addr = (uint32_t) bufs[it];
+        prdt[it].bytes = CACHE_BLOCK_SIZE;
+        prdt[it].flags = (it == count - 1) ? PRD_EOT : 0;
+    }
+
+    outb(0, bm_base + BM_REG_COMMAND);
+    outl((uint32_t) prdt, bm_base + BM_REG_PRDT);
+    outb(BM_SR_ERR | BM_SR_IRQ, bm_base + BM_REG_STATUS);
+    outb(direction, bm_base + BM_REG_COMMAND);
+
+    if (issue(block * ATA_BLOCK_SECTORS, count * ATA_BLOCK_SECTORS, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA) != 0) {
+        return -1;
+    }
+    outb(direction | BM_CMD_START, bm_base + BM_REG_COMMAND);
+    ret = wait_irq();
+    outb(direction, bm_base + BM_REG_COMMAND);
+
+    if (ret != 0 || (irq_bm_status & BM_SR_ERR)) {
+        return -1;
+    }
+    if (write && (issue(0, 0, ATA_CMD_FLUSH) != 0 || wait_irq() == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * transfer
+ * DESCRIPTION: checks a run of blocks is on the disk and moves it with DMA if that's on, else
+ *              with PIO, counting it as one request
+ * INPUTS: block: first block
+ *         count: number of blocks
+ *         bufs: one CACHE_BLOCK_SIZE buffer per block
+ *         write: nonzero to write the buffers to the disk
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+static int32_t transfer(uint32_t block, uint32_t count, uint8_t** bufs, int32_t write) {
+    uint32_t start;
+    int32_t ret;
+
+    if (bufs == NULL || count == 0 || count > ATA_MAX_BLOCKS || block >= n_blocks || count > n_blocks - block) {
+        return -1;
+    }
+
+    start = rdtsc();
+    ret = use_dma ? dma_transfer(block, count, bufs, write) : pio_transfer(block, count, bufs, write);
+    blk_stats_add(&stats, rdtsc() - start, (ret == 0) ? count : 0);
+    stats.submits++;
+    return ret;
+}
+
+/*
+ * ata_init
+ * DESCRIPTION: identifies the drive, finds the bus master for DMA and unmasks the channel's
+ *              interrupt
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if there is an ATA disk to use, else -1
+ */
+int32_t ata_init(void) {
+    uint16_t ident[ATA_SECTOR_SIZE / 2];
+    uint32_t status;
+    uint32_t it;
+
+    n_blocks = 0;
+    bm_base = 0;
+    use_dma = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    /* a floating bus reads all ones */
+    if (inb(ATA_IO_BASE + ATA_REG_STATUS) == 0xFF) {
+        return -1;
+    }
+
+    /* IDENTIFY by polling, before interrupts are on */
+    outb(ATA_CTRL_NIEN, ATA_CTRL_PORT);
+    select_drive(0);
+    outb(0, ATA_IO_BASE + ATA_REG_COUNT);
+    outb(0, ATA_IO_BASE + ATA_REG_LBA0);
+    outb(0, ATA_IO_BASE + ATA_REG_LBA1);
+    outb(0, ATA_IO_BASE + ATA_REG_LBA2);
+    outb(ATA_CMD_IDENTIFY, ATA_IO_BASE + ATA_REG_COMMAND);
+    if (inb(ATA_IO_BASE + ATA_REG_STATUS) == 0 || wait_idle() == -1) {
+        return -1;
+    }
+    /* ATAPI and SATA devices put a signature here instead */
+    if (inb(ATA_IO_BASE + ATA_REG_LBA1) != 0 || inb(ATA_IO_BASE + ATA_REG_LBA2) != 0) {
+        return -1;
+    }
+    status = inb(ATA_IO_BASE + ATA_REG_STATUS);
+    if ((status & ATA_SR_ERR) || (status & ATA_SR_DRQ) == 0) {
+        return -1;
+    }
+    for (it = 0; it < ATA_SECTOR_SIZE / 2; it++) {
+        ident[it] = inw(ATA_IO_BASE + ATA_REG_DATA);
+    }
+    n_blocks = (ident[ATA_IDENTIFY_LBA] | ((uint32_t) ident[ATA_IDENTIFY_LBA + 1] << 16)) / ATA_BLOCK_SECTORS;
+    if (n_blocks == 0) {
+        return -1;
+    }
+
+    bm_base = find_bus_master();
+    use_dma = (bm_base != 0);
+
+    irq_pending = 0;
+    enable_irq(2);
+    enable_irq(ATA_IRQ);
+    outb(0, ATA_CTRL_PORT);
+    return 0;
+}
+
+/*
+ * ata_block_count
+ * DESCRIPTION: returns the size of the disk
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 4kB blocks on the disk, 0 if ata_init found none
+ */
+uint32_t ata_block_count(void) {
+    return n_blocks;
+}
+
+/*
+ * ata_set_dma
+ * DESCRIPTION: picks DMA or PIO for later transfers; DMA can only be turned on if ata_init
+ *              found a bus master
+ * INPUTS: on: nonzero for DMA
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if DMA was on before the call, else 0
+ */
+int32_t ata_set_dma(int32_t on) {
+    int32_t was_on = use_dma;
+
+    use_dma = (on && bm_base != 0);
+    return was_on;
+}
+
+/*
+ * ata_get_stats
+ * DESCRIPTION: copies the request counters; every command is a request, so submits equals
+ *              requests
+ * INPUTS: out: where to copy them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void ata_get_stats(blk_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+/*
+ * ata_read_block
+ * DESCRIPTION: block cache backend; reads one 4kB block
+ * INPUTS: block: block number on the disk
+ *         buf: CACHE_BLOCK_SIZE buffer to read to
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t ata_read_block(uint32_t block, uint8_t* buf) {
+    return transfer(block, 1, &buf, 0);
+}
+
+/*
+ * ata_write_block
+ * DESCRIPTION: block cache backend; writes one 4kB block and waits for the drive to store it
+ * INPUTS: block: block number on the disk
+ *         buf: CACHE_BLOCK_SIZE buffer to write from
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t ata_write_block(uint32_t block, const uint8_t* buf) {
+    return transfer(block, 1, (uint8_t**) &buf, 1);
+}
+
+/*
+ * ata_read_blocks
+ * DESCRIPTION: block cache backend; reads consecutive blocks into separate buffers with one
+ *              command, for readahead
+ * INPUTS: block: first block number on the disk
+ *         count: number of blocks, at most ATA_MAX_BLOCKS
+ *         bufs: one CACHE_BLOCK_SIZE buffer per block
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t ata_read_blocks(uint32_t block, uint32_t count, uint8_t** bufs) {
+    return transfer(block, count, bufs, 0);
+}
+
+/*
+ * ata_handler
+ * DESCRIPTION: interrupt handler for the primary channel; reading the status acknowledges the
+ *              drive, and the bus master's interrupt bit is cleared by writing it back
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void ata_handler(void) {
+    irq_status = inb(ATA_IO_BASE + ATA_REG_STATUS);
+    if (bm_base != 0) {
+        irq_bm_status = inb(bm_base + BM_REG_STATUS);
+        outb(irq_bm_status & (BM_SR_ERR | BM_SR_IRQ), bm_base + BM_REG_STATUS);
+    }
+    irq_pending = 1;
+    send_eoi(ATA_IRQ);
+}
@@ -0,0 +1,91 @@
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "block_cache.h"
+
+/* primary channel of the IDE controller */
+#define ATA_IO_BASE         0x1F0       /* command block registers                              */
+#define ATA_CTRL_PORT       0x3F6       /* device control / alternate status                    */
+#define ATA_IRQ             14          /* PIC line of the primary channel                      */
+#define ATA_IDT             0x2E        /* PIC_SLAVE_IDT + 6                                    */
+
+/* drive holding the filesystem; the boot disk is the master, so the image is -hdb in QEMU */
+#ifndef ATA_DRIVE
+#define ATA_DRIVE           1
+#endif
+
+/* command block register offsets */
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_COUNT       2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7           /* reading it acknowledges the interrupt                */
+#define ATA_REG_COMMAND     7
+
+/* status bits */
+#define ATA_SR_BSY          0x80
+#define ATA_SR_DRDY         0x40
+#define ATA_SR_DF           0x20
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_ERR          0x01
+
+/* commands */
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+#define ATA_CMD_FLUSH       0xE7
+#define ATA_CMD_IDENTIFY    0xEC
+
+#define ATA_DRIVE_LBA       0xE0        /* drive register: LBA mode, top 4 bits of the LBA below */
+#define ATA_CTRL_NIEN       0x02        /* device control: interrupts off                       */
+
+/* bus master IDE registers, at BAR4 of the controller's PCI function */
+#define ATA_BM_BAR          4
+#define BM_REG_COMMAND      0
+#define BM_REG_STATUS       2
+#define BM_REG_PRDT         4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08        /* transfer from the drive to memory                    */
+#define BM_SR_ERR           0x02
+#define BM_SR_IRQ           0x04
+#define PRD_EOT             0x8000      /* last entry of the PRD table                          */
+
+#define ATA_SECTOR_SIZE     512
+#define ATA_BLOCK_SECTORS   (CACHE_BLOCK_SIZE / ATA_SECTOR_SIZE)
+#define ATA_MAX_BLOCKS      32          /* blocks per command: 256 sectors, the LBA28 limit     */
+#define ATA_IDENTIFY_LBA    60          /* IDENTIFY words 60-61: sectors addressable with LBA28 */
+#define ATA_TIMEOUT         10000000    /* polls before a command is given up on                */
+
+/* one entry of the bus master's scatter list */
+typedef struct ata_prd {
+    uint32_t addr;                      /* physical address of the buffer                       */
+    uint16_t bytes;                     /* length of the buffer; 0 means 64kB                   */
+    uint16_t flags;                     /* PRD_EOT on the last entry                            */
+} __attribute__((packed)) ata_prd_t;
+
+/* finds the drive and the bus master; returns 0 if there is a disk to use */
+int32_t ata_init(void);
+/* 4kB blocks on the disk */
+uint32_t ata_block_count(void);
+/* turns DMA on or off if the controller has it; returns whether it was on */
+int32_t ata_set_dma(int32_t on);
+/* request counters and latencies since ata_init */
+void ata_get_stats(blk_stats_t* out);
+
+/* block cache backend functions; buffers must be 4kB aligned, in identity mapped kernel memory */
+int32_t ata_read_block(uint32_t block, uint8_t* buf);
+int32_t ata_write_block(uint32_t block, const uint8_t* buf);
+int32_t ata_read_blocks(uint32_t block, uint32_t count, uint8_t** bufs);
+
+/* the disk as a block cache backend, for init_filesys_disk */
+extern cache_backend_t ata_backend;
+
+/* interrupt handler for ATA_IRQ */
+void ata_handler(void);
+
+#endif /* _ATA_H */
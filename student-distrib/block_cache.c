@@ -0,0 +1,350 @@
+#include "block_cache.h"
+#include "lib.h"
+
+static cache_slot_t cache_slots[CACHE_BLOCKS];
+static uint8_t cache_data[CACHE_BLOCKS][CACHE_BLOCK_SIZE] __attribute__((aligned(CACHE_BLOCK_SIZE)));
+static cache_backend_t* cache_backend = NULL;
+static uint32_t cache_use_count;            /* bumped on every access, orders slots for LRU */
+static uint32_t cache_n_dirty;              /* slots with CACHE_DIRTY set                   */
+static uint32_t cache_next_block;           /* block after the last one loaded on a miss    */
+static cache_stats_t cache_stats;
+
+/*
+ * find_slot
+ * DESCRIPTION: finds the slot holding a block
+ * INPUTS: block: block number
+ * OUTPUTS: none
+ * RETURN VALUE: slot index, or -1 if the block isn't cached
+ */
+static int32_t find_slot(uint32_t block) {
+    int32_t idx;
+
+    for (idx = 0; idx < CACHE_BLOCKS; idx++) {
+        if ((cache_slots[idx].flags & CACHE_VALID) && cache_slots[idx].block == block) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/*
+ * cache_init
+ * DESCRIPTION: empties the cache, clears its counters and sets its backing store
+ * INPUTS: backend: functions that move whole blocks between the cache and backing store
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void cache_init(cache_backend_t* backend) {
+    int32_t idx;
+
+    for (idx = 0; idx < CACHE_BLOCKS; idx++) {
+        cache_slots[idx].block = CACHE_NONE;
+        cache_slots[idx].flags = 0;
+        cache_slots[idx].last_use = 0;
+    }
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    cache_backend = backend;
+    cache_use_count = 0;
+    cache_n_dirty = 0;
+    cache_next_block = CACHE_NONE;
+}
+
+/*
+ * take_slot
+ * DESCRIPTION: empties the least recently used slot (or a free one) for a block about to be
+ *              loaded and marks it CACHE_LOADING until the caller fills it in; if that slot is
+ *              dirty, all dirty slots are flushed together first
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: slot index, or -1 if every slot is loading or a dirty slot couldn't be written
+ *               back
+ */
+static int32_t take_slot(void) {
+    int32_t idx;
+    int32_t victim;
+
+    /* prefer an empty slot, else the least recently used one */
+    victim = -1;
+    for (idx = 0; idx < CACHE_BLOCKS; idx++) {
+        if (cache_slots[idx].flags & CACHE_LOADING) {
+            continue;
+        }
+        if ((cache_slots[idx].flags & CACHE_VALID) == 0) {
+            victim = idx;
+            break;
+        }
+        if (victim == -1 || cache_slots[idx].last_use < cache_slots[victim].last_use) {
+            victim = idx;
+        }
+    }
+    if (victim == -1) {
+        return -1;
+    }
+
+    if (cache_slots[victim].flags & CACHE_VALID) {
+        if ((cache_slots[victim].flags & CACHE_DIRTY) && cache_flush() != 0) {
+            return -1;
+        }
+        cache_stats.evictions++;
+    }
+
+    cache_slots[victim].flags = CACHE_LOADING;
+    cache_slots[victim].block = CACHE_NONE;
+    return victim;
+}
+
+/*
+ * read_ahead
+ * DESCRIPTION: loads a missed block together with the uncached blocks right after it, up to
+ *              CACHE_READAHEAD in all, with one read_blocks request. The blocks ahead are
+ *              marked used before the missed one, so they are evicted first if nobody reads them
+ * INPUTS: block: the missed block
+ *         first: slot already taken for it
+ * OUTPUTS: none
+ * RETURN VALUE: number of blocks loaded, 0 if there was nothing to read ahead or the request
+ *               failed (the slots taken for blocks ahead are left empty)
+ */
+static uint32_t read_ahead(uint32_t block, int32_t first) {
+    uint8_t* bufs[CACHE_READAHEAD];
+    int32_t slots[CACHE_READAHEAD];
+    uint32_t count;
+    uint32_t it;
+    int32_t idx;
+
+    slots[0] = first;
+    bufs[0] = cache_data[first];
+    for (count = 1; count < CACHE_READAHEAD && count < CACHE_BLOCKS / 2 && find_slot(block + count) == -1; count++) {
+        if ((idx = take_slot()) == -1) {
+            break;
+        }
+        slots[count] = idx;
+        bufs[count] = cache_data[idx];
+    }
+
+    if (count > 1 && cache_backend->read_blocks(block, count, bufs) == 0) {
+        for (it = count; it > 0; it--) {
+            cache_slots[slots[it - 1]].block = block + it - 1;
+            cache_slots[slots[it - 1]].flags = CACHE_VALID;
+            cache_slots[slots[it - 1]].last_use = ++cache_use_count;
+        }
+        cache_stats.readaheads += count - 1;
+        return count;
+    }
+
+    for (it = 1; it < count; it++) {
+        cache_slots[slots[it]].flags = 0;
+    }
+    return 0;
+}
+
+/*
+ * cache_get_block
+ * DESCRIPTION: returns the cached copy of a block, taking the least recently used slot for it
+ *              on a miss. A miss on the block right after the last one loaded means the blocks
+ *              are being read in order, and the backend can read ahead, the next few blocks
+ *              are loaded with it
+ * INPUTS: block: block number
+ *         fill: nonzero to read the block from the backing store on a miss, zero if the caller
+ *               is about to overwrite all of it
+ * OUTPUTS: none
+ * RETURN VALUE: pointer to the CACHE_BLOCK_SIZE bytes of the block, or NULL on failure
+ */
+uint8_t* cache_get_block(uint32_t block, int32_t fill) {
+    int32_t idx;
+    uint32_t loaded;
+
+    if (cache_backend == NULL) {
+        return NULL;
+    }
+
+    if ((idx = find_slot(block)) != -1) {
+        cache_stats.hits++;
+        cache_slots[idx].last_use = ++cache_use_count;
+        return cache_data[idx];
+    }
+    cache_stats.misses++;
+
+    if ((idx = take_slot()) == -1) {
+        return NULL;
+    }
+
+    if (fill && block == cache_next_block && cache_backend->read_blocks != NULL &&
+        (loaded = read_ahead(block, idx)) != 0) {
+        cache_next_block = block + loaded;
+        return cache_data[idx];
+    }
+
+    if (fill && cache_backend->read_block(block, cache_data[idx]) != 0) {
+        cache_slots[idx].flags = 0;
+        return NULL;
+    }
+    cache_next_block = block + 1;
+
+    cache_slots[idx].block = block;
+    cache_slots[idx].flags = CACHE_VALID;
+    cache_slots[idx].last_use = ++cache_use_count;
+    return cache_data[idx];
+}
+
+/*
+ * cache_lookup_dirty
+ * DESCRIPTION: returns the cached copy of a block if it holds writes the backing store doesn't
+ *              have yet; readers that go straight to the backing store check this first
+ * INPUTS: block: block number
+ * OUTPUTS: none
+ * RETURN VALUE: pointer to the cached block, or NULL if the backing store is up to date
+ */
+uint8_t* cache_lookup_dirty(uint32_t block) {
+    int32_t idx;
+
+    if (cache_n_dirty == 0 || (idx = find_slot(block)) == -1) {
+        return NULL;
+    }
+    if ((cache_slots[idx].flags & CACHE_DIRTY) == 0) {
+        return NULL;
+    }
+    return cache_data[idx];
+}
+
+/*
+ * cache_mark_dirty
+ * DESCRIPTION: marks a cached block as written so it is written back on the next flush
+ * INPUTS: block: block number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void cache_mark_dirty(uint32_t block) {
+    int32_t idx;
+
+    if ((idx = find_slot(block)) == -1) {
+        return;
+    }
+    if ((cache_slots[idx].flags & CACHE_DIRTY) == 0) {
+        cache_slots[idx].flags |= CACHE_DIRTY;
+        cache_n_dirty++;
+    }
+}
+
+/*
+ * cache_invalidate
+ * DESCRIPTION: drops a block from the cache without writing it back, for blocks being freed
+ * INPUTS: block: block number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void cache_invalidate(uint32_t block) {
+    int32_t idx;
+
+    if ((idx = find_slot(block)) == -1) {
+        return;
+    }
+    if (cache_slots[idx].flags & CACHE_DIRTY) {
+        cache_n_dirty--;
+    }
+    cache_slots[idx].flags = 0;
+    cache_slots[idx].block = CACHE_NONE;
+}
+
+/*
+ * cache_flush
+ * DESCRIPTION: writes all dirty blocks back to the backing store in ascending block order,
+ *              so a batch touches the store sequentially; the blocks stay cached and clean
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if a block couldn't be written back
+ */
+int32_t cache_flush(void) {
+    int32_t order[CACHE_BLOCKS];
+    int32_t n_order = 0;
+    int32_t idx;
+    int32_t it;
+
+    if (cache_n_dirty == 0) {
+        return 0;
+    }
+
+    /* insertion sort the dirty slots by block number */
+    for (idx = 0; idx < CACHE_BLOCKS; idx++) {
+        if ((cache_slots[idx].flags & CACHE_DIRTY) == 0) {
+            continue;
+        }
+        for (it = n_order; it > 0 && cache_slots[order[it - 1]].block > cache_slots[idx].block; it--) {
+            order[it] = order[it - 1];
+        }
+        order[it] = idx;
+        n_order++;
+    }
+
+    cache_stats.flushes++;
+    for (it = 0; it < n_order; it++) {
+        idx = order[it];
+        if (cache_backend->write_block(cache_slots[idx].block, cache_data[idx]) != 0) {
+            return -1;
+        }
+        cache_slots[idx].flags &= ~CACHE_DIRTY;
+        cache_n_dirty--;
+        cache_stats.writebacks++;
+    }
+    return 0;
+}
+
+/*
+ * cache_dirty_count
+ * DESCRIPTION: returns how many cached blocks are waiting to be written back
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: number of dirty blocks
+ */
+uint32_t cache_dirty_count(void) {
+    return cache_n_dirty;
+}
+
+/*
+ * cache_get_stats
+ * DESCRIPTION: copies the cache counters
+ * INPUTS: stats: where to copy them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void cache_get_stats(cache_stats_t* stats) {
+    if (stats != NULL) {
+        *stats = cache_stats;
+    }
+}
+
+/*
+ * blk_stats_add
+ * DESCRIPTION: counts one finished request of a disk backend and its latency
+ * INPUTS: stats: the backend's counters
+ *         cycles: TSC cycles from submission to completion
+ *         blocks: blocks the request moved, 0 if it failed
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void blk_stats_add(blk_stats_t* stats, uint32_t cycles, uint32_t blocks) {
+    stats->requests++;
+    if (blocks == 0) {
+        stats->errors++;
+    }
+    stats->blocks += blocks;
+    stats->latency_kcycles += cycles >> 10;
+    if (cycles > stats->max_latency) {
+        stats->max_latency = cycles;
+    }
+}
+
+/*
+ * blk_stats_avg_latency
+ * DESCRIPTION: averages the latency of a backend's requests
+ * INPUTS: stats: the backend's counters
+ * OUTPUTS: none
+ * RETURN VALUE: average cycles per request, 0 if there were none
+ */
+uint32_t blk_stats_avg_latency(const blk_stats_t* stats) {
+    if (stats->requests == 0) {
+        return 0;
+    }
+    /* split so the sum doesn't overflow when scaled back to cycles */
+    return ((stats->latency_kcycles / stats->requests) << 10) +
+           (((stats->latency_kcycles % stats->requests) << 10) / stats->requests);
+}
@@ -0,0 +1,84 @@
+#ifndef _BLOCK_CACHE_H
+#define _BLOCK_CACHE_H
+
+#include "types.h"
+
+#ifndef CACHE_BLOCKS
+#define CACHE_BLOCKS    16          /* 4kB blocks held by the cache                     */
+#endif
+#ifndef CACHE_READAHEAD
+#define CACHE_READAHEAD 8           /* blocks read in one go once reads are sequential  */
+#endif
+#define CACHE_BLOCK_SIZE 0x1000     /* size of each cached block                        */
+#define CACHE_NONE      0xFFFFFFFF  /* block number of an empty cache slot              */
+
+#define CACHE_VALID     0x1         /* slot holds a copy of a block                     */
+#define CACHE_DIRTY     0x2         /* slot has been written and not flushed yet        */
+#define CACHE_LOADING   0x4         /* slot is taken for a block being read in          */
+
+/* backing store for the cache: copies one whole block in or out; read_blocks is optional and */
+/* fills bufs[0..count) from consecutive blocks in one request, for stores where that's cheaper */
+typedef struct cache_backend {
+    int32_t (*read_block)(uint32_t block, uint8_t* buf);
+    int32_t (*write_block)(uint32_t block, const uint8_t* buf);
+    int32_t (*read_blocks)(uint32_t block, uint32_t count, uint8_t** bufs);
+} cache_backend_t;
+
+/* counters a disk backend keeps to compare devices; latencies are in TSC cycles, and a  */
+/* device that takes several requests per submission completes each one separately      */
+typedef struct blk_stats {
+    uint32_t requests;          /* requests completed, failed ones included         */
+    uint32_t submits;           /* times requests were handed to the device         */
+    uint32_t blocks;            /* blocks moved by requests that succeeded          */
+    uint32_t errors;            /* requests that failed or timed out                */
+    uint32_t latency_kcycles;   /* latency summed over requests, in 1024 cycles     */
+    uint32_t max_latency;       /* latency of the slowest request                   */
+} blk_stats_t;
+
+/* one cached block */
+typedef struct cache_slot {
+    uint32_t block;             /* block number held in this slot, or CACHE_NONE    */
+    uint32_t flags;             /* CACHE_VALID, CACHE_DIRTY                         */
+    uint32_t last_use;          /* value of the use counter at the last access      */
+} cache_slot_t;
+
+/* counters for sizing the cache */
+typedef struct cache_stats {
+    uint32_t hits;              /* lookups served from the cache                    */
+    uint32_t misses;            /* lookups that had to go to the backing store      */
+    uint32_t evictions;         /* valid slots reused for another block             */
+    uint32_t flushes;           /* batches of dirty blocks written back             */
+    uint32_t writebacks;        /* dirty blocks written back                        */
+    uint32_t readaheads;        /* blocks loaded ahead of a sequential miss         */
+} cache_stats_t;
+
+/* empties the cache and sets the backing store it reads from and writes back to */
+void cache_init(cache_backend_t* backend);
+
+/* returns the cached copy of a block, loading it first if fill is set */
+uint8_t* cache_get_block(uint32_t block, int32_t fill);
+
+/* returns the cached copy of a block only if it has unflushed writes */
+uint8_t* cache_lookup_dirty(uint32_t block);
+
+/* marks a cached block as written */
+void cache_mark_dirty(uint32_t block);
+
+/* drops a block from the cache without writing it back */
+void cache_invalidate(uint32_t block);
+
+/* writes every dirty block back, in block order, as one batch */
+int32_t cache_flush(void);
+
+/* number of blocks waiting to be written back */
+uint32_t cache_dirty_count(void);
+
+/* copies the cache counters */
+void cache_get_stats(cache_stats_t* stats);
+
+/* counts one finished backend request; blocks is 0 if it failed */
+void blk_stats_add(blk_stats_t* stats, uint32_t cycles, uint32_t blocks);
+/* average request latency in cycles */
+uint32_t blk_stats_avg_latency(const blk_stats_t* stats);
+
+#endif /* _BLOCK_CACHE_H */
@@ -0,0 +1,16 @@
+#ifndef _CONTEXT_H
+#define _CONTEXT_H
+
+#ifndef ASM
+
+#include "types.h"
+
+/* saves the callee-saved registers and esp in *save_esp, then carries on from a stack that
+   was left by switch_stack (or built to look like it) at new_esp */
+extern void switch_stack(uint32_t* save_esp, uint32_t new_esp);
+
+/* where a new task's first switch_stack returns to: irets to the user mode frame above it */
+extern void task_entry(void);
+
+#endif /* ASM */
+#endif /* _CONTEXT_H */
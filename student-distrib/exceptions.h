@@ -59,9 +59,20 @@ extern int SYS_CALL_HANDLER(int call_number, int arg1, int arg2, int arg3);
 // RTC Handler Assembly Linkage
 extern void RTC_HANDLER();
 
+// Timer Handler Assembly Linkage
+extern void PIT_HANDLER();
+
 // Keyboard Interrupt handler Assembly Linkage
 extern void KEY_HANDLER();
 
+// ATA (primary IDE channel) Handler Assembly Linkage
+extern void ATA_HANDLER();
+
+// PCI Interrupt Line Handlers Assembly Linkage
+extern void PCI_IRQ9_HANDLER();
+extern void PCI_IRQ10_HANDLER();
+extern void PCI_IRQ11_HANDLER();
+
 #endif
 
 #endif
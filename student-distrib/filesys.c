@@ -1,351 +1,1735 @@
 #include "filesys.h"
+#include "vfs.h"
+#include "mmap.h"
 
 uint32_t* filesys_ptr = NULL;       /* ptr to current open file system                      */
-dentry_t open_dentry;               /* struct containing last opened dentry                 */
-dentry_t read_dentry;               /* struct containing last read dentry                   */
 bblock_t bblock;                    /* struct containing boot block info for file system    */
-file_desc_t file_desc;              /* struct for file descriptor                           */
-/* filename buffer for read subroutines */
-static int8_t filename_buf[NAME_LEN] __attribute__((aligned(FOUR_KB)));
+
+/* name index over the boot block dentries, built once by init_filesys */
+static int16_t dentry_hash_head[DENTRY_HASH_SIZE];  /* first dentry index in each bucket    */
+static int16_t dentry_hash_next[FS_MAX_DENTRIES];   /* next dentry index in the same bucket */
+
+/* data blocks chained after the boot block to hold more dentries, found by init_filesys */
+static uint32_t dir_blocks[FS_MAX_DIR_BLOCKS];      /* chained directory blocks, in order       */
+static uint32_t n_dir_blocks;                       /* directory blocks in the chain            */
+
+/* extent map over every inode, built once by init_filesys */
+static fs_extent_t extent_pool[FS_MAX_EXTENTS];     /* extents of all inodes, grouped by inode  */
+static inode_extents_t inode_extents[FS_MAX_INODES];/* where each inode's extents are in the pool */
+static uint32_t n_extents;                          /* extents handed out from the pool         */
+
+/* allocation state for writes, built once by init_filesys */
+static uint32_t fs_flags;                           /* FS_WRITABLE, FS_COMPRESSED, FS_DISK      */
+static uint32_t fs_revision;                        /* format revision from the boot block      */
+static uint32_t block_bitmap[FS_MAX_BLOCKS/32];     /* set bit for each data block in use       */
+static uint16_t block_refs[FS_MAX_BLOCKS];          /* files naming each block, up to FS_REFS_MAX */
+static uint32_t inode_bitmap[FS_MAX_INODES/32];     /* set bit for each inode in use            */
+static cache_backend_t image_backend;               /* moves blocks between the cache and image */
+
+/* compressed images, found by init_filesys */
+static uint32_t* z_offsets;                         /* where each inode and data block is packed */
+static cache_backend_t lz_backend;                  /* unpacks blocks into the cache            */
+static uint32_t z_lengths[FS_MAX_INODES];           /* inode length words, so reads unpack only data */
+
+/* images on a disk, found by init_filesys_disk; only the boot block is kept in memory */
+static uint32_t disk_boot_block[FOUR_KB/4];         /* copy of block 0, where filesys_ptr points */
+
+/* mounts whose inodes and data blocks are only reachable through the block cache */
+#define FS_CACHED       (FS_COMPRESSED | FS_DISK)
+
+static fd_ops_t file_table;                         /* operations of image files, at the end    */
+
+/* finds the processes whose descriptors and mappings inode_busy checks; the scheduler's */
+/* sched_pcb in the kernel, unset in host tools, which have no processes                 */
+static pcb_t* (*pcb_lookup)(uint32_t pid);
+
+#define INODE_OPEN      0x1                         /* inode_busy: a descriptor is open on it   */
+#define INODE_MAPPED    0x2                         /* a process has it in its mmap window      */
+
+#define BITMAP_TEST(map, bit)   ((map)[(bit) >> 5] & (1U << ((bit) & 31)))
+#define BITMAP_SET(map, bit)    ((map)[(bit) >> 5] |= (1U << ((bit) & 31)))
+#define BITMAP_CLEAR(map, bit)  ((map)[(bit) >> 5] &= ~(1U << ((bit) & 31)))
 
 /*
- * init_filesys
- * DESCRIPTION: saves pointer to filesystem and initiliazes all structs associated with file operations
- * INPUTS: ptr: pointer to starting address of filesystem
+ * data_block_addr
+ * DESCRIPTION: finds a data block in the image; in a compressed image only blocks stored
+ *              unpacked can be used in place, and on a disk the block is read into the block
+ *              cache, the pointer only being good until the cache loads another block
+ * INPUTS: block: data block number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: address of the block, or NULL if it is packed or can't be read
+ */
+static uint32_t* data_block_addr(uint32_t block) {
+    if (fs_flags & FS_DISK) {
+        return (uint32_t*) cache_get_block(bblock.N + 1 + block, 1);
+    }
+    if (fs_flags & FS_COMPRESSED) {
+        if (z_offsets[bblock.N + block + 1] - z_offsets[bblock.N + block] < FOUR_KB) {
+            return NULL;
+        }
+        return filesys_ptr + z_offsets[bblock.N + block]/4;
+    }
+    return filesys_ptr + (FOUR_KB/4)*(bblock.N + block + 1);
+}
+
+/*
+ * inode_addr
+ * DESCRIPTION: finds an inode; in a compressed image or on a disk it is read into the block
+ *              cache, and the pointer is only good until the cache loads another block
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: address of the inode, or NULL if it is corrupt or can't be read
+ */
+static inode_t* inode_addr(uint32_t inode) {
+    if (fs_flags & FS_CACHED) {
+        return (inode_t*) cache_get_block(inode + 1, 1);
+    }
+    return (inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1));
+}
+
+/*
+ * inode_length_word
+ * DESCRIPTION: reads the length word of an inode, INODE_INLINE flag included; the length words
+ *              of a compressed image or one on a disk are kept from the mount
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: the length word
+ */
+static uint32_t inode_length_word(uint32_t inode) {
+    if (fs_flags & FS_CACHED) {
+        return z_lengths[inode];
+    }
+    return ((inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1)))->length;
+}
+
+/*
+ * inode_length
+ * DESCRIPTION: reads the length of a file
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: length of the file in bytes
+ */
+static uint32_t inode_length(uint32_t inode) {
+    return inode_length_word(inode) & INODE_LENGTH_MASK;
+}
+
+/*
+ * dentry_addr
+ * DESCRIPTION: finds a dentry in the image; directory blocks are packed, so entry idx is in
+ *              slot idx % MAX_DENTRIES of directory block idx / MAX_DENTRIES (0 being the boot)
+ * INPUTS: idx: index of the dentry in the directory (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: address of the dentry
+ */
+static uint32_t* dentry_addr(uint32_t idx) {
+    uint32_t* dir_block = filesys_ptr;
+
+    if (idx >= MAX_DENTRIES) {
+        dir_block = data_block_addr(dir_blocks[idx / MAX_DENTRIES - 1]);
+    }
+    return dir_block + (DENTRY_SIZE/4)*(idx % MAX_DENTRIES + 1);
+}
+
+/*
+ * dir_block_addr
+ * DESCRIPTION: finds the header of a directory block
+ * INPUTS: n: 0 for the boot block, else the position of the block in the chain plus one
+ * OUTPUTS: none
+ * RETURN VALUE: address of the block, or NULL if a compressed image packed it
+ */
+static uint32_t* dir_block_addr(uint32_t n) {
+    if (n == 0) {
+        return filesys_ptr;
+    }
+    return data_block_addr(dir_blocks[n - 1]);
+}
+
+/*
+ * read_dir_chain
+ * DESCRIPTION: follows the directory blocks chained after the boot block, checking that each
+ *              one is a real data block, stored unpacked, and that every block but the last is
+ *              full, and totals the entries
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the chain is corrupt or too long
+ */
+static int32_t read_dir_chain(void) {
+    uint32_t* dir_block = filesys_ptr;
+    uint32_t count = *filesys_ptr;
+    uint32_t next = bblock.dir_next;
+
+    n_dir_blocks = 0;
+    bblock.n_dir_entries = count;
+    if (count > MAX_DENTRIES) {
+        return -1;
+    }
+
+    while (next != 0) {
+        if (count != MAX_DENTRIES || next > bblock.D || n_dir_blocks >= FS_MAX_DIR_BLOCKS) {
+            return -1;
+        }
+        dir_blocks[n_dir_blocks++] = next - 1;
+        if ((dir_block = dir_block_addr(n_dir_blocks)) == NULL) {
+            return -1;
+        }
+        count = *dir_block;
+        next = *(dir_block + DIR_NEXT_OFFSET);
+        if (count > MAX_DENTRIES) {
+            return -1;
+        }
+        bblock.n_dir_entries += count;
+    }
+
+    return 0;
+}
+
+/*
+ * write_dir_counts
+ * DESCRIPTION: stores the number of entries in each directory block's header after the
+ *              directory grew or shrank by one
+ * INPUTS: none
  * OUTPUTS: none
  * RETURN VALUE: none
  */
-void init_filesys(uint32_t* ptr) {
-    int idx;
+static void write_dir_counts(void) {
+    uint32_t left = bblock.n_dir_entries;
+    uint32_t n;
 
-    /* save pointer to filesys */
-    filesys_ptr = (uint32_t*) ptr;
+    for (n = 0; n <= n_dir_blocks; n++) {
+        *dir_block_addr(n) = (left > MAX_DENTRIES) ? MAX_DENTRIES : left;
+        left -= *dir_block_addr(n);
+    }
+}
 
-    /* fill in boot block structure */
-    bblock.n_dir_entries = *(filesys_ptr + 0);
-    bblock.N = *(filesys_ptr + 1);
-    bblock.D = *(filesys_ptr + 2);
-    bblock.reserved = 0;
+/*
+ * dentry_hash
+ * DESCRIPTION: hashes a filename (FNV-1a) over at most NAME_LEN bytes, stopping at the first 0,
+ *              so names stored without a terminator hash the same as the caller's string
+ * INPUTS: name: filename to hash
+ * OUTPUTS: none
+ * RETURN VALUE: bucket index in [0, DENTRY_HASH_SIZE)
+ */
+static uint32_t dentry_hash(const uint8_t* name) {
+    uint32_t hash = 2166136261U;
+    uint32_t it;
+
+    for (it = 0; it < NAME_LEN && name[it] != 0; it++) {
+        hash ^= name[it];
+        hash *= 16777619U;
+    }
+
+    return hash & (DENTRY_HASH_SIZE - 1);
+}
+
+/*
+ * build_dentry_index
+ * DESCRIPTION: hashes every boot block dentry name into the chained name index
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void build_dentry_index(void) {
+    uint32_t idx;
+    uint32_t bucket;
+    uint8_t* name_ptr;
+
+    for (idx = 0; idx < DENTRY_HASH_SIZE; idx++) {
+        dentry_hash_head[idx] = DENTRY_NONE;
+    }
+
+    /* insert in reverse so each chain lists dentries in directory order */
+    for (idx = bblock.n_dir_entries; idx > 0; idx--) {
+        name_ptr = (uint8_t*) dentry_addr(idx - 1);
+        bucket = dentry_hash(name_ptr);
+        dentry_hash_next[idx - 1] = dentry_hash_head[bucket];
+        dentry_hash_head[bucket] = idx - 1;
+    }
+}
+
+/*
+ * find_dentry
+ * DESCRIPTION: walks the bucket for a filename in the name index
+ * INPUTS: fname: filename to look up (at most NAME_LEN characters)
+ * OUTPUTS: none
+ * RETURN VALUE: index of the dentry in the boot block, or DENTRY_NONE if there isn't one
+ */
+static int32_t find_dentry(const uint8_t* fname) {
+    int32_t dir_idx;
+
+    /* an empty chain is an immediate miss */
+    for (dir_idx = dentry_hash_head[dentry_hash(fname)]; dir_idx != DENTRY_NONE; dir_idx = dentry_hash_next[dir_idx]) {
+        if (strncmp((int8_t*) fname, (int8_t*) dentry_addr(dir_idx), NAME_LEN) == 0) {
+            return dir_idx;
+        }
+    }
+
+    return DENTRY_NONE;
+}
+
+/*
+ * index_insert
+ * DESCRIPTION: adds a boot block dentry to the front of its bucket in the name index
+ * INPUTS: idx: index of the dentry in the boot block
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void index_insert(uint32_t idx) {
+    uint32_t bucket = dentry_hash((uint8_t*) dentry_addr(idx));
+
+    dentry_hash_next[idx] = dentry_hash_head[bucket];
+    dentry_hash_head[bucket] = idx;
+}
+
+/*
+ * index_remove
+ * DESCRIPTION: unlinks a boot block dentry from its bucket in the name index
+ * INPUTS: idx: index of the dentry in the boot block
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void index_remove(uint32_t idx) {
+    int16_t* link = &dentry_hash_head[dentry_hash((uint8_t*) dentry_addr(idx))];
+
+    while (*link != DENTRY_NONE) {
+        if (*link == (int16_t) idx) {
+            *link = dentry_hash_next[idx];
+            return;
+        }
+        link = &dentry_hash_next[*link];
+    }
+}
+
+/*
+ * map_inode
+ * DESCRIPTION: checks one inode's length and data block numbers against the boot block and
+ *              appends its blocks to the extent pool as runs of physically consecutive blocks;
+ *              an inline inode gets no extents
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the inode is corrupt or the pool is full, in which case
+ *               the pool is left as it was
+ */
+static int32_t map_inode(uint32_t inode) {
+    inode_t* inode_ptr = inode_addr(inode);
+    fs_extent_t* extent = NULL;
+    uint32_t n_blocks;
+    uint32_t block_idx;
+    uint32_t dnode_num;
+    uint32_t first = n_extents;
+
+    if (inode_ptr == NULL) {
+        return -1;
+    }
+    z_lengths[inode] = inode_ptr->length;
+    if (inode_ptr->length & INODE_INLINE) {
+        if (fs_revision < FS_REV_SHARED || (inode_ptr->length & INODE_LENGTH_MASK) > FS_INLINE_MAX) {
+            return -1;
+        }
+        inode_extents[inode].first = first;
+        inode_extents[inode].count = 0;
+        return 0;
+    }
+    n_blocks = (inode_ptr->length + FOUR_KB - 1) / FOUR_KB;
+    if (n_blocks > MAX_FILE_BLOCKS) {
+        return -1;
+    }
+
+    for (block_idx = 0; block_idx < n_blocks; block_idx++) {
+        dnode_num = inode_ptr->data_block_arr[block_idx];
+        if (dnode_num >= bblock.D) {
+            return -1;
+        }
+
+        /* extend the current run, or start a new one */
+        if (extent != NULL && dnode_num == extent->data_block + extent->count) {
+            extent->count++;
+            continue;
+        }
+        if (n_extents >= FS_MAX_EXTENTS) {
+            /* drop the part that fit; inode_extents still has the inode's old extents */
+            n_extents = first;
+            return -1;
+        }
+        extent = &extent_pool[n_extents++];
+        extent->data_block = dnode_num;
+        extent->file_block = block_idx;
+        extent->count = 1;
+    }
+
+    inode_extents[inode].first = first;
+    inode_extents[inode].count = n_extents - first;
+    return 0;
+}
+
+/*
+ * build_extent_map
+ * DESCRIPTION: walks every inode once and rebuilds the extent pool from scratch; also used to
+ *              compact the pool once remapped files have used it up
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if an inode is corrupt or the map doesn't fit
+ */
+static int32_t build_extent_map(void) {
+    uint32_t inode;
+
+    n_extents = 0;
+    for (inode = 0; inode < bblock.N; inode++) {
+        if (map_inode(inode) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * count_extents
+ * DESCRIPTION: counts the runs of physically consecutive blocks map_inode would give an inode
+ * INPUTS: inode: inode number (already bounds checked), not corrupt
+ * OUTPUTS: none
+ * RETURN VALUE: the number of extents
+ */
+static uint32_t count_extents(uint32_t inode) {
+    inode_t* inode_ptr = inode_addr(inode);
+    uint32_t n_blocks;
+    uint32_t block_idx;
+    uint32_t count = 0;
+
+    if (inode_ptr == NULL || (inode_ptr->length & INODE_INLINE)) {
+        return 0;
+    }
+    n_blocks = (inode_ptr->length + FOUR_KB - 1) / FOUR_KB;
+    for (block_idx = 0; block_idx < n_blocks; block_idx++) {
+        if (block_idx == 0 || inode_ptr->data_block_arr[block_idx] != inode_ptr->data_block_arr[block_idx - 1] + 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * remap_inode
+ * DESCRIPTION: replaces an inode's extents after its data blocks changed; the new extents go at
+ *              the end of the pool and the old ones are left behind until the pool fills up.
+ *              The pool is only compacted if every inode fits, so on failure all inodes keep
+ *              the extents they had, this one's describing its blocks before the change
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the map doesn't fit even after compacting
+ */
+static int32_t remap_inode(uint32_t inode) {
+    uint32_t needed = 0;
+    uint32_t it;
+
+    if (map_inode(inode) == 0) {
+        return 0;
+    }
+    for (it = 0; it < bblock.N; it++) {
+        needed += count_extents(it);
+    }
+    if (needed > FS_MAX_EXTENTS) {
+        return -1;
+    }
+    return build_extent_map();
+}
+
+/*
+ * build_free_maps
+ * DESCRIPTION: marks the data blocks of every inode, the chained directory blocks, and the inode
+ *              of every regular file dentry as in use, counting the references to each block so
+ *              shared ones are known; anything left clear can be handed out by the allocators
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void build_free_maps(void) {
+    inode_t* inode_ptr;
+    uint32_t* dentry_ptr;
+    uint32_t inode;
+    uint32_t idx;
+    uint32_t n_blocks;
+
+    memset(block_bitmap, 0, sizeof(block_bitmap));
+    memset(block_refs, 0, sizeof(block_refs));
+    memset(inode_bitmap, 0, sizeof(inode_bitmap));
+
+    /* an inode holding data is in use even if no dentry names it, so it isn't overwritten */
+    for (inode = 0; inode < bblock.N; inode++) {
+        inode_ptr = (inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1));
+        if ((inode_ptr->length & INODE_LENGTH_MASK) != 0) {
+            BITMAP_SET(inode_bitmap, inode);
+        }
+        if (inode_ptr->length & INODE_INLINE) {
+            continue;
+        }
+        n_blocks = (inode_ptr->length + FOUR_KB - 1) / FOUR_KB;
+        for (idx = 0; idx < n_blocks; idx++) {
+            BITMAP_SET(block_bitmap, inode_ptr->data_block_arr[idx]);
+            if (block_refs[inode_ptr->data_block_arr[idx]] < FS_REFS_MAX) {
+                block_refs[inode_ptr->data_block_arr[idx]]++;
+            }
+        }
+    }
+
+    for (idx = 0; idx < n_dir_blocks; idx++) {
+        BITMAP_SET(block_bitmap, dir_blocks[idx]);
+        block_refs[dir_blocks[idx]] = 1;
+    }
+
+    for (idx = 0; idx < bblock.n_dir_entries; idx++) {
+        dentry_ptr = dentry_addr(idx);
+        if (*(dentry_ptr + FN_OFFSET) == REG_FILE && *(dentry_ptr + FT_OFFSET) < bblock.N) {
+            BITMAP_SET(inode_bitmap, *(dentry_ptr + FT_OFFSET));
+        }
+    }
+}
+
+/*
+ * alloc_block
+ * DESCRIPTION: takes a free data block, searching upwards from a hint and wrapping around, so a
+ *              file that grows one block at a time stays physically contiguous where it can
+ * INPUTS: hint: data block number to try first
+ * OUTPUTS: none
+ * RETURN VALUE: data block number, or FS_NO_BLOCK if the image is full
+ */
+static uint32_t alloc_block(uint32_t hint) {
+    uint32_t it;
+    uint32_t block;
 
-    /* init open_dentry struct */
-    for (idx = 0; idx < NAME_LEN; idx++) {
-        open_dentry.filename[idx] = 0;
-        if (idx < RES_LEN) {
-            open_dentry.reserved[idx] = 0;
+    if (hint >= bblock.D) {
+        hint = 0;
+    }
+
+    for (it = 0; it < bblock.D; it++) {
+        block = hint + it;
+        if (block >= bblock.D) {
+            block -= bblock.D;
+        }
+        /* skip whole words of used blocks */
+        if ((block & 31) == 0 && block_bitmap[block >> 5] == 0xFFFFFFFF && block + 32 <= bblock.D) {
+            it += 31;
+            continue;
+        }
+        if (!BITMAP_TEST(block_bitmap, block)) {
+            BITMAP_SET(block_bitmap, block);
+            block_refs[block] = 1;
+            return block;
+        }
+    }
+
+    return FS_NO_BLOCK;
+}
+
+/*
+ * free_blocks
+ * DESCRIPTION: returns a range of a file's data blocks to the free-block bitmap and drops any
+ *              cached copies, so unflushed writes to them are never written back; a block
+ *              shared with other files only loses this reference
+ * INPUTS: inode_ptr: inode of the file
+ *         from: index within the file of the first block to free
+ *         to: index within the file one past the last block to free
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void free_blocks(inode_t* inode_ptr, uint32_t from, uint32_t to) {
+    uint32_t block_idx;
+    uint32_t dnode_num;
+
+    for (block_idx = from; block_idx < to; block_idx++) {
+        dnode_num = inode_ptr->data_block_arr[block_idx];
+        if (block_refs[dnode_num] > 1) {
+            if (block_refs[dnode_num] != FS_REFS_MAX) {
+                block_refs[dnode_num]--;
+            }
+            continue;
         }
+        block_refs[dnode_num] = 0;
+        cache_invalidate(dnode_num);
+        BITMAP_CLEAR(block_bitmap, dnode_num);
     }
-    open_dentry.filetype = 0;
-    open_dentry.inode_num = 0;
+}
 
-    /* init read_dentry struct */
-    for (idx = 0; idx < NAME_LEN; idx++) {
-        read_dentry.filename[idx] = 0;
-        if (idx < RES_LEN) {
-            read_dentry.reserved[idx] = 0;
+/*
+ * alloc_inode
+ * DESCRIPTION: takes the lowest numbered free inode and empties it
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: inode number, or FS_NO_BLOCK if every inode is in use
+ */
+static uint32_t alloc_inode(void) {
+    uint32_t inode;
+
+    for (inode = 0; inode < bblock.N; inode++) {
+        if (!BITMAP_TEST(inode_bitmap, inode)) {
+            BITMAP_SET(inode_bitmap, inode);
+            ((inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1)))->length = 0;
+            inode_extents[inode].count = 0;
+            return inode;
         }
     }
-    read_dentry.filetype = 0;
-    read_dentry.inode_num = 0;
+
+    return FS_NO_BLOCK;
+}
+
+/*
+ * image_read_block
+ * DESCRIPTION: block cache backend; copies a data block out of the image
+ * INPUTS: block: data block number
+ *         buf: FOUR_KB buffer to copy to
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 for a bad block number
+ */
+static int32_t image_read_block(uint32_t block, uint8_t* buf) {
+    if (block >= bblock.D) {
+        return -1;
+    }
+    memcpy(buf, filesys_ptr + (FOUR_KB/4)*(bblock.N + block + 1), FOUR_KB);
+    return 0;
+}
+
+/*
+ * image_write_block
+ * DESCRIPTION: block cache backend; copies a data block back into the image
+ * INPUTS: block: data block number
+ *         buf: FOUR_KB buffer to copy from
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 for a bad block number
+ */
+static int32_t image_write_block(uint32_t block, const uint8_t* buf) {
+    if (block >= bblock.D) {
+        return -1;
+    }
+    memcpy(filesys_ptr + (FOUR_KB/4)*(bblock.N + block + 1), buf, FOUR_KB);
+    return 0;
+}
+
+/*
+ * lz_read_block
+ * DESCRIPTION: block cache backend for compressed images; unpacks an inode or data block
+ * INPUTS: block: block number in the image, 1 to N for inodes and N + 1 on for data blocks
+ *         buf: FOUR_KB buffer to unpack to
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 for a bad block number or corrupt data
+ */
+static int32_t lz_read_block(uint32_t block, uint8_t* buf) {
+    uint32_t start;
+    uint32_t len;
+
+    if (block == 0 || block > bblock.N + bblock.D) {
+        return -1;
+    }
+    start = z_offsets[block - 1];
+    len = z_offsets[block] - start;
+    if (len >= FOUR_KB) {
+        memcpy(buf, (uint8_t*) filesys_ptr + start, FOUR_KB);
+        return 0;
+    }
+    return lz_decompress_block((uint8_t*) filesys_ptr + start, len, buf);
+}
+
+/*
+ * lz_write_block
+ * DESCRIPTION: block cache backend for compressed images, which are mounted read-only
+ * INPUTS: block: block number in the image
+ *         buf: FOUR_KB buffer to copy from
+ * OUTPUTS: none
+ * RETURN VALUE: -1
+ */
+static int32_t lz_write_block(uint32_t block, const uint8_t* buf) {
+    return -1;
 }
 
 /*
- * get_read_dentry
- * DESCRIPTION: returns read_dentry struct for testing purposes
+ * check_z_table
+ * DESCRIPTION: checks the block offset table of a compressed image: it must fit after the boot
+ *              block, and the blocks must follow it in order, 4-byte aligned
  * INPUTS: none
  * OUTPUTS: none
- * RETURN VALUE: address of read_dentry
+ * RETURN VALUE: 0 on success, -1 if the table is corrupt
+ */
+static int32_t check_z_table(void) {
+    uint32_t n_blocks = bblock.N + bblock.D;
+    uint32_t idx;
+
+    if (bblock.D > FS_MAX_BLOCKS || z_offsets[0] < FOUR_KB + (n_blocks + 1)*4) {
+        return -1;
+    }
+    for (idx = 0; idx < n_blocks; idx++) {
+        if ((z_offsets[idx] & 0x3) != 0 || z_offsets[idx + 1] < z_offsets[idx]) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * find_extent
+ * DESCRIPTION: binary searches an inode's extents for the one holding a block of the file
+ * INPUTS: inode: inode number for the file (already bounds checked)
+ *         block_idx: index of the block within the file
+ * OUTPUTS: none
+ * RETURN VALUE: pointer to the extent, or NULL if the file has no such block
  */
-dentry_t* get_read_dentry() {
-    return &read_dentry;
+static fs_extent_t* find_extent(uint32_t inode, uint32_t block_idx) {
+    fs_extent_t* extents = &extent_pool[inode_extents[inode].first];
+    uint32_t lo = 0;
+    uint32_t hi = inode_extents[inode].count;
+    uint32_t mid;
+
+    /* find the last extent starting at or before block_idx */
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (extents[mid].file_block <= block_idx) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    if (hi == 0 || block_idx - extents[lo].file_block >= extents[lo].count) {
+        return NULL;
+    }
+    return &extents[lo];
+}
+
+/*
+ * mount_image
+ * DESCRIPTION: validates the image whose boot block filesys_ptr points to and builds the
+ *              structs associated with file operations; a corrupt image is left unmounted
+ * INPUTS: none; fs_flags holds FS_DISK if the image is on a disk whose backend the block cache
+ *         already uses
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the image is corrupt
+ */
+static int32_t mount_image(void) {
+    /* fill in boot block structure */
+    bblock.n_dir_entries = *(filesys_ptr + 0);
+    bblock.N = *(filesys_ptr + 1);
+    bblock.D = *(filesys_ptr + 2);
+    bblock.dir_next = *(filesys_ptr + DIR_NEXT_OFFSET);
+    fs_revision = *(filesys_ptr + FS_REV_OFFSET);
+
+    /* a compressed image is read through the block cache, which unpacks blocks as they're used;
+       its offset table isn't kept in memory for one on a disk, so those can't be mounted */
+    z_offsets = NULL;
+    if (*(filesys_ptr + FS_Z_MAGIC_OFFSET) == FS_Z_MAGIC && bblock.N <= FS_MAX_INODES &&
+        (fs_flags & FS_DISK) == 0) {
+        z_offsets = filesys_ptr + FOUR_KB/4;
+        if (check_z_table() == 0) {
+            fs_flags |= FS_COMPRESSED;
+            lz_backend.read_block = lz_read_block;
+            lz_backend.write_block = lz_write_block;
+            cache_init(&lz_backend);
+        }
+    }
+
+    /* count the entries in the directory chain, and check every inode up front */
+    if (bblock.N > FS_MAX_INODES || fs_revision > FS_REV_SHARED ||
+        (*(filesys_ptr + FS_Z_MAGIC_OFFSET) == FS_Z_MAGIC && (fs_flags & FS_COMPRESSED) == 0) ||
+        read_dir_chain() != 0 || build_extent_map() != 0) {
+        filesys_ptr = NULL;
+        z_offsets = NULL;
+        fs_flags = 0;
+        bblock.n_dir_entries = 0;
+        bblock.N = 0;
+        bblock.D = 0;
+        bblock.dir_next = 0;
+        n_dir_blocks = 0;
+        return -1;
+    }
+
+    /* index the directory so lookups don't scan it */
+    build_dentry_index();
+
+    /* find the free blocks and inodes; writes go through the block cache in front of the image */
+    if ((fs_flags & FS_CACHED) == 0 && bblock.D <= FS_MAX_BLOCKS) {
+        build_free_maps();
+        image_backend.read_block = image_read_block;
+        image_backend.write_block = image_write_block;
+        cache_init(&image_backend);
+        fs_flags |= FS_WRITABLE;
+    }
+
+    return 0;
+}
+
+/*
+ * init_filesys
+ * DESCRIPTION: saves pointer to filesystem, validates it, and initiliazes all structs associated
+ *              with file operations; a corrupt image is left unmounted
+ * INPUTS: ptr: pointer to starting address of filesystem
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the image is corrupt
+ */
+int32_t init_filesys(uint32_t* ptr) {
+    /* save pointer to filesys */
+    filesys_ptr = (uint32_t*) ptr;
+    fs_flags = 0;
+    return mount_image();
+}
+
+/*
+ * init_filesys_disk
+ * DESCRIPTION: mounts an image written from block 0 of a disk, without loading it: the boot
+ *              block is copied into memory and every other block is read through the block
+ *              cache when it is used, so the image can be far bigger than memory. The mount is
+ *              read-only, and compressed images are refused
+ * INPUTS: disk: backend reading 4kB blocks of the disk, such as ata_backend
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the disk can't be read or the image is corrupt
+ */
+int32_t init_filesys_disk(cache_backend_t* disk) {
+    if (disk == NULL || disk->read_block == NULL || disk->read_block(0, (uint8_t*) disk_boot_block) != 0) {
+        return -1;
+    }
+    cache_init(disk);
+    filesys_ptr = disk_boot_block;
+    fs_flags = FS_DISK;
+    return mount_image();
+}
+
+/*
+ * get_file_size
+ * DESCRIPTION: returns file_size from input dentry struct, for testing purposes
+ * INPUTS: dentry: struct to get size of
+ * OUTPUTS: none
+ * RETURN VALUE: size of specified dentry struct
+ */
+int32_t get_file_size(dentry_t* dentry) {
+    if (dentry == NULL) {
+        return -1;
+    }
+
+    if (dentry->filetype != REG_FILE) {
+        return 0;
+    }
+
+    if (dentry->inode_num >= bblock.N) {
+        return -1;
+    }
+
+    return inode_length(dentry->inode_num);
+}
+
+/*
+ * get_fs_flags
+ * DESCRIPTION: tells how the image was mounted
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: FS_WRITABLE, FS_COMPRESSED and FS_DISK bits
+ */
+uint32_t get_fs_flags(void) {
+    return fs_flags;
+}
+
+/*
+ * read_dentry_by_name
+ * DESCRIPTION: copies dentry struct from memory to input dentry
+ * INPUTS:  fname: filename of src dentry
+ *          dentry: pointer to dest dentry
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
+    int32_t dir_idx;
+
+    /* check validity of ptrs */
+    if (fname == NULL || dentry == NULL || filesys_ptr == NULL) {
+        return -1;
+    }
+
+    if (strlen((int8_t*) fname) > NAME_LEN) {
+        return -1;
+    }
+
+    /* look fname up in the name index */
+    if ((dir_idx = find_dentry(fname)) != DENTRY_NONE) {
+        return read_dentry_by_index(dir_idx, dentry);
+    }
+
+    /* the filename wasn't found, return failure */
+    return -1;
+}
+
+/*
+ * read_dentry_by_index
+ * DESCRIPTION: copies dentry struct from memory to input dentry
+ * INPUTS:  index: index in boot block of source dentry
+ *          dentry: pointer to dest dentry
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry) {
+    int32_t name_it;
+    uint32_t str_length;
+    int8_t* temp;
+
+    int8_t* name_ptr;
+    uint32_t* dentry_ptr;
+
+    /* check validity of ptrs */
+    if (dentry == NULL) {
+        return -1;
+    }
+
+    /* check index against bounds; if outside, return failure */
+    if (index < 0 || index >= bblock.n_dir_entries) {
+        return -1;
+    }
+
+    /* create pointers */
+    dentry_ptr = dentry_addr(index);
+    name_ptr = (int8_t *) dentry_ptr;
+
+    /* copy string at current directory entry to open dentry struct */
+    str_length = strlen(name_ptr);
+    if (str_length > NAME_LEN) {
+        str_length = NAME_LEN;
+    }
+    temp = strncpy((int8_t*) dentry->filename, name_ptr, (int32_t) str_length);
+    /* zero pad name */
+    for (name_it = str_length; name_it < NAME_LEN; name_it++) {
+        dentry->filename[name_it] = 0;
+    }
+    /* copy file type */
+    dentry->filetype = *(dentry_ptr + FN_OFFSET);
+    /* ignore inode numbers for non-regular files (filetype = 0, 1) */
+    if (dentry->filetype == REG_FILE) {
+        dentry->inode_num = *(dentry_ptr + FT_OFFSET);
+    }
+    else {
+        dentry->inode_num = 0;
+    }
+
+    /* return success */
+    return 0;
+}
+
+/*
+ * stat_inode
+ * DESCRIPTION: fills in the type, inode, size and data block count of a file; only regular
+ *              files have an inode, the others report 0 for everything but the type
+ * INPUTS: type: type of the file
+ *         inode: inode number for the file
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if st is NULL or the inode is invalid
+ */
+int32_t stat_inode (uint32_t type, uint32_t inode, stat_t* st) {
+    if (st == NULL) {
+        return -1;
+    }
+
+    st->type = type;
+    st->inode = 0;
+    st->size = 0;
+    st->blocks = 0;
+    if (type != REG_FILE) {
+        return 0;
+    }
+
+    if (inode >= bblock.N) {
+        return -1;
+    }
+    st->inode = inode;
+    st->size = inode_length(inode);
+    st->blocks = (inode_length_word(inode) & INODE_INLINE) ? 0 : (st->size + FOUR_KB - 1) / FOUR_KB;
+    return 0;
+}
+
+/*
+ * stat_file
+ * DESCRIPTION: fills in the type, inode, size and data block count of a file by name, without
+ *              reading any of its data
+ * INPUTS: fname: filename of the file
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the file doesn't exist
+ */
+int32_t stat_file (const uint8_t* fname, stat_t* st) {
+    dentry_t dentry;
+
+    if (read_dentry_by_name(fname, &dentry) != 0) {
+        return -1;
+    }
+    return stat_inode(dentry.filetype, dentry.inode_num, st);
+}
+
+/*
+ * get_data_run
+ * DESCRIPTION: locates the data at a byte offset of a file and reports how much of it can be read
+ *              in one piece, i.e. up to the end of the run of consecutive data blocks holding it
+ *              or the end of the file; in a compressed image or on a disk the run is the one
+ *              block in the block cache
+ * INPUTS: inode:   inode number for the file
+ *         offset:  byte offset from the start of the file
+ *         run_ptr: set to the address of the byte at offset
+ * OUTPUTS: none
+ * RETURN VALUE:    -1 if the inode is invalid or its data is corrupt
+ *                  0 if offset is at or past the end of the file
+ *                  else, the number of contiguous bytes available at *run_ptr
+ */
+int32_t get_data_run(uint32_t inode, uint32_t offset, uint8_t** run_ptr) {
+    inode_t* inode_ptr;                     /* inode of an inline file                                          */
+    fs_extent_t* extent;                    /* run of consecutive data blocks holding offset                    */
+    uint32_t length;                        /* length of the file                                               */
+    uint32_t block_idx;                     /* index of the block holding offset within the file                */
+    uint32_t run;                           /* bytes left in the extent, capped at the end of the file          */
+    uint32_t end_block;                     /* index within the file one past the last block of the run         */
+    uint8_t* cached;                        /* cached copy of a block, unpacked or with unflushed writes        */
+    uint32_t it;
+
+    /* check validity of ptrs and inode val */
+    if (run_ptr == NULL || inode >= bblock.N) {
+        return -1;
+    }
+
+    length = inode_length(inode);
+    if (offset >= length) {
+        return 0;
+    }
+
+    /* inline data is all in the inode */
+    if (inode_length_word(inode) & INODE_INLINE) {
+        if ((inode_ptr = inode_addr(inode)) == NULL) {
+            return -1;
+        }
+        *run_ptr = (uint8_t*) inode_ptr->data_block_arr + offset;
+        return length - offset;
+    }
+
+    /* block numbers were validated when the extent map was built */
+    block_idx = offset / FOUR_KB;
+    if ((extent = find_extent(inode, block_idx)) == NULL) {
+        return 0;
+    }
+
+    end_block = extent->file_block + extent->count;
+    cached = NULL;
+    if (fs_flags & FS_CACHED) {
+        /* packed blocks are unpacked into the cache one at a time, and disk blocks read there */
+        cached = cache_get_block(bblock.N + 1 + extent->data_block + block_idx - extent->file_block, 1);
+        if (cached == NULL) {
+            return -1;
+        }
+        end_block = block_idx;
+    }
+    else if (cache_dirty_count() != 0) {
+        /* unflushed writes live in the block cache; the run stops short of the first such block */
+        for (it = block_idx; it < end_block; it++) {
+            if ((cached = cache_lookup_dirty(extent->data_block + it - extent->file_block)) != NULL) {
+                end_block = it;
+                break;
+            }
+        }
+    }
+
+    if (cached != NULL && end_block == block_idx) {
+        /* the block holding offset itself is cached, read it from there */
+        *run_ptr = cached + (offset % FOUR_KB);
+        end_block++;
+    }
+    else {
+        *run_ptr = (uint8_t*) data_block_addr(extent->data_block)
+                   + (block_idx - extent->file_block)*FOUR_KB + (offset % FOUR_KB);
+    }
+
+    run = end_block*FOUR_KB - offset;
+    if (run > length - offset) {
+        run = length - offset;
+    }
+    return run;
+}
+
+/*
+ * read_data
+ * INPUTS: inode:   inode number for the file
+ *         offset:  byte offset from the start of the file
+ *         buf:     buffer array to copy bytes to
+ *         length:  number of bytes to copy to buf
+ * OUTPUTS: none
+ * RETURN VALUE:    -1 if failure to read file
+ *                  0 upon completion of reading entire file
+ *                  else, returns the number of bytes read
+ */
+int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+    uint8_t* run_ptr;                       /* start of the current run in the data block                       */
+    int32_t run;                            /* bytes copied from the current data block                         */
+    uint32_t copied;                        /* bytes copied to buf so far                                       */
+
+    /* check validity of ptrs */
+    if (buf == NULL) {
+      return -1;
+    }
+
+    /* copy a run of consecutive data blocks (or what's left of it) at a time */
+    for (copied = 0; copied < length; copied += run) {
+        run = get_data_run(inode, offset + copied, &run_ptr);
+        if (run == -1 && copied == 0) {
+            return -1;
+        }
+        if (run <= 0) {
+            break;
+        }
+        if (run > length - copied) {
+            run = length - copied;
+        }
+        memcpy(buf + copied, run_ptr, run);
+    }
+
+    /* set end charcter for strings if numbytes requested is less than size of buf */
+    if (copied != 0 && copied < length) {
+        buf[copied] = 0;
+    }
+
+    return copied;
+}
+
+/*
+ * move_inline_data
+ * DESCRIPTION: moves the data of an inline file into a data block of its own, through the cache,
+ *              so it can be written like any other file
+ * INPUTS: inode: inode number (already bounds checked)
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the image is full
+ */
+static int32_t move_inline_data(uint32_t inode) {
+    inode_t* inode_ptr = (inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1));
+    uint32_t length = inode_ptr->length & INODE_LENGTH_MASK;
+    uint8_t* block_ptr;
+    uint32_t block;
+
+    if ((inode_ptr->length & INODE_INLINE) == 0) {
+        return 0;
+    }
+    if (length != 0) {
+        if ((block = alloc_block(0)) == FS_NO_BLOCK) {
+            return -1;
+        }
+        if ((block_ptr = cache_get_block(block, 0)) == NULL) {
+            block_refs[block] = 0;
+            BITMAP_CLEAR(block_bitmap, block);
+            return -1;
+        }
+        memset(block_ptr, 0, FOUR_KB);
+        memcpy(block_ptr, inode_ptr->data_block_arr, length);
+        cache_mark_dirty(block);
+        inode_ptr->data_block_arr[0] = block;
+    }
+    inode_ptr->length = length;
+
+    if (remap_inode(inode) != 0) {
+        /* the map still has the file inline, so put it back that way */
+        if (length != 0) {
+            memcpy(inode_ptr->data_block_arr, block_ptr, length);
+            block_refs[block] = 0;
+            cache_invalidate(block);
+            BITMAP_CLEAR(block_bitmap, block);
+        }
+        inode_ptr->length = length | INODE_INLINE;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * copy_shared_block
+ * DESCRIPTION: gives a file its own copy of a data block it shares with other files, in the
+ *              cache, before the block is written; shared blocks are never written in place, so
+ *              the image holds their contents
+ * INPUTS: inode_ptr: inode of the file
+ *         block_idx: index of the block within the file
+ * OUTPUTS: none
+ * RETURN VALUE: cached copy of the new block, or NULL if the image is full
+ */
+static uint8_t* copy_shared_block(inode_t* inode_ptr, uint32_t block_idx) {
+    uint32_t old_block = inode_ptr->data_block_arr[block_idx];
+    uint32_t new_block;
+    uint8_t* block_ptr;
+
+    new_block = alloc_block(block_idx == 0 ? old_block + 1 : inode_ptr->data_block_arr[block_idx - 1] + 1);
+    if (new_block == FS_NO_BLOCK) {
+        return NULL;
+    }
+    if ((block_ptr = cache_get_block(new_block, 0)) == NULL) {
+        block_refs[new_block] = 0;
+        BITMAP_CLEAR(block_bitmap, new_block);
+        return NULL;
+    }
+    memcpy(block_ptr, data_block_addr(old_block), FOUR_KB);
+
+    if (block_refs[old_block] != FS_REFS_MAX) {
+        block_refs[old_block]--;
+    }
+    inode_ptr->data_block_arr[block_idx] = new_block;
+    return block_ptr;
+}
+
+/*
+ * restore_blocks
+ * DESCRIPTION: gives a file back the data blocks its extents still describe, after a write
+ *              replaced shared blocks with copies the extent map couldn't take; each copy is
+ *              freed and the shared block it replaced gets its reference back
+ * INPUTS: inode: inode number (already bounds checked)
+ *         from: index within the file of the first block that may have been copied
+ *         to: index within the file one past the last such block
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void restore_blocks(uint32_t inode, uint32_t from, uint32_t to) {
+    inode_t* inode_ptr = inode_addr(inode);
+    fs_extent_t* extent;
+    uint32_t block_idx;
+    uint32_t old_block;
+
+    for (block_idx = from; block_idx < to; block_idx++) {
+        if ((extent = find_extent(inode, block_idx)) == NULL) {
+            continue;
+        }
+        old_block = extent->data_block + (block_idx - extent->file_block);
+        if (inode_ptr->data_block_arr[block_idx] == old_block) {
+            continue;
+        }
+        free_blocks(inode_ptr, block_idx, block_idx + 1);
+        inode_ptr->data_block_arr[block_idx] = old_block;
+        if (block_refs[old_block] != FS_REFS_MAX) {
+            block_refs[old_block]++;
+        }
+    }
+}
+
+/*
+ * write_data
+ * DESCRIPTION: copies bytes into a file through the block cache, allocating data blocks for the
+ *              part past the end of the file; files can't have holes, so offset may be at most
+ *              the current length. Inline data moves to a data block first, and blocks shared
+ *              with other files are copied before they are written
+ * INPUTS: inode:   inode number for the file
+ *         offset:  byte offset from the start of the file
+ *         buf:     buffer array to copy bytes from
+ *         length:  number of bytes to copy from buf
+ * OUTPUTS: none
+ * RETURN VALUE:    -1 if the image is read-only, the arguments are invalid or the new blocks
+ *                  don't fit in the extent map, in which case the file gets its old blocks
+ *                  and length back (bytes written into blocks it already had stay written)
+ *                  else, the number of bytes written, which is short if the image is full
+ */
+int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length) {
+    inode_t* inode_ptr;                     /* inode of the file being written                                  */
+    uint8_t* block_ptr;                     /* cached copy of the block being written                           */
+    uint32_t old_length;                    /* length of the file before the write                              */
+    uint32_t n_blocks;                      /* data blocks the file has                                         */
+    uint32_t n_need;                        /* data blocks the file needs to hold the write                     */
+    uint32_t dnode_num;                     /* data block being written                                         */
+    uint32_t block_off;                     /* offset of the write within that block                            */
+    uint32_t chunk;                         /* bytes written to that block                                      */
+    uint32_t written;                       /* bytes copied from buf so far                                     */
+    uint32_t fresh;                         /* the block starts past the old end of file, nothing to read in    */
+    uint32_t copied;                        /* shared blocks replaced by copies, so the file needs remapping    */
+
+    /* check validity of ptrs, inode val, and mount mode */
+    if (buf == NULL || (fs_flags & FS_WRITABLE) == 0 || inode >= bblock.N) {
+        return -1;
+    }
+
+    if (move_inline_data(inode) != 0) {
+        return -1;
+    }
+    inode_ptr = (inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1));
+    old_length = inode_ptr->length;
+    if (offset > old_length) {
+        return -1;
+    }
+    if (length > MAX_FILE_BLOCKS*FOUR_KB - offset) {
+        length = MAX_FILE_BLOCKS*FOUR_KB - offset;
+    }
+
+    /* give the file its new blocks first, each next to the one before it where possible */
+    n_blocks = (old_length + FOUR_KB - 1) / FOUR_KB;
+    n_need = (offset + length + FOUR_KB - 1) / FOUR_KB;
+    for (; n_blocks < n_need; n_blocks++) {
+        dnode_num = alloc_block(n_blocks == 0 ? 0 : inode_ptr->data_block_arr[n_blocks - 1] + 1);
+        if (dnode_num == FS_NO_BLOCK) {
+            break;
+        }
+        inode_ptr->data_block_arr[n_blocks] = dnode_num;
+    }
+    if (offset + length > n_blocks*FOUR_KB) {
+        length = n_blocks*FOUR_KB - offset;
+    }
+
+    /* copy a block at a time into the cache; the image is updated when the cache is flushed */
+    copied = 0;
+    for (written = 0; written < length; written += chunk) {
+        block_off = (offset + written) % FOUR_KB;
+        chunk = FOUR_KB - block_off;
+        if (chunk > length - written) {
+            chunk = length - written;
+        }
+
+        dnode_num = inode_ptr->data_block_arr[(offset + written) / FOUR_KB];
+        fresh = (offset + written - block_off) >= old_length;
+        if (block_refs[dnode_num] > 1) {
+            if ((block_ptr = copy_shared_block(inode_ptr, (offset + written) / FOUR_KB)) == NULL) {
+                break;
+            }
+            dnode_num = inode_ptr->data_block_arr[(offset + written) / FOUR_KB];
+            copied++;
+        }
+        else if ((block_ptr = cache_get_block(dnode_num, !fresh && chunk != FOUR_KB)) == NULL) {
+            break;
+        }
+        if (fresh && chunk != FOUR_KB) {
+            memset(block_ptr, 0, FOUR_KB);
+        }
+        memcpy(block_ptr + block_off, buf + written, chunk);
+        cache_mark_dirty(dnode_num);
+    }
+
+    if (offset + written > old_length) {
+        inode_ptr->length = offset + written;
+    }
+
+    /* give back blocks allocated for a write that couldn't finish, then remap the file */
+    if (n_blocks > (old_length + FOUR_KB - 1) / FOUR_KB) {
+        free_blocks(inode_ptr, (inode_ptr->length + FOUR_KB - 1) / FOUR_KB, n_blocks);
+    }
+    if ((n_blocks > (old_length + FOUR_KB - 1) / FOUR_KB || copied != 0) && remap_inode(inode) != 0) {
+        /* the map still describes the old blocks, so give them back to the file */
+        free_blocks(inode_ptr, (old_length + FOUR_KB - 1) / FOUR_KB, (inode_ptr->length + FOUR_KB - 1) / FOUR_KB);
+        inode_ptr->length = old_length;
+        if (copied != 0) {
+            restore_blocks(inode, offset / FOUR_KB, (old_length + FOUR_KB - 1) / FOUR_KB);
+        }
+        return -1;
+    }
+
+    return written;
+}
+
+/*
+ * filesys_set_pcb_lookup
+ * DESCRIPTION: sets the function inode_busy finds processes with, so this file doesn't need
+ *              the scheduler linked in
+ * INPUTS: pcb_of: returns the pcb of a process id, or NULL if it isn't in use
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void filesys_set_pcb_lookup(pcb_t* (*pcb_of)(uint32_t pid)) {
+    pcb_lookup = pcb_of;
+}
+
+/*
+ * inode_busy
+ * DESCRIPTION: checks whether any running process has a file open or mapped
+ * INPUTS: inode: inode number for the file
+ * OUTPUTS: none
+ * RETURN VALUE: INODE_OPEN if a process has a descriptor open on it, INODE_MAPPED if one has
+ *               it in its mmap window, both, or 0
+ */
+static int32_t inode_busy(uint32_t inode) {
+    pcb_t* pcb;
+    uint32_t pid;
+    uint32_t fd;
+    uint32_t it;
+    int32_t busy = 0;
+
+    if (pcb_lookup == NULL) {
+        return 0;
+    }
+    for (pid = 0; pid < PID_MAX; pid++) {
+        if ((pcb = pcb_lookup(pid)) == NULL) {
+            continue;
+        }
+        for (fd = 2; fd < 8; fd++) {
+            if ((pcb->file_array[fd].flags & USE_MASK) &&
+                ((pcb->file_array[fd].flags & TYPE_MASK) >> TYPE_SHIFT) == REG_FILE &&
+                pcb->file_array[fd].file_op_ptr == &file_table && pcb->file_array[fd].inode == inode) {
+                busy |= INODE_OPEN;
+            }
+        }
+        for (it = 0; it < pcb->mmap_files; it++) {
+            if (pcb->mmap_inodes[it] == inode) {
+                busy |= INODE_MAPPED;
+            }
+        }
+    }
+
+    return busy;
+}
+
+/*
+ * truncate_data
+ * DESCRIPTION: shortens a file and frees the data blocks past its new end
+ * INPUTS: inode:   inode number for the file
+ *         length:  new length, at most the current one
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the image is read-only, the arguments are invalid or a
+ *               process has the file mapped, so its blocks can't be freed
+ */
+int32_t truncate_data (uint32_t inode, uint32_t length) {
+    inode_t* inode_ptr;
+    uint32_t n_blocks;
+
+    if ((fs_flags & FS_WRITABLE) == 0 || inode >= bblock.N) {
+        return -1;
+    }
+
+    inode_ptr = (inode_t*) (filesys_ptr + (FOUR_KB/4)*(inode + 1));
+    if (length > (inode_ptr->length & INODE_LENGTH_MASK)) {
+        return -1;
+    }
+    if (length < (inode_ptr->length & INODE_LENGTH_MASK) && (inode_busy(inode) & INODE_MAPPED)) {
+        return -1;
+    }
+
+    /* inline data just gets shorter */
+    if (inode_ptr->length & INODE_INLINE) {
+        inode_ptr->length = length | INODE_INLINE;
+        return 0;
+    }
+
+    n_blocks = (inode_ptr->length + FOUR_KB - 1) / FOUR_KB;
+    inode_ptr->length = length;
+    free_blocks(inode_ptr, (length + FOUR_KB - 1) / FOUR_KB, n_blocks);
+
+    return remap_inode(inode);
 }
 
 /*
- * get_open_dentry
- * DESCRIPTION: returns open_dentry struct for testing purposes
+ * grow_dir
+ * DESCRIPTION: takes a free data block, empties it, and links it to the end of the directory
+ *              chain
  * INPUTS: none
  * OUTPUTS: none
- * RETURN VALUE: address of open_dentry
+ * RETURN VALUE: 0 on success, -1 if the chain is at its limit or the image is full
  */
-dentry_t* get_open_dentry() {
-    return &open_dentry;
+static int32_t grow_dir(void) {
+    uint32_t block;
+
+    if (n_dir_blocks >= FS_MAX_DIR_BLOCKS) {
+        return -1;
+    }
+    block = alloc_block(n_dir_blocks == 0 ? 0 : dir_blocks[n_dir_blocks - 1] + 1);
+    if (block == FS_NO_BLOCK) {
+        return -1;
+    }
+
+    dir_blocks[n_dir_blocks++] = block;
+    memset(dir_block_addr(n_dir_blocks), 0, FOUR_KB);
+    *(dir_block_addr(n_dir_blocks - 1) + DIR_NEXT_OFFSET) = block + 1;
+    if (n_dir_blocks == 1) {
+        bblock.dir_next = block + 1;
+    }
+    return 0;
 }
 
 /*
- * get_file_desc
- * DESCRIPTION: returns file_desc struct for testing purposes
+ * shrink_dir
+ * DESCRIPTION: unlinks the last chained directory block and frees it if no entries are left in it
  * INPUTS: none
  * OUTPUTS: none
- * RETURN VALUE: address of file_desc
+ * RETURN VALUE: none
  */
+static void shrink_dir(void) {
+    if (n_dir_blocks == 0 || bblock.n_dir_entries > MAX_DENTRIES*n_dir_blocks) {
+        return;
+    }
 
-file_desc_t* get_file_desc() {
-    return &file_desc;
+    n_dir_blocks--;
+    BITMAP_CLEAR(block_bitmap, dir_blocks[n_dir_blocks]);
+    block_refs[dir_blocks[n_dir_blocks]] = 0;
+    *(dir_block_addr(n_dir_blocks) + DIR_NEXT_OFFSET) = 0;
+    if (n_dir_blocks == 0) {
+        bblock.dir_next = 0;
+    }
 }
 
 /*
- * get_file_size
- * DESCRIPTION: returns file_size from input dentry struct, for testing purposes
- * INPUTS: dentry: struct to get size of
+ * create_file
+ * DESCRIPTION: adds an empty regular file to the end of the directory with a fresh inode,
+ *              chaining another directory block on when the last one is full
+ * INPUTS: fname: name of the new file, 1 to NAME_LEN characters
  * OUTPUTS: none
- * RETURN VALUE: size of specified dentry struct
+ * RETURN VALUE: 0 on success, -1 if the image is read-only, the name is invalid or taken, or
+ *               the directory or inodes are full
  */
-int32_t get_file_size(dentry_t* dentry) {
-    if (dentry == NULL) {
+int32_t create_file (const uint8_t* fname) {
+    uint32_t name_len;
+    uint32_t inode;
+    uint32_t idx;
+    uint32_t* dentry_ptr;
+
+    if (fname == NULL || (fs_flags & FS_WRITABLE) == 0) {
         return -1;
     }
 
-    uint32_t* size_ptr;
-
-    if (dentry->filetype != REG_FILE) {
-        return 0;
+    name_len = strlen((int8_t*) fname);
+    if (name_len == 0 || name_len > NAME_LEN || find_dentry(fname) != DENTRY_NONE) {
+        return -1;
+    }
+    if (bblock.n_dir_entries >= MAX_DENTRIES*(n_dir_blocks + 1) && grow_dir() != 0) {
+        return -1;
+    }
+    if ((inode = alloc_inode()) == FS_NO_BLOCK) {
+        shrink_dir();
+        return -1;
     }
 
-    size_ptr = filesys_ptr + (FOUR_KB/4)*((dentry->inode_num) + 1);
+    /* fill in the dentry after the last one, then make it visible */
+    idx = bblock.n_dir_entries;
+    dentry_ptr = dentry_addr(idx);
+    memset(dentry_ptr, 0, DENTRY_SIZE);
+    strncpy((int8_t*) dentry_ptr, (int8_t*) fname, name_len);
+    *(dentry_ptr + FN_OFFSET) = REG_FILE;
+    *(dentry_ptr + FT_OFFSET) = inode;
 
-    return *size_ptr;
+    bblock.n_dir_entries++;
+    write_dir_counts();
+    index_insert(idx);
+
+    return 0;
 }
 
 /*
- * read_dentry_by_name
- * DESCRIPTION: copies dentry struct from memory to input dentry
- * INPUTS:  fname: filename of src dentry
- *          dentry: pointer to dest dentry
+ * unlink_file
+ * DESCRIPTION: removes a regular file that no process has open, freeing its data blocks and
+ *              inode; the last dentry moves into its place so the directory stays packed, and a
+ *              chained directory block left empty is freed
+ * INPUTS: fname: name of the file
  * OUTPUTS: none
- * RETURN VALUE: 0 on success, -1 on failure
+ * RETURN VALUE: 0 on success, -1 if the image is read-only, the file doesn't exist, isn't a
+ *               regular file, or is open or mapped
  */
-int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
-    int32_t dir_it;
-    int32_t name_it;
-    uint32_t str_length;
-
-    int8_t* name_ptr = (int8_t *) filesys_ptr;
-    int8_t* temp;
+int32_t unlink_file (const uint8_t* fname) {
+    int32_t idx;
+    uint32_t last;
+    uint32_t inode;
     uint32_t* dentry_ptr;
 
-    /* check validity of ptrs */
-    if (fname == NULL || dentry == NULL || name_ptr == NULL) {
+    if (fname == NULL || (fs_flags & FS_WRITABLE) == 0 || strlen((int8_t*) fname) > NAME_LEN) {
         return -1;
     }
-
-    if (strlen((int8_t*) fname) > NAME_LEN) {
+    if ((idx = find_dentry(fname)) == DENTRY_NONE) {
         return -1;
     }
 
-    /* iterate through directory and search for fname */
-    for (dir_it = 1; dir_it <= bblock.n_dir_entries; dir_it++) {
-        /* obtain string length at current directory entry and copy filename to buffer */
-        str_length = strlen((name_ptr + DENTRY_SIZE*dir_it));
-        temp = strncpy(filename_buf, name_ptr + DENTRY_SIZE*dir_it, (int32_t) str_length);
-        /* add ending 0 so (for debugging) */
-        if (str_length < NAME_LEN) {
-            filename_buf[str_length] = 0;
-        }
-
-        /* if dentry filename and input fname match, break */
-        //min_str_length = (str_length < NAME_LEN) ? str_length : NAME_LEN;
-        if (strncmp((int8_t*) fname, filename_buf, NAME_LEN) == 0) {
-            dentry_ptr = filesys_ptr + (DENTRY_SIZE/4)*dir_it;
-            break;
-        }
-    }
-    /* if the filename wasn't found, return failure */
-    if (dir_it > bblock.n_dir_entries) {
+    dentry_ptr = dentry_addr(idx);
+    inode = *(dentry_ptr + FT_OFFSET);
+    if (*(dentry_ptr + FN_OFFSET) != REG_FILE || inode >= bblock.N || inode_busy(inode)) {
         return -1;
     }
 
-    /* else fill open_dentry struct and return success */
-    temp = strncpy((int8_t*) open_dentry.filename, filename_buf, (int32_t) str_length);
-    /* zero pad name */
-    for (name_it = str_length; name_it < NAME_LEN; name_it++) {
-        dentry->filename[name_it] = 0;
-    }
-    /* copy file type to open_dentry */
-    dentry->filetype = *(dentry_ptr + FN_OFFSET);
-    /* ignore inode numbers for non-regular files (filetype = 0, 1); else copy to open_dentry */
-    if (dentry->filetype == REG_FILE) {
-        dentry->inode_num = *(dentry_ptr + FT_OFFSET);
+    if (truncate_data(inode, 0) != 0) {
+        return -1;
     }
-    else {
-        dentry->inode_num = 0;
+    BITMAP_CLEAR(inode_bitmap, inode);
+
+    index_remove(idx);
+    last = bblock.n_dir_entries - 1;
+    if (idx != last) {
+        index_remove(last);
+        memcpy(dentry_ptr, dentry_addr(last), DENTRY_SIZE);
+        index_insert(idx);
     }
+    memset(dentry_addr(last), 0, DENTRY_SIZE);
+
+    bblock.n_dir_entries--;
+    write_dir_counts();
+    shrink_dir();
 
-    /* return success */
     return 0;
 }
 
 /*
- * read_dentry_by_index
- * DESCRIPTION: copies dentry struct from memory to input dentry
- * INPUTS:  index: index in boot block of source dentry
- *          dentry: pointer to dest dentry
+ * sync_filesys
+ * DESCRIPTION: writes every dirty cached data block back to the image in one batch
+ * INPUTS: none
  * OUTPUTS: none
- * RETURN VALUE: 0 on success, -1 on failure
+ * RETURN VALUE: 0 on success, -1 if a block couldn't be written back
  */
-int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry) {
-    int32_t name_it;
-    uint32_t str_length;
-    int8_t* temp;
+int32_t sync_filesys (void) {
+    if ((fs_flags & FS_WRITABLE) == 0) {
+        return 0;
+    }
+    return cache_flush();
+}
 
-    int8_t* name_ptr;
-    uint32_t* dentry_ptr;
+/*
+ * file_read
+ * DESCRIPTION: read operation for file system
+ * INPUTS: buf - buffer array
+ * OUTPUTS: none
+ * RETURN VALUE: -1 if invalid, 0 if success
+ */
+int32_t file_read (int32_t fd, void* buf, int32_t nbytes) {
+    int32_t ret_val;
 
     /* check validity of ptrs */
-    if (dentry == NULL) {
+    if (buf == NULL) {
         return -1;
     }
 
-    /* check index against bounds; if outside, return failure */
-    if (index < 0 || index >= bblock.n_dir_entries) {
+    /* check if a file is open and is of regular type */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE)) {
         return -1;
     }
 
-    /* create pointers */
-    name_ptr = (int8_t *) filesys_ptr;
-    dentry_ptr = filesys_ptr + (DENTRY_SIZE/4)*(index + 1);
-
-    /* copy string at current directory entry to open dentry struct */
-    str_length = strlen((name_ptr + DENTRY_SIZE*(index + 1)));
-    temp = strncpy((int8_t*) dentry->filename, name_ptr + DENTRY_SIZE*(index + 1), (int32_t) str_length);
-    /* zero pad name */
-    for (name_it = str_length; name_it < NAME_LEN; name_it++) {
-        dentry->filename[name_it] = 0;
+    ret_val = read_data((cur_pcb->file_array)[fd].inode, (cur_pcb->file_array)[fd].file_pos, buf, nbytes);
+    if (ret_val > 0) {
+        (cur_pcb->file_array)[fd].file_pos += ret_val;
     }
-    /* copy file type to open_dentry */
-    dentry->filetype = *(dentry_ptr + FN_OFFSET);
-    /* ignore inode numbers for non-regular files (filetype = 0, 1); else copy to open_dentry */
-    if (dentry->filetype == REG_FILE) {
-        dentry->inode_num = *(dentry_ptr + FT_OFFSET);
+    return ret_val;
+}
+
+/*
+ * file_pread
+ * DESCRIPTION: reads from any offset of a regular file without touching the file position; the
+ *              data block is found straight from the offset, nothing before it is read
+ * INPUTS: fd:  index of file to read
+ *         buf: buffer array
+ *         nbytes: how many bytes to read
+ *         offset: byte offset from the start of the file
+ * OUTPUTS: none
+ * RETURN VALUE: number of bytes read, 0 at or past the end of the file, -1 on failure
+ */
+int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset) {
+    /* check validity of ptrs */
+    if (buf == NULL || nbytes < 0 || fd <= 1 || fd >= 8) {
+        return -1;
     }
-    else {
-        dentry->inode_num = 0;
+
+    /* check if a file is open and is of regular type */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE)) {
+        return -1;
     }
 
-    /* return success */
-    return 0;
+    return read_data((cur_pcb->file_array)[fd].inode, offset, buf, nbytes);
 }
 
 /*
- * read_data
- * INPUTS: inode:   inode number for the file
- *         offset:  byte offset from current data block
- *         buf:     buffer array to copy bytes to
- *         length:  number of bytes to copy to buf
+ * file_sendfile
+ * DESCRIPTION: sends bytes from the file position of a regular file to another open file with
+ *              no user buffer in between: each run of data is handed to the other file's write
+ *              operation where it lies in the image (or the block cache). A write to a file of
+ *              this image could move or overwrite the run, so those are copied through a small
+ *              buffer first
+ * INPUTS: fd:  index of file to read
+ *         out_fd: index of file to write to
+ *         count: most bytes to send
  * OUTPUTS: none
- * RETURN VALUE:    -1 if failure to read file
- *                  0 upon completion of reading entire file
- *                  else, returns the number of bytes read
+ * RETURN VALUE: number of bytes sent, 0 at the end of the file, -1 on failure
  */
-int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, int32_t fd) {
-    uint32_t file_size;                     /* size of file being read                                          */
-    uint32_t dnode_num;                     /* current data block number                                        */
-    uint32_t* dnode_ptr;                    /* pointer to current data block                                    */
-    uint8_t* byte_ptr;                      /* pointer to current byte in data current data block               */
-    uint32_t inode_idx;                     /* idx of current datablock num in inode, saved file desc flags     */
-    uint32_t it;                            /* iterator for buffer operations                                   */
+int32_t file_sendfile (int32_t fd, int32_t out_fd, uint32_t count) {
+    uint8_t bounce[SENDFILE_CHUNK];
+    file_desc_t* desc;
+    file_desc_t* out;
+    uint8_t* run_ptr;
+    uint32_t sent;
+    int32_t run;
+    int32_t written;
 
-    /* check validity of ptrs */
-    if (buf == NULL) {
-      return -1;
-    }
-    /* check the validity of inode val */
-    if (inode < 0 || inode >= bblock.N) {
-      return -1;
+    if (fd <= 1 || fd >= 8) {
+        return -1;
     }
 
-    /* get the filesize of the inode */
-    file_size = *(filesys_ptr + (FOUR_KB/4)*(inode + 1));
-    /* return success if at end of file w.r.t number of bytes read*/
-    if (offset >= file_size) {
-        return 0;
+    /* check if a file is open and is of regular type */
+    desc = &(cur_pcb->file_array)[fd];
+    if (((desc->flags & USE_MASK) == 0) || (((desc->flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE)) {
+        return -1;
     }
-
-    /* get current index in inode for data block indexing; return success if at end of inode block */
-    if (fd != -1){
-		inode_idx = ((cur_pcb->file_array)[fd].flags & I_IDX_MASK) >> I_IDX_SHIFT;
-	}
-	else{
-		inode_idx = 0;
-	}
-    if (inode_idx >= FOUR_KB/4) {
-        return 0;
+    if ((out = vfs_get_fd(out_fd)) == NULL || out->file_op_ptr->write_ptr == NULL) {
+        return -1;
     }
 
-    /* get dnode_num */
-    dnode_num = *(filesys_ptr + (FOUR_KB/4)*(inode + 1) + inode_idx);
-    /* use it to get byte ptr */
-    dnode_ptr = filesys_ptr + (FOUR_KB/4)*(bblock.N + dnode_num + 1);
-    byte_ptr = (uint8_t*) dnode_ptr + (offset % FOUR_KB);
-
-    /* copy length bytes to buffer */
-    for (it = 0; it < length; it++, offset++, byte_ptr++) {
-        /* assert we haven't read all bytes */
-        if (offset >= file_size) {
-            buf[it] = 0;
-            return it;
-        }
-        /* if file_pos is a multiple of 4kB, must go to next data block */
-        /* skip checking if at position 0 */
-        if ((offset != 0) && (offset % FOUR_KB == 0)) {
-            /* reset offset and increment index in inode */
-            //cur_offset = 0;
-            inode_idx++;
-            /* if at end of inode, return */
-            if (inode_idx >= FOUR_KB/4) {
-                buf[it] = 0;
-                return it;
-            }
-            /* update current dnode number and dnode_ptr */
-            dnode_num = *(filesys_ptr + (FOUR_KB/4)*(inode + 1) + inode_idx);
-            dnode_ptr = filesys_ptr + (FOUR_KB/4)*(bblock.N + dnode_num + 1);
-            /* update byte ptr to start of next data block*/
-            byte_ptr = (uint8_t*) dnode_ptr;
-        }
-        /* while current byte denotes end of data block */
-        /* also checks if dnode_num is valid in while conditions */
-        while (dnode_num < 0 || dnode_num >= bblock.D) {
-            /* reset offset and increment index in inode */
-            //cur_offset = 0;
-            inode_idx++;
-            /* if at end of inode, return */
-            if (inode_idx >= FOUR_KB/4) {
-                buf[it] = 0;
-                return it;
+    for (sent = 0; sent < count; sent += written) {
+        if ((run = get_data_run(desc->inode, desc->file_pos, &run_ptr)) <= 0) {
+            return (run < 0 && sent == 0) ? -1 : (int32_t) sent;
+        }
+        if ((uint32_t) run > count - sent) {
+            run = count - sent;
+        }
+        if (out->file_op_ptr == &file_table) {
+            if (run > SENDFILE_CHUNK) {
+                run = SENDFILE_CHUNK;
             }
-            /* update current dnode number and dnode_ptr */
-            dnode_num = *(filesys_ptr + (FOUR_KB/4)*(inode + 1) + inode_idx);
-            dnode_ptr = filesys_ptr + (FOUR_KB/4)*(bblock.N + dnode_num + 1);
-            /* update byte ptr to start of next data block*/
-            byte_ptr = (uint8_t*) dnode_ptr;
+            memcpy(bounce, run_ptr, run);
+            run_ptr = bounce;
         }
-        /* copy to buf once byte is valid */
-        buf[it] = *byte_ptr;
+
+        if ((written = (out->file_op_ptr->write_ptr)(out_fd, run_ptr, run)) <= 0) {
+            return (sent == 0) ? written : (int32_t) sent;
+        }
+        desc->file_pos += written;
+        if (written < run) {
+            return sent + written;
+        }
+    }
+    return sent;
+}
+
+/*
+ * file_lseek
+ * DESCRIPTION: moves the file position of a regular file; files can't have holes, so the new
+ *              position has to be within the file or at its end
+ * INPUTS: fd:  index of file
+ *         offset: byte offset relative to whence
+ *         whence: SEEK_SET, SEEK_CUR or SEEK_END
+ * OUTPUTS: none
+ * RETURN VALUE: the new file position, or -1 on failure
+ */
+int32_t file_lseek (int32_t fd, int32_t offset, int32_t whence) {
+    dentry_t dentry;
+    uint32_t base;
+
+    if (fd <= 1 || fd >= 8) {
+        return -1;
     }
-    /* set end charcter for strings for it if numbytes requested is less than size of buf*/
-	if(it < length){
-		buf[it] = 0;
-	}
 
-    /* update file_pos and inode_idx flag */
-	if (fd != -1){
-		(cur_pcb->file_array)[fd].flags &= I_IDX_CLEAR;
-		(cur_pcb->file_array)[fd].flags |= inode_idx << I_IDX_SHIFT;
-	}
+    /* check if a file is open and is of regular type */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE)) {
+        return -1;
+    }
+
+    dentry.filetype = REG_FILE;
+    dentry.inode_num = (cur_pcb->file_array)[fd].inode;
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = (cur_pcb->file_array)[fd].file_pos;
+            break;
+        case SEEK_END:
+            base = get_file_size(&dentry);
+            break;
+        default:
+            return -1;
+    }
 
-    return length;
+    if ((offset < 0 && (uint32_t) -offset > base) || base + offset > (uint32_t) get_file_size(&dentry)) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].file_pos = base + offset;
+    return base + offset;
 }
 
 /*
- * file_read
- * DESCRIPTION: read operation for file system
- * INPUTS: buf - buffer array
+ * file_write
+ * DESCRIPTION: write operation for file system; writes at the file position, growing the file
+ *              when they reach past its end
+ * INPUTS: fd:  index of file to write to
+ *         buf: source of data to write
+ *         nbytes: how many bytes of data to write to file
  * OUTPUTS: none
- * RETURN VALUE: -1 if invalid, 0 if success
+ * RETURN VALUE: number of bytes written, or -1 on failure
  */
-int32_t file_read (int32_t fd, void* buf, int32_t nbytes) {
+int32_t file_write (int32_t fd, const void* buf, int32_t nbytes) {
     int32_t ret_val;
 
     /* check validity of ptrs */
-    if (buf == NULL) {
+    if (buf == NULL || nbytes < 0 || fd <= 1 || fd >= 8) {
         return -1;
     }
 
@@ -354,61 +1738,80 @@ int32_t file_read (int32_t fd, void* buf, int32_t nbytes) {
         return -1;
     }
 
-    ret_val = read_data((cur_pcb->file_array)[fd].inode, (cur_pcb->file_array)[fd].file_pos, buf, nbytes, fd);
-    (cur_pcb->file_array)[fd].file_pos += ret_val;
+    ret_val = write_data((cur_pcb->file_array)[fd].inode, (cur_pcb->file_array)[fd].file_pos, buf, nbytes);
+    if (ret_val > 0) {
+        (cur_pcb->file_array)[fd].file_pos += ret_val;
+    }
     return ret_val;
 }
 
 /*
- * file_write
- * DESCRIPTION: write operation for file system
- * INPUTS: fd:  index of file to write to (unused in CP2)
- *         buf: source of data to write
- *         nbytes: how many bytes of data to write to file
+ * file_truncate
+ * DESCRIPTION: shortens an open regular file, pulling its file position back if needed
+ * INPUTS: fd:  index of file
+ *         length: new length, at most the current one
  * OUTPUTS: none
- * RETURN VALUE: -1 for read-only
+ * RETURN VALUE: 0 on success, -1 on failure
  */
-int32_t file_write (int32_t fd, const void* buf, int32_t nbytes) {
-    return -1;
+int32_t file_truncate (int32_t fd, uint32_t length) {
+    if (fd <= 1 || fd >= MAX_FDS || (((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE) {
+        return -1;
+    }
+
+    if (truncate_data((cur_pcb->file_array)[fd].inode, length) != 0) {
+        return -1;
+    }
+    if ((cur_pcb->file_array)[fd].file_pos > length) {
+        (cur_pcb->file_array)[fd].file_pos = length;
+    }
+    return 0;
+}
+
+/*
+ * file_fstat
+ * DESCRIPTION: fills in file information for an open regular file
+ * INPUTS: fd:  index of file
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t file_fstat (int32_t fd, stat_t* st) {
+    if (fd <= 1 || fd >= MAX_FDS || (((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE) {
+        return -1;
+    }
+    return stat_inode(REG_FILE, (cur_pcb->file_array)[fd].inode, st);
 }
 
 /*
  * file_open
  * DESCRIPTION: open operation for file system
- * INPUTS: filename - the name of the file
+ * INPUTS: fd - free descriptor to set up, picked by the caller
+ *         filename - the name of the file
  * OUTPUTS: none
  * RETURN VALUE:    -1 on failure
  *                  0 otherwise
  */
-int32_t file_open (const uint8_t* filename) {
-    uint32_t i;
-
-	/* Find an empty file descriptor (should correspond to same one found in sys_open) */
-	for(i = 2; i < 8; i++){
-		// Check each entry in the file array for an unused entry
-		if((cur_pcb->file_array)[i].flags % 2 == 0){
-			break;
-		}
-	}
-	/* No empty file descriptor found */
-	if (i >= 8) {
-		return -1;
-	}
+int32_t file_open (int32_t fd, const uint8_t* filename) {
+    dentry_t dentry;
+
+    if (fd < FD_FIRST || fd >= MAX_FDS) {
+        return -1;
+    }
+
     /* assert read_dentry_by_name is successful */
-    if (read_dentry_by_name(filename, &open_dentry) == -1) {
+    if (read_dentry_by_name(filename, &dentry) == -1) {
         return -1;
     }
 
     /* assert file is of regular type */
-    if (open_dentry.filetype != REG_FILE) {
+    if (dentry.filetype != REG_FILE) {
         return -1;
     }
 
-    (cur_pcb->file_array)[i].inode = open_dentry.inode_num;        // set inode num
-    (cur_pcb->file_array)[i].file_pos = 0;                         // start at oth byte
-    (cur_pcb->file_array)[i].flags = 0x00000001;                   // mark as in use
-    (cur_pcb->file_array)[i].flags |= REG_FILE << TYPE_SHIFT;      // mark as reg type
-    (cur_pcb->file_array)[i].flags |= 0x1 << I_IDX_SHIFT;          // set inode idx to 1 (indexes to first data block in inode)
+    (cur_pcb->file_array)[fd].inode = dentry.inode_num;            // set inode num
+    (cur_pcb->file_array)[fd].file_pos = 0;                        // start at oth byte
+    (cur_pcb->file_array)[fd].flags = 0x00000001;                  // mark as in use
+    (cur_pcb->file_array)[fd].flags |= REG_FILE << TYPE_SHIFT;     // mark as reg type
 
     return 0;
 }
@@ -434,12 +1837,8 @@ int32_t file_close (int32_t fd) {
     }
 
     (cur_pcb->file_array)[fd].flags = 0;
-	int i;
-	// Clear open and read dentry
-	for(i = 0; i < 32; i++){
-		open_dentry.filename[i] = 0;
-		read_dentry.filename[i] = 0;
-	}
+    /* write back whatever the file left in the cache */
+    sync_filesys();
     return 0;
 }
 
@@ -455,6 +1854,7 @@ int32_t file_close (int32_t fd) {
  *              or -1 if fails to read file
  */
 int32_t dir_read (int32_t fd, void* buf, int32_t nbytes) {
+    dentry_t dentry;
     int32_t cnt = 0;
     uint8_t* buf_ptr = (uint8_t*) buf;
 
@@ -480,23 +1880,23 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes) {
     }
 
     /* read file name */
-    if (read_dentry_by_index((cur_pcb->file_array)[fd].file_pos, &read_dentry) == -1) {
+    if (read_dentry_by_index((cur_pcb->file_array)[fd].file_pos, &dentry) == -1) {
         return -1;
     }
 
     while ((cnt < nbytes) && (dr_buf_idx < NAME_LEN)) {
         /* break if at end of filename */
-        if (read_dentry.filename[dr_buf_idx] == 0) {
+        if (dentry.filename[dr_buf_idx] == 0) {
             break;
         }
         /* else copy to buffer and increment cnt, dr_buf_idx */
-        buf_ptr[dr_buf_idx] = read_dentry.filename[dr_buf_idx];
+        buf_ptr[dr_buf_idx] = dentry.filename[dr_buf_idx];
         dr_buf_idx++;
         cnt++;
     }
 
     /* if at end of filename or at max buffer length, reset and return done copying */
-    if ((dr_buf_idx >= NAME_LEN) || (read_dentry.filename[dr_buf_idx] == 0)) {
+    if ((dr_buf_idx >= NAME_LEN) || (dentry.filename[dr_buf_idx] == 0)) {
         buf_ptr[dr_buf_idx] = 0;
     }
 
@@ -505,58 +1905,150 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes) {
     return cnt;
 }
 
+/*
+ * dir_getdents
+ * DESCRIPTION: reads directory entries from the file position into fixed-size records, as many
+ *              as fit in the buffer, so a listing takes a few calls instead of one per name
+ * INPUTS: fd:  index of the open directory
+ *         buf: where to write the dirent_t records
+ *         nbytes: size of buf
+ * OUTPUTS: none
+ * RETURN VALUE: number of bytes written to buf (a multiple of sizeof(dirent_t)),
+ *              0 if the whole directory has been read,
+ *              or -1 if the directory isn't open or buf can't hold a record
+ */
+int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes) {
+    dirent_t* ent = (dirent_t*) buf;
+    dentry_t dentry;
+    uint32_t n_fit;
+    uint32_t cnt;
+    uint32_t pos;
+
+    /* check validity of ptrs and buffer size */
+    if (buf == NULL || nbytes < (int32_t) sizeof(dirent_t) || fd <= 1 || fd >= 8) {
+        return -1;
+    }
+
+    /* assert dir is in use */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != DIR_FILE)) {
+        return -1;
+    }
+
+    n_fit = nbytes / sizeof(dirent_t);
+    pos = (cur_pcb->file_array)[fd].file_pos;
+    for (cnt = 0; cnt < n_fit && read_dentry_by_index(pos, &dentry) == 0; cnt++, pos++) {
+        memcpy(ent[cnt].name, dentry.filename, NAME_LEN);
+        ent[cnt].name[NAME_LEN] = 0;
+        ent[cnt].pad[0] = ent[cnt].pad[1] = ent[cnt].pad[2] = 0;
+        ent[cnt].type = dentry.filetype;
+        ent[cnt].inode = dentry.inode_num;
+        ent[cnt].size = get_file_size(&dentry);
+    }
+
+    (cur_pcb->file_array)[fd].file_pos = pos;
+    return cnt * sizeof(dirent_t);
+}
+
+/*
+ * dir_lseek
+ * DESCRIPTION: moves the entry position of a directory, for dir_read and dir_getdents
+ * INPUTS: fd:  index of the open directory
+ *         offset: entries relative to whence
+ *         whence: SEEK_SET, SEEK_CUR or SEEK_END
+ * OUTPUTS: none
+ * RETURN VALUE: the new entry position, or -1 on failure
+ */
+int32_t dir_lseek (int32_t fd, int32_t offset, int32_t whence) {
+    uint32_t base;
+
+    if (fd <= 1 || fd >= 8) {
+        return -1;
+    }
+
+    /* assert dir is in use */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != DIR_FILE)) {
+        return -1;
+    }
+
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = (cur_pcb->file_array)[fd].file_pos;
+            break;
+        case SEEK_END:
+            base = bblock.n_dir_entries;
+            break;
+        default:
+            return -1;
+    }
+
+    if ((offset < 0 && (uint32_t) -offset > base) || base + offset > bblock.n_dir_entries) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].file_pos = base + offset;
+    return base + offset;
+}
+
 /*
  * dir_write
- * DESCRIPTION: write operation for directory files
- * INPUTS: fd:  index of file to write to (unused in CP2)
- *         buf: source of data to write
- *         nbytes: how many bytes of data to write to file
+ * DESCRIPTION: write operation for directory files; writing a name to the directory creates an
+ *              empty regular file with that name
+ * INPUTS: fd:  index of the open directory
+ *         buf: name of the file to create
+ *         nbytes: length of the name
  * OUTPUTS: none
- * RETURN VALUE: -1; always fails because this is a read-only file system
+ * RETURN VALUE: nbytes on success, or -1 on failure
  */
 int32_t dir_write (int32_t fd, const void* buf, int32_t nbytes) {
-    return -1;
+    uint8_t fname[NAME_LEN + 1];
+
+    /* check validity of ptrs and name length */
+    if (buf == NULL || nbytes <= 0 || nbytes > NAME_LEN || fd <= 1 || fd >= 8) {
+        return -1;
+    }
+
+    /* assert dir is in use */
+    if ((((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) || ((((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != DIR_FILE)) {
+        return -1;
+    }
+
+    memcpy(fname, buf, nbytes);
+    fname[nbytes] = 0;
+    if (create_file(fname) != 0) {
+        return -1;
+    }
+    return nbytes;
 }
 
 /*
  * dir_open
  * DESCRIPTION: open operation for directory files
- * INPUTS: filename: name of file to open
+ * INPUTS: file_idx: free descriptor to set up, picked by the caller
+ *         filename: name of file to open
  * OUTPUTS: none
  * RETURN VALUE: 0 if successful, else -1
  */
-int32_t dir_open (const uint8_t* filename) {
+int32_t dir_open (int32_t file_idx, const uint8_t* filename) {
+    dentry_t dentry;
+
     /* check validity of ptrs */
-    if (filename == NULL) {
+    if (filename == NULL || file_idx < FD_FIRST || file_idx >= MAX_FDS) {
         return -1;
     }
 
-	// Find an empty file descriptor
-	int i, file_idx;
-	file_idx = -1;
-	for(i = 2; i<8;i++){
-		// Check each entry in the file array for an unused entry
-		if((cur_pcb->file_array)[i].flags % 2 == 0){
-			file_idx = i;
-			break;
-		}
-	}
-	// No empty file descriptor found
-	if (file_idx == -1){
-		return -1;
-	}
-
     /* read dentry corresponding to filename; return failure if call fails */
-    if (read_dentry_by_name(filename, &open_dentry) == -1) {
+    if (read_dentry_by_name(filename, &dentry) == -1) {
         return -1;
     }
 
     /* assert file is of directory type */
-    if (open_dentry.filetype != DIR_FILE) {
+    if (dentry.filetype != DIR_FILE) {
         return -1;
     }
 
-    (cur_pcb->file_array)[file_idx].inode = open_dentry.inode_num;
+    (cur_pcb->file_array)[file_idx].inode = dentry.inode_num;
     (cur_pcb->file_array)[file_idx].file_pos = 0;                     // start at beginning
     (cur_pcb->file_array)[file_idx].flags = 1;                        // mark as in use
     (cur_pcb->file_array)[file_idx].flags = ((cur_pcb->file_array)[file_idx].flags) | (DIR_FILE << 1);    // mark as dir type
@@ -590,3 +2082,35 @@ int32_t dir_close (int32_t fd) {
     (cur_pcb->file_array)[fd].flags = 0;
     return 0;
 }
+
+/* operations of the files and directory in the image */
+static fd_ops_t file_table = {&file_open, &file_close, &file_read, &file_write, &file_lseek, &file_pread,
+                              NULL, &file_truncate, &file_fstat, &file_mmap, &file_sendfile};
+static fd_ops_t dir_table = {&dir_open, &dir_close, &dir_read, &dir_write, &dir_lseek, NULL, &dir_getdents};
+
+/*
+ * image_lookup
+ * DESCRIPTION: picks the operations for opening a name in the image; regular files and the
+ *              directory are handled here, other types by the driver registered for them
+ * INPUTS: name: the name in the directory
+ * OUTPUTS: none
+ * RETURN VALUE: the operations, or NULL if there's no such file or no driver for its type
+ */
+static fd_ops_t* image_lookup(const uint8_t* name) {
+    dentry_t dentry;
+
+    if (read_dentry_by_name(name, &dentry) != 0) {
+        return NULL;
+    }
+    switch (dentry.filetype) {
+        case REG_FILE:
+            return &file_table;
+        case DIR_FILE:
+            return &dir_table;
+        default:
+            return vfs_type_ops(dentry.filetype);
+    }
+}
+
+/* the image as a filesystem, mounted at the root by the kernel */
+vfs_fs_t image_fs = {&image_lookup, &stat_file, &create_file, &unlink_file};
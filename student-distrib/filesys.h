@@ -5,6 +5,8 @@
 #include "types.h"
 #include "lib.h"
 #include "pcb.h"
+#include "block_cache.h"
+#include "lz.h"
 
 
 #define FOUR_KB         0x00001000
@@ -19,6 +21,33 @@
 #define FN_OFFSET       8
 #define FT_OFFSET       9
 
+#define MAX_DENTRIES    63          /* dentries that fit in a directory block after its header  */
+#define FS_MAX_DIR_BLOCKS 64        /* directory data blocks that can be chained after the boot */
+#define FS_MAX_DENTRIES (MAX_DENTRIES*(FS_MAX_DIR_BLOCKS + 1))  /* 4095 entries in all          */
+#define DENTRY_HASH_SIZE 4096       /* buckets in the name index; must be a power of two    */
+#define DIR_NEXT_OFFSET 3           /* word of a directory block header linking the next one */
+#define DENTRY_NONE     -1          /* end of a hash chain / empty bucket                   */
+
+#define MAX_FILE_BLOCKS 1023        /* entries in an inode's data_block_arr                 */
+#define FS_MAX_INODES   4096        /* inodes the extent map can describe                   */
+#define FS_MAX_EXTENTS  8192        /* extents shared by all inodes in the extent map       */
+#define FS_MAX_BLOCKS   16384       /* data blocks the free-block bitmap can describe       */
+#define FS_NO_BLOCK     0xFFFFFFFF  /* returned by the allocators when nothing is free      */
+
+#define FS_WRITABLE     0x00000001  /* mounted image accepts writes                         */
+#define FS_COMPRESSED   0x00000002  /* mounted image is compressed; blocks go through the cache */
+#define FS_DISK         0x00000004  /* mounted from a disk; every block goes through the cache  */
+
+#define FS_Z_MAGIC_OFFSET 4         /* boot block word marking a compressed image           */
+#define FS_Z_MAGIC      0x315A5346  /* "FSZ1"                                               */
+
+#define FS_REV_OFFSET   5           /* boot block word holding the format revision          */
+#define FS_REV_SHARED   1           /* revision with shared data blocks and inline files    */
+#define INODE_INLINE    0x80000000  /* inode length flag: the data is in data_block_arr     */
+#define INODE_LENGTH_MASK 0x7FFFFFFF/* inode length without the INODE_INLINE flag           */
+#define FS_INLINE_MAX   (FOUR_KB - 4) /* bytes an inode can hold inline                     */
+#define FS_REFS_MAX     0xFFFF      /* block reference count that sticks, never freed       */
+
 #define B_ZERO_MASK     0x000000FF
 #define B_ONE_MASK      0x0000FF00
 #define B_TWO_MASK      0x00FF0000
@@ -26,21 +55,40 @@
 
 #define USE_MASK        0x00000001
 #define TYPE_MASK       0x00000006
-#define I_IDX_MASK      0x000FFF00
-#define I_IDX_CLEAR     0xFFF000FF
 
 #define TYPE_SHIFT      1
-#define I_IDX_SHIFT     8
-#define OFFSET_SHIFT    20
 
-/* boot block information, aligned to 4kB */
+#define SEEK_SET        0           /* lseek from the start of the file                     */
+#define SEEK_CUR        1           /* lseek from the file position                         */
+#define SEEK_END        2           /* lseek from the end of the file                       */
+
+#define SENDFILE_CHUNK  512         /* bytes sendfile copies at a time when it can't pass data in place */
+
+/* boot block information, aligned to 4kB                                              */
+/* directories that outgrow the boot block continue in chained directory data blocks,    */
+/* laid out like the boot block: a header whose first word counts the entries in that   */
+/* block and whose DIR_NEXT_OFFSET word links the next one, followed by 63 dentries.     */
+/* Images without a chain have 0 in that word, which is the reserved field they always  */
+/* had, and readers that don't know about chains still see the first 63 entries.        */
 typedef struct bblock {
-    uint32_t n_dir_entries;     /* number of directory entries; 4B      */
-    uint32_t N;                 /* number of inodes;            4B      */
-    uint32_t D;                 /* number of data blocks;       4B      */
-    uint32_t reserved;          /* reserved;                    4B      */
+    uint32_t n_dir_entries;     /* directory entries in the boot block and chain; 4B            */
+    uint32_t N;                 /* number of inodes;                            4B              */
+    uint32_t D;                 /* number of data blocks;                       4B              */
+    uint32_t dir_next;          /* first chained directory block + 1, 0 if none; 4B             */
 } bblock_t;
 
+/* Compressed images (mkfsimg -z) keep the boot block as is, with FS_Z_MAGIC in its     */
+/* FS_Z_MAGIC_OFFSET word, which is reserved (0) in plain images. A table of N + D + 1   */
+/* byte offsets from the start of the image follows it, one per inode and data block in  */
+/* image order plus the end of the last. Each block is packed on its own (lz.h) and      */
+/* starts 4-byte aligned; one that takes FOUR_KB or more is stored unpacked. Chained     */
+/* directory blocks are always stored unpacked, so dentries are read in place.           */
+
+/* Revision FS_REV_SHARED images (mkfsimg -d, -l) put the revision in the boot block's    */
+/* FS_REV_OFFSET word, 0 before. Several inodes, or one inode several times, may name the  */
+/* same data block, and an inode with INODE_INLINE set in its length word holds up to      */
+/* FS_INLINE_MAX bytes of data itself, starting at data_block_arr, and no data blocks.     */
+
 /* inode infromation, aligned to 4kB */
 typedef struct inode {
   uint32_t length;              /* length of the file; 4B    */
@@ -56,24 +104,76 @@ typedef struct dentry {
 } dentry_t;
 
 
-/* initializes filesystem at specified address */
-void init_filesys(uint32_t* ptr);
+/* record returned by getdents for each directory entry */
+typedef struct dirent {
+    uint8_t name[NAME_LEN + 1]; /* filename, always 0 terminated;  33B */
+    uint8_t pad[3];             /* keeps the record 4B aligned;    3B  */
+    uint32_t type;              /* type of file;                   4B  */
+    uint32_t inode;             /* inode number, 0 if not regular; 4B  */
+    uint32_t size;              /* size in bytes, 0 if not regular; 4B */
+} dirent_t;
+
+
+/* file information returned by stat and fstat */
+typedef struct stat {
+    uint32_t type;              /* type of file;                    4B  */
+    uint32_t inode;             /* inode number, 0 if not regular;  4B  */
+    uint32_t size;              /* size in bytes, 0 if not regular; 4B  */
+    uint32_t blocks;            /* data blocks used by the file;    4B  */
+} stat_t;
+
+
+/* run of physically consecutive data blocks in a file, built at mount time */
+typedef struct fs_extent {
+    uint32_t data_block;        /* first data block number of the run               */
+    uint16_t file_block;        /* index of the run's first block within the file   */
+    uint16_t count;             /* number of blocks in the run                      */
+} fs_extent_t;
+
+/* slice of the extent pool that belongs to one inode */
+typedef struct inode_extents {
+    uint16_t first;             /* index of the inode's first extent in the pool    */
+    uint16_t count;             /* number of extents, sorted by file_block          */
+} inode_extents_t;
+
+
+/* initializes filesystem at specified address; fails if the image is corrupt */
+int32_t init_filesys(uint32_t* ptr);
+/* mounts an uncompressed image stored from block 0 of a disk, read-only, through the block cache */
+int32_t init_filesys_disk(cache_backend_t* disk);
+/* sets how unlink finds the processes whose open files it must not remove: pcb_of returns */
+/* the pcb of a process id below PID_MAX, or NULL. Until it's set no file counts as open    */
+void filesys_set_pcb_lookup(pcb_t* (*pcb_of)(uint32_t pid));
 
 /* testing functions */
-/* return structs (for testing) */
-dentry_t* get_read_dentry();
-dentry_t* get_open_dentry();
-file_desc_t* get_file_desc();
 /* return filesize of input dentry (for testing) */
 int32_t get_file_size(dentry_t* dentry);
+/* FS_WRITABLE, FS_COMPRESSED and FS_DISK for the mounted image */
+uint32_t get_fs_flags(void);
 
 /* file system routines */
 /* copies dentry from src to dest by name */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 /* copies dentry from src to dest by index in boot block */
 int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
+/* finds the data at a file offset and the number of bytes readable from it in one piece */
+int32_t get_data_run(uint32_t inode, uint32_t offset, uint8_t** run_ptr);
+/* fills in file information for a file of a given type and inode */
+int32_t stat_inode (uint32_t type, uint32_t inode, stat_t* st);
+/* fills in file information for a file by name */
+int32_t stat_file (const uint8_t* fname, stat_t* st);
 /* copies specified number of bytes from data block to buffer */
-int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, int32_t fd);
+int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+/* copies bytes from buffer into a file, allocating data blocks as it grows */
+int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+/* shortens a file, freeing the data blocks past its new end */
+int32_t truncate_data (uint32_t inode, uint32_t length);
+/* adds an empty regular file to the directory */
+int32_t create_file (const uint8_t* fname);
+/* removes a regular file from the directory and frees its inode and data blocks */
+int32_t unlink_file (const uint8_t* fname);
+/* writes every dirty cached data block back to the image */
+int32_t sync_filesys (void);
 
 
 /* file driver functions */
@@ -81,8 +181,18 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 int32_t file_read (int32_t fd, void* buf, int32_t nbytes);
 /* write operation for regular files */
 int32_t file_write (int32_t fd, const void* buf, int32_t nbytes);
-/* open operation for regular files */
-int32_t file_open (const uint8_t* filename);
+/* read at an offset for regular files, leaving the file position alone */
+int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+/* sends bytes from the file position of a regular file to another open file */
+int32_t file_sendfile (int32_t fd, int32_t out_fd, uint32_t count);
+/* moves the file position of regular files */
+int32_t file_lseek (int32_t fd, int32_t offset, int32_t whence);
+/* shortens an open regular file */
+int32_t file_truncate (int32_t fd, uint32_t length);
+/* fills in file information for an open regular file */
+int32_t file_fstat (int32_t fd, stat_t* st);
+/* open operation for regular files, setting up a descriptor the caller picked */
+int32_t file_open (int32_t fd, const uint8_t* filename);
 /* close operation for regular files */
 int32_t file_close (int32_t fd);
 
@@ -92,8 +202,12 @@ int32_t file_close (int32_t fd);
 int32_t dir_read (int32_t fd, void* buf, int32_t nbytes);
 /* write operation for directory files */
 int32_t dir_write (int32_t fd, const void* buf, int32_t nbytes);
-/* open operation for directory files */
-int32_t dir_open (const uint8_t* filename);
+/* moves the entry position of directories */
+int32_t dir_lseek (int32_t fd, int32_t offset, int32_t whence);
+/* reads as many directory records as fit in the buffer */
+int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes);
+/* open operation for directory files, setting up a descriptor the caller picked */
+int32_t dir_open (int32_t fd, const uint8_t* filename);
 /* close operation for directory files */
 int32_t dir_close (int32_t fd);
 
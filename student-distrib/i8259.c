@@ -9,6 +9,9 @@
 uint8_t master_mask; /* IRQs 0-7  */
 uint8_t slave_mask;  /* IRQs 8-15 */
 
+/* interrupts taken on each line, counted by the assembly linkage in exceptions.S */
+uint32_t irq_counts[NUM_IRQS];
+
 /*	i8259_init()
  *	Initialize the 8259 PIC 
  *
@@ -13,6 +13,7 @@
 #define SLAVE_8259_PORT     0xA0
 #define PIC_MASTER_IDT 0x20
 #define PIC_SLAVE_IDT 0x28
+#define NUM_IRQS            16      /* lines on the master and slave PICs together */
 
 /* Initialization control words to init each PIC.
  * See the Intel manuals for details on the meaning
@@ -37,6 +38,9 @@
 #define RTC_IDT 0x21
 #define RTC_6_BIT 0x40
 
+/* interrupts taken on each line since boot */
+extern uint32_t irq_counts[NUM_IRQS];
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -13,6 +13,16 @@
 #include "filesys.h"
 #include "rtc_driver.h"
 #include "key_driver.h"
+#include "vfs.h"
+#include "tmpfs.h"
+#include "procfs.h"
+#include "ata.h"
+#include "pci.h"
+#include "virtio_blk.h"
+#include "pit.h"
+#include "sched.h"
+#include "palloc.h"
+#include "slab.h"
 
 #define RUN_TESTS
 /* Macros. */
@@ -133,7 +143,7 @@ void set_idt_entry(unsigned int vector_number, void* in_function()){
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
-	uint32_t filesys_addr;
+	uint32_t filesys_addr = 0;
 
     /* Clear the screen. */
     clear();
@@ -167,7 +177,9 @@ void entry(unsigned long magic, unsigned long addr) {
         int i;
         module_t* mod = (module_t*)mbi->mods_addr;
 		/* filesys_img addr is the 0th module */
-		filesys_addr = mod->mod_start;
+		if (mbi->mods_count > 0) {
+			filesys_addr = mod->mod_start;
+		}
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
             printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
@@ -211,6 +223,43 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_low);
     }
 
+    /* Give the RAM in the memory map to the frame allocator, less the kernel and the modules */
+    palloc_init();
+    if (CHECK_FLAG(mbi->flags, 3)) {
+        unsigned int mod_idx;
+        module_t* mod = (module_t*)mbi->mods_addr;
+        for (mod_idx = 0; mod_idx < mbi->mods_count; mod_idx++, mod++) {
+            palloc_reserve(mod->mod_start, mod->mod_end);
+        }
+    }
+    if (CHECK_FLAG(mbi->flags, 6)) {
+        memory_map_t *mmap;
+        for (mmap = (memory_map_t *)mbi->mmap_addr;
+                (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
+                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size))) {
+            /* only usable RAM below 4GB */
+            if (mmap->type != MULTIBOOT_MEMORY_AVAILABLE || mmap->base_addr_high != 0) {
+                continue;
+            }
+            if (mmap->length_high != 0 || mmap->base_addr_low + mmap->length_low < mmap->base_addr_low) {
+                palloc_add(mmap->base_addr_low, 0xFFFFFFFF);
+            }
+            else {
+                palloc_add(mmap->base_addr_low, mmap->base_addr_low + mmap->length_low);
+            }
+        }
+    }
+    else if (CHECK_FLAG(mbi->flags, 0)) {
+        palloc_add(LOW_MEM_TOP, LOW_MEM_TOP + mbi->mem_upper * 1024);
+    }
+    else {
+        palloc_add(KER_ADDR, PALLOC_DEFAULT_TOP);
+    }
+    /* The kernel's object caches take their slabs from it */
+    slab_init();
+    sched_init();
+    filesys_set_pcb_lookup(&sched_pcb);
+
     /* Construct an LDT entry in the GDT */
     {
         seg_desc_t the_ldt_desc;
@@ -269,10 +318,18 @@ void entry(unsigned long magic, unsigned long addr) {
 		disable_irq(i);
 	}
 
-	// Enable the RTC
+	// Enable the RTC, and register it and the terminal for opening
 	rtc_init();
+	terminal_init();
+	// Start the timer that drives the scheduler
+	set_idt_entry(PIT_IDT, (void *)PIT_HANDLER);
+	pit_init(PIT_HZ);
 	set_idt_entry(PIC_SLAVE_IDT, (void *)RTC_HANDLER);
 	set_idt_entry(PIC_MASTER_IDT+1, (void *)KEY_HANDLER);
+	set_idt_entry(ATA_IDT, (void *)ATA_HANDLER);
+	set_idt_entry(PIC_SLAVE_IDT+1, (void *)PCI_IRQ9_HANDLER);
+	set_idt_entry(PIC_SLAVE_IDT+2, (void *)PCI_IRQ10_HANDLER);
+	set_idt_entry(PIC_SLAVE_IDT+3, (void *)PCI_IRQ11_HANDLER);
 
 	// Initialize and Fill the IDT
 	// Fill the idt table with exceptions
@@ -287,8 +344,29 @@ void entry(unsigned long magic, unsigned long addr) {
     sti();
 
 	init_paging();
-
-	init_filesys((uint32_t*) filesys_addr);
+	pci_init();
+	ata_init();
+	virtio_blk_init();
+
+	/* without a filesystem module, mount the image from a disk, virtio first */
+	if (filesys_addr == 0) {
+		if ((virtio_blk_block_count() == 0 || init_filesys_disk(&virtio_blk_backend) != 0) &&
+			(ata_block_count() == 0 || init_filesys_disk(&ata_backend) != 0)) {
+			printf("No filesystem module or disk image, not mounted\n");
+		}
+		else {
+			vfs_mount((uint8_t*) "", &image_fs);
+		}
+	}
+	else if (init_filesys((uint32_t*) filesys_addr) != 0) {
+		printf("Filesystem image is corrupt, not mounted\n");
+	}
+	else {
+		vfs_mount((uint8_t*) "", &image_fs);
+	}
+	tmpfs_init();
+	vfs_mount((uint8_t*) TMPFS_MOUNT, &tmpfs_fs);
+	vfs_mount((uint8_t*) PROCFS_MOUNT, &procfs_fs);
 #ifdef RUN_TESTS
     /* Run tests */
     clear();
@@ -296,6 +374,12 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Execute the first program ("shell") ... */
     /* Spin (nicely, so we don't chew up cycles) */
 	set_screen(0,0);
+	// The other terminals' shells run in the background and start again when they exit
+	for (i = 1; i < NUM_TERMINALS; i++) {
+		if (spawn_program((uint8_t*) "shell", SCHED_RESPAWN, i) != 0) {
+			printf("Can't start a shell on terminal %d\n", i);
+		}
+	}
 	// Execute
 	while (1) {
 		asm("movl %0, %%ebx\n"
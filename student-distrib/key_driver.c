@@ -2,6 +2,18 @@
 #include "i8259.h"
 #include "lib.h"
 #include "pcb.h"
+#include "vfs.h"
+#include "sched.h"
+#include "paging_c.h"
+#include "paging.h"
+
+static fd_ops_t terminal_table = {&terminal_open, &terminal_close, &terminal_read, &terminal_write};
+
+static terminal_t terminals[NUM_TERMINALS];
+/* the terminal on the screen, whose text is in video memory and cursor in lib.c */
+static uint32_t visible;
+/* screens of the terminals while they are hidden */
+static char backing[NUM_TERMINALS][FOUR_KB] __attribute__((aligned(FOUR_KB)));
 
 /*this array holds the correct keys for the normal input, shifted input, and capslock input
 */
@@ -166,9 +178,10 @@ extern void key_handler(){
 	unsigned char symbol = key_array[dict][input];
 
 
+	terminal_t* term = &terminals[visible];
+
 	//putc(input);
 	//putc(symbol);
-	enter_flag = 0;
 	mode_flag = 0;
 
 	/* handle left and right shift keys */
@@ -196,6 +209,20 @@ extern void key_handler(){
 		mode_flag = 1;
 	}
 
+	/* handle ALT, and ALT+F1.. to switch terminals */
+	if (input == ALT_PRESSED) {
+		alt_mode = 1;
+		mode_flag = 1;
+	}
+	else if (input == ALT_RELEASED) {
+		alt_mode = 0;
+		mode_flag = 1;
+	}
+	else if (alt_mode && input >= F1_PRESSED && input < F1_PRESSED + NUM_TERMINALS) {
+		terminal_switch(input - F1_PRESSED);
+		mode_flag = 1;
+	}
+
 	/* change dictionary according to shift and caps combo */
 	if (shift_mode && caps_mode) {
 		dict = 0;
@@ -219,10 +246,10 @@ extern void key_handler(){
 	when the keyboard reads a backspace, it deletes the previous character in the key_buffer
 	it also deletes the previous character on the screen itself by working with video memory*/
 	else if(symbol == '\b'){
-		if(key_buf_index>0){
-			deletec_terminal(key_buf[key_buf_index -1]);
-			key_buf[key_buf_index] = 0;
-			key_buf_index -= 1;
+		if(term->key_buf_index>0){
+			deletec_terminal(term->key_buf[term->key_buf_index -1]);
+			term->key_buf[term->key_buf_index] = 0;
+			term->key_buf_index -= 1;
 		}
 	}
 
@@ -231,10 +258,10 @@ extern void key_handler(){
 
 	/*after taking care of the special cases, print the character to the screen */
 	else {
+		process_to_buffer(input);
 		if (symbol == '\n'){
-			enter_flag = 1;
+			term->enter_flag = 1;
 		}
-		process_to_buffer(input);
 	}
 
 	send_eoi(1);
@@ -257,7 +284,7 @@ void process_to_buffer(unsigned char input) {
 			set_screen(0,0);
 		}
 	}
-	else if (key_buf_index < KEY_BUF_SIZE) {
+	else if (terminals[visible].key_buf_index < KEY_BUF_SIZE) {
 		putc_terminal(symbol);
 		add_to_buffer(symbol);
 	}
@@ -268,35 +295,119 @@ void process_to_buffer(unsigned char input) {
 /* void add_to_buffer();
  * Inputs: char to be added to the key buffer
  * Return Value: none
- * Function: handles keyboard interrupt to display on the console */
+ * Function: adds a typed character to the key buffer of the terminal on the screen */
 void add_to_buffer(char symbol){
-	if (key_buf_index < KEY_BUF_SIZE){
-		key_buf[key_buf_index] = symbol;
-		key_buf_index += 1;
+	terminal_t* term = &terminals[visible];
+
+	if (term->key_buf_index < KEY_BUF_SIZE){
+		term->key_buf[term->key_buf_index] = symbol;
+		term->key_buf_index += 1;
 	}
 }
 
 
 
 /* void clear_key_buffer();
- * Inputs: none
+ * Inputs: term, the terminal
  * Return Value: none
  * Function: clears the key_buffer and resets the key buffer index */
-void clear_key_buffer(){
+void clear_key_buffer(terminal_t* term){
 	int i;
 	for (i = 0; i < KEY_BUF_SIZE; i++){
-		key_buf[i] = 0;
+		term->key_buf[i] = 0;
+	}
+	term->key_buf_index = 0;
+}
+
+
+/* void terminal_init();
+ * Inputs: none
+ * Return Value: none
+ * Function: registers the terminal driver, which stdin and stdout of every process use, and
+ *           blanks the screens of the hidden terminals */
+void terminal_init() {
+	char* vmem = getvmem();
+	int x = get_screen_x();
+	int y = get_screen_y();
+	uint32_t it;
+
+	vfs_register_type(TERMINAL_FILE, &terminal_table);
+	for (it = 0; it < NUM_TERMINALS; it++) {
+		terminals[it].video = backing[it];
+		set_output(terminals[it].video, 0, 0, 0);
+		clear();
+	}
+	set_output(vmem, x, y, 1);
+	visible = 0;
+}
+
+
+/* uint32_t terminal_visible();
+ * Inputs: none
+ * Return Value: the terminal on the screen
+ * Function: none */
+uint32_t terminal_visible(void) {
+	return visible;
+}
+
+
+/* void terminal_switch();
+ * Inputs: term, the terminal to show
+ * Return Value: none
+ * Function: swaps screens: the text on the screen goes to the backing page of the terminal
+ *           being hidden, and the shown one's backing page is copied to the screen. Its
+ *           programs write video memory from then on, and the ones left behind their
+ *           backing page. Called from the keyboard interrupt */
+void terminal_switch(uint32_t term) {
+	terminal_t* old = &terminals[visible];
+
+	if (term >= NUM_TERMINALS || term == visible) {
+		return;
+	}
+	old->screen_x = get_screen_x();
+	old->screen_y = get_screen_y();
+	memcpy(old->video, getvmem(), TERMINAL_VIDEO_SIZE);
+	memcpy(getvmem(), terminals[term].video, TERMINAL_VIDEO_SIZE);
+	visible = term;
+	set_screen(terminals[term].screen_x, terminals[term].screen_y);
+
+	/* the running program may have just been hidden or shown */
+	terminal_map_video(cur_pcb);
+	lpdt(ret_dir_ptr());
+}
+
+
+/* void terminal_map_video();
+ * Inputs: pcb, the process about to run, or NULL for the kernel
+ * Return Value: none
+ * Function: points the page sys_vidmap_c hands out at the process's screen: video memory if
+ *           its terminal is shown, else the terminal's backing page, so hidden programs
+ *           draw into memory. The caller flushes the TLB */
+void terminal_map_video(pcb_t* pcb) {
+	pt_entry_t* page = get_pageTable_entry(USER_VMEM, VID_ADDR >> 12);
+
+	if (page == NULL) {
+		return;
+	}
+	if (pcb == NULL || pcb->terminal == visible) {
+		page->page_base_addr = VID_ADDR >> 12;
+	}
+	else {
+		page->page_base_addr = ((uint32_t) terminals[pcb->terminal].video) >> 12;
 	}
-	key_buf_index = 0;
 }
 
 
 /* int terminal_open();
- * Inputs: pointer to a uint8, a filename
+ * Inputs: a file descriptor picked by the caller, pointer to a uint8, a filename
  * Return Value: 0 on success
  * Function: sets up use of keyboard and of terminal read and write functions */
-int terminal_open(const uint8_t* filename) {
+int terminal_open(int32_t fd, const uint8_t* filename) {
+	if (fd < 0 || fd >= MAX_FDS) {
+		return -1;
+	}
     keyboard_environment();
+	(cur_pcb->file_array)[fd].flags = USE_MASK | (TERMINAL_FILE << TYPE_SHIFT);
 	return 0;
 }
 
@@ -330,6 +441,7 @@ int terminal_read(int32_t fd, void* buf, int32_t nbytes) {
 	//clear_key_buffer();
 	uint32_t i;
 	int8_t* buffer = (int8_t*) buf;
+	terminal_t* term = &terminals[(cur_pcb == NULL) ? visible : cur_pcb->terminal];
 
 	/* assert can only write to stdout */
 	if (fd != STDIN) {
@@ -339,18 +451,21 @@ int terminal_read(int32_t fd, void* buf, int32_t nbytes) {
 
 
 	//wait for enter key to be pressed, when it is pressed, you should copy the key buffer into the passed in location
-	clear_key_buffer();
+	clear_key_buffer(term);
+	term->enter_flag = 0;
 	while (1) {
-		if (enter_flag == 1) {
+		if (term->enter_flag == 1) {
 
-			for (i = 0; i < key_buf_index; i++) {
-				buffer[i] = key_buf[i];
+			for (i = 0; i < term->key_buf_index; i++) {
+				buffer[i] = term->key_buf[i];
 			}
 			break;
 		}
+		/* let other programs run while this one waits for a line */
+		sched_yield();
 	}
-	enter_flag = 0;
-	clear_key_buffer();
+	term->enter_flag = 0;
+	clear_key_buffer(term);
 	return i;
 }
 
@@ -358,10 +473,14 @@ int terminal_read(int32_t fd, void* buf, int32_t nbytes) {
 /* int terminal_write();
  * Inputs: file descriptor, buffer, number of bytes to be written
  * Return Value: number of bytes written
- * Function: writes from the buffer passed in, to the screen*/
+ * Function: writes from the buffer passed in to the screen of the process's terminal, which
+ *           is the backing page if the terminal is hidden */
 int terminal_write(int32_t fd, const void* buf, int32_t nbytes) {
 	int32_t index;
 	int8_t* inbuf = (int8_t*) buf;
+	terminal_t* term;
+	char* vmem;
+	int x, y;
 
 	/* assert can only write to stdout */
 	if (fd != STDOUT) {
@@ -369,11 +488,23 @@ int terminal_write(int32_t fd, const void* buf, int32_t nbytes) {
 	}
 
 	cli();
+	term = (cur_pcb == NULL || cur_pcb->terminal == visible) ? NULL : &terminals[cur_pcb->terminal];
+	if (term != NULL) {
+		vmem = getvmem();
+		x = get_screen_x();
+		y = get_screen_y();
+		set_output(term->video, term->screen_x, term->screen_y, 0);
+	}
 	index = 0;
 	while (index < nbytes) {
 		putc_terminal(inbuf[index]);
 		index++;
 	}
+	if (term != NULL) {
+		term->screen_x = get_screen_x();
+		term->screen_y = get_screen_y();
+		set_output(vmem, x, y, 1);
+	}
 	sti();
 
 	return index;
@@ -2,6 +2,7 @@
 #define _KEY_DRIVE_H
 
 #include "types.h"
+#include "pcb.h"
 #define LSHIFT_PRESSED      0x2A
 #define LSHIFT_RELEASED	    0xAA
 #define RSHIFT_PRESSED	    0x36
@@ -10,6 +11,9 @@
 #define CTRL_RELEASED       0x9D
 #define CAPS_PRESSED        0x3A
 #define BACKSPACE           0x0E
+#define ALT_PRESSED         0x38
+#define ALT_RELEASED        0xB8
+#define F1_PRESSED          0x3B        /* F2 and F3 follow */
 
 
 #define KEY_BUF_SIZE        128
@@ -19,11 +23,18 @@
 #define STDOUT              1
 #define NAME_LEN            32
 
-//volatile char[buffer_size] key_buffer;
-char key_buf[KEY_BUF_SIZE];
+#define NUM_TERMINALS       3           /* switched between with Alt+F1, F2, ...        */
+#define TERMINAL_VIDEO_SIZE (80*25*2)   /* bytes of a text screen, character and attribute */
 
-volatile int key_buf_index;
-volatile int enter_flag;
+/* a virtual terminal: its line of input and, while hidden, its screen and cursor */
+typedef struct terminal {
+    char key_buf[KEY_BUF_SIZE];         /* keys typed since the last read              */
+    volatile int key_buf_index;
+    volatile int enter_flag;            /* set when a line is ready for terminal_read   */
+    int screen_x;                       /* cursor while hidden; lib.c has it while shown */
+    int screen_y;
+    char* video;                        /* 4kB backing page holding the screen while hidden */
+} terminal_t;
 
 
 
@@ -32,6 +43,7 @@ volatile int ctrl_mode;
 volatile int caps_mode;
 volatile int shift_mode;
 volatile int mode_flag;
+volatile int alt_mode;
 
 
 void key_open();
@@ -40,9 +52,16 @@ extern void key_handler();
 
 void process_to_buffer(unsigned char input);
 void add_to_buffer(char input);
-void clear_key_buffer();
+void clear_key_buffer(terminal_t* term);
 void keyboard_environment();
-int terminal_open(const uint8_t* filename);
+void terminal_init();
+/* shows another terminal, swapping its backing page with the screen */
+void terminal_switch(uint32_t term);
+/* the terminal on the screen */
+uint32_t terminal_visible(void);
+/* points the user video page at a process's screen; the caller flushes the TLB */
+void terminal_map_video(pcb_t* pcb);
+int terminal_open(int32_t fd, const uint8_t* filename);
 int terminal_close(int32_t fd);
 int terminal_read(int32_t fd, void* buf, int32_t nbytes);
 int terminal_write(int32_t fd, const void* buf, int32_t nbytes);
@@ -12,6 +12,7 @@
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
+static int show_cursor = 1;
 static int tab_size = 3;
 
 /* void clear(void);
@@ -58,11 +59,26 @@ void set_screen(int x, int y){
 }
 
 
+/* void set_output();
+ * Inputs: vmem, a text buffer laid out like video memory; x and y, the position in it;
+ *         cursor, whether the hardware cursor follows the position
+ * Return Value: none
+ * Function: makes printing go to another buffer, such as a hidden terminal's screen */
+void set_output(char* vmem, int x, int y, int cursor){
+    video_mem = vmem;
+    show_cursor = cursor;
+    set_screen(x, y);
+}
+
+
 /* void set_cursor_pos;
  * Inputs: none
  * Return Value: none
  * Function: updates cursor to the correct position on the screen */
 void set_cursor_pos() {
+        if (!show_cursor) {
+            return;
+        }
         uint16_t position = NUM_COLS*screen_y + screen_x;
         outw(0x000E | (position & 0xFF00), 0x03D4);
         outw(0x000F | ((position << 8) & 0xFF00), 0x03D4);
@@ -549,6 +565,25 @@ void* memmove(void* dest, const void* src, uint32_t n) {
     return dest;
 }
 
+/* int32_t memcmp(const void* s1, const void* s2, uint32_t n)
+ * Inputs: const void* s1 = first memory area to compare
+ *         const void* s2 = second memory area to compare
+ *             uint32_t n = number of bytes to compare
+ * Return Value: zero if the first n bytes are equal, else the difference
+ *               of the first pair of bytes that differ
+ * Function: compares two memory areas byte by byte, ignoring '\0' */
+int32_t memcmp(const void* s1, const void* s2, uint32_t n) {
+    const uint8_t* p1 = (const uint8_t*) s1;
+    const uint8_t* p2 = (const uint8_t*) s2;
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        if (p1[i] != p2[i]) {
+            return p1[i] - p2[i];
+        }
+    }
+    return 0;
+}
+
 /* int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n)
  * Inputs: const int8_t* s1 = first string to compare
  *         const int8_t* s2 = second string to compare
@@ -0,0 +1,102 @@
+#include "lz.h"
+#include "lib.h"
+
+/*
+ * read_length
+ * DESCRIPTION: finishes a literal or match length whose nibble was LZ_NIBBLE_MAX by adding the
+ *              extra length bytes
+ * INPUTS: len: length so far
+ *         in: read position, advanced past the extra bytes
+ *         in_end: end of the packed data
+ * OUTPUTS: none
+ * RETURN VALUE: the full length, or LZ_BLOCK_SIZE + 1 if the data runs out (always too long)
+ */
+static uint32_t read_length(uint32_t len, const uint8_t** in, const uint8_t* in_end) {
+    uint8_t ext;
+
+    do {
+        if (*in >= in_end || len > LZ_BLOCK_SIZE) {
+            return LZ_BLOCK_SIZE + 1;
+        }
+        ext = *(*in)++;
+        len += ext;
+    } while (ext == 255);
+
+    return len;
+}
+
+/*
+ * lz_decompress_block
+ * DESCRIPTION: unpacks one block of a compressed image (format in lz.h), checking every length
+ *              and offset so corrupt data can't write outside dst
+ * INPUTS: src: packed block
+ *         src_len: bytes of packed data; anything after the sequence that fills the block is
+ *                  ignored
+ *         dst: LZ_BLOCK_SIZE buffer to unpack into
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the packed data is corrupt or doesn't fill the block
+ */
+int32_t lz_decompress_block(const uint8_t* src, uint32_t src_len, uint8_t* dst) {
+    const uint8_t* in = src;
+    const uint8_t* in_end = src + src_len;
+    uint32_t out = 0;
+    uint32_t token;
+    uint32_t len;
+    uint32_t offset;
+
+    if (src == NULL || dst == NULL) {
+        return -1;
+    }
+
+    while (out < LZ_BLOCK_SIZE) {
+        if (in >= in_end) {
+            return -1;
+        }
+        token = *in++;
+
+        /* literals */
+        len = token >> 4;
+        if (len == LZ_NIBBLE_MAX) {
+            len = read_length(len, &in, in_end);
+        }
+        if (len > LZ_BLOCK_SIZE - out || len > (uint32_t) (in_end - in)) {
+            return -1;
+        }
+        memcpy(dst + out, in, len);
+        in += len;
+        out += len;
+        if (out == LZ_BLOCK_SIZE) {
+            break;
+        }
+
+        /* match; one that overlaps what it produces repeats its first offset bytes */
+        if (in_end - in < 2) {
+            return -1;
+        }
+        offset = in[0] | (in[1] << 8);
+        in += 2;
+        len = token & LZ_NIBBLE_MAX;
+        if (len == LZ_NIBBLE_MAX) {
+            len = read_length(len, &in, in_end);
+        }
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out || len > LZ_BLOCK_SIZE - out) {
+            return -1;
+        }
+        if (offset >= len) {
+            memcpy(dst + out, dst + out - offset, len);
+            out += len;
+        }
+        else if (offset == 1) {
+            memset(dst + out, dst[out - 1], len);
+            out += len;
+        }
+        else {
+            for (; len != 0; len--, out++) {
+                dst[out] = dst[out - offset];
+            }
+        }
+    }
+
+    return 0;
+}
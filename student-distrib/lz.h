@@ -0,0 +1,19 @@
+#ifndef _LZ_H
+#define _LZ_H
+
+#include "types.h"
+
+/* Blocks of compressed filesystem images are packed one 4kB block at a time as a series of  */
+/* sequences: a token byte whose high nibble is the number of literal bytes that follow and  */
+/* whose low nibble is the length of the match after them minus LZ_MIN_MATCH, then the      */
+/* literals, then a 2-byte little-endian offset back into the output to copy the match      */
+/* from. A nibble of 15 continues in the following bytes, each added in, until one is not   */
+/* 255. The sequence that fills the block ends after its literals, with no offset.          */
+#define LZ_BLOCK_SIZE   0x1000      /* bytes in an unpacked block                       */
+#define LZ_MIN_MATCH    4           /* shortest match worth a sequence                  */
+#define LZ_NIBBLE_MAX   15          /* nibble value continued in extra length bytes     */
+
+/* unpacks one block; 0 on success, -1 if the packed data is corrupt */
+int32_t lz_decompress_block(const uint8_t* src, uint32_t src_len, uint8_t* dst);
+
+#endif /* _LZ_H */
@@ -0,0 +1,233 @@
+#include "mmap.h"
+#include "paging.h"
+#include "filesys.h"
+#include "lib.h"
+#include "palloc.h"
+
+/* each process has its own page table, pcb->mmap_table, pointed to by page_directory[MMAP_IDX] */
+/* while it runs; pcb->mmap_used pages of it are handed out, and never reused until release     */
+
+/* private copies made on write faults, in frames of the kernel zone */
+static uint32_t cow_in_use;
+
+/*
+ * cow_alloc
+ *   DESCRIPTION: takes a frame for a private copy, unless MMAP_COW_FRAMES are in use already
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: address of the frame, or NULL if there's none to have
+ *   SIDE EFFECTS: none
+ */
+static uint8_t* cow_alloc(void) {
+    uint8_t* frame;
+
+    if (cow_in_use >= MMAP_COW_FRAMES || (frame = kpage_alloc(1)) == NULL) {
+        return NULL;
+    }
+    cow_in_use++;
+    return frame;
+}
+
+/*
+ * cow_free
+ *   DESCRIPTION: gives back a frame from cow_alloc
+ *   INPUTS: frame: address of the frame
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void cow_free(uint8_t* frame) {
+    kpage_free(frame, 1);
+    cow_in_use--;
+}
+
+/*
+ * mmap_file
+ *   DESCRIPTION: maps all of a regular file read-only into the current process's mmap window,
+ *                one 4kB page table entry per data block; the blocks don't have to be
+ *                contiguous in the image, the page table stitches them together. Writes to
+ *                the mapping fault and get a private copy of the page. The inode is recorded
+ *                in the pcb until release, so the filesystem won't free blocks the mapping
+ *                still points at
+ *   INPUTS: inode: inode number of the file; start: set to the user address of the mapping
+ *   OUTPUTS: none
+ *   RETURN VALUE: length of the file on success, -1 if the window is full, MMAP_MAX_FILES other
+ *                 files are mapped, the data isn't page aligned or the image is compressed
+ *   SIDE EFFECTS: flushes the TLB
+ */
+int32_t mmap_file(uint32_t inode, uint8_t** start) {
+    pt_entry_t* table;
+    pt_entry_t page;
+    uint8_t* run_ptr;
+    int32_t run;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t base;
+    uint32_t slot;
+    uint32_t it;
+
+    if (cur_pcb == NULL || start == NULL) {
+        return -1;
+    }
+    for (slot = 0; slot < cur_pcb->mmap_files && cur_pcb->mmap_inodes[slot] != inode; slot++);
+    if (slot == MMAP_MAX_FILES) {
+        return -1;
+    }
+
+    table = cur_pcb->mmap_table;
+    base = cur_pcb->mmap_used;
+
+    /* map the image, not the block cache, so pending writes have to reach it first; a compressed
+       image or one on a disk has nothing to map */
+    if ((get_fs_flags() & (FS_COMPRESSED | FS_DISK)) || sync_filesys() != 0) {
+        return -1;
+    }
+
+    /* assert every run of data blocks is page aligned and the file fits in the window */
+    for (offset = 0; (run = get_data_run(inode, offset, &run_ptr)) > 0; offset += run) {
+        if (((uint32_t) run_ptr & ~TWENTY_MSB) != 0) {
+            return -1;
+        }
+    }
+    length = offset;
+    if (run == -1 || base + (length + FOUR_KB - 1) / FOUR_KB > MMAP_PAGES) {
+        return -1;
+    }
+
+    page.present = 1;
+    page.rw_enable = 0;
+    page.user_super = 1;
+    page.write_through = 0;
+    page.cache_disabled = 0;
+    page.accessed = 0;
+    page.dirty = 0;
+    page.pat_idx = 0;
+    page.global_page = 0;
+    page.available = PTE_COW;
+
+    /* one page table entry per data block, in file order */
+    for (offset = 0; (run = get_data_run(inode, offset, &run_ptr)) > 0; offset += run) {
+        for (it = 0; it < run; it += FOUR_KB) {
+            page.page_base_addr = ((uint32_t) run_ptr + it) >> 12;
+            table[base + (offset + it) / FOUR_KB] = page;
+        }
+    }
+
+    cur_pcb->mmap_used = base + (length + FOUR_KB - 1) / FOUR_KB;
+    if (slot == cur_pcb->mmap_files) {
+        cur_pcb->mmap_inodes[cur_pcb->mmap_files++] = inode;
+    }
+    lpdt(ret_dir_ptr());
+
+    *start = (uint8_t*) ((MMAP_IDX << 22) | (base << 12));
+    return length;
+}
+
+/*
+ * file_mmap
+ *   DESCRIPTION: maps an open regular file of the image, see mmap_file
+ *   INPUTS: fd: descriptor of the file; start: set to the user address of the mapping
+ *   OUTPUTS: none
+ *   RETURN VALUE: length of the file on success, -1 on failure
+ *   SIDE EFFECTS: flushes the TLB
+ */
+int32_t file_mmap(int32_t fd, uint8_t** start) {
+    if (fd < 2 || fd >= MAX_FDS || (((cur_pcb->file_array)[fd].flags & TYPE_MASK) >> TYPE_SHIFT) != REG_FILE) {
+        return -1;
+    }
+    return mmap_file((cur_pcb->file_array)[fd].inode, start);
+}
+
+/*
+ * mmap_page_fault
+ *   DESCRIPTION: handles a write to a read-only page of the mmap window by copying the page
+ *                into a private frame and mapping that writable in its place. The kernel's
+ *                writes count too, as when a user buffer for read is in the window: with
+ *                CR0.WP set they fault instead of going straight into the image
+ *   INPUTS: addr: faulting linear address (cr2); err: page fault error code
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the fault was resolved, -1 if it's a real fault
+ *   SIDE EFFECTS: flushes the TLB
+ */
+int32_t mmap_page_fault(uint32_t addr, uint32_t err) {
+    pt_entry_t* page;
+    uint8_t* frame;
+
+    if (cur_pcb == NULL || (addr >> 22) != MMAP_IDX) {
+        return -1;
+    }
+    if ((err & (PF_PRESENT | PF_WRITE)) != (PF_PRESENT | PF_WRITE)) {
+        return -1;
+    }
+
+    page = &cur_pcb->mmap_table[(addr >> 12) & (MMAP_PAGES - 1)];
+    if (page->present == 0 || (page->available & PTE_COW) == 0) {
+        return -1;
+    }
+    if ((frame = cow_alloc()) == NULL) {
+        return -1;
+    }
+
+    memcpy(frame, (void*) (page->page_base_addr << 12), FOUR_KB);
+    page->page_base_addr = (uint32_t) frame >> 12;
+    page->rw_enable = 1;
+    page->available = PTE_PRIVATE;
+    lpdt(ret_dir_ptr());
+
+    return 0;
+}
+
+/*
+ * mmap_load
+ *   DESCRIPTION: makes a process's mmap window the one visible at MMAP_IDX
+ *   INPUTS: pcb: process to load, or NULL to leave the window unmapped
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: flushes the TLB
+ */
+void mmap_load(pcb_t* pcb) {
+    set_page_table(MMAP_IDX, (pcb == NULL) ? NULL : pcb->mmap_table);
+}
+
+/*
+ * mmap_release
+ *   DESCRIPTION: unmaps every page in a process's mmap window, returns its private copies to
+ *                the copy-on-write pool and unpins its mapped inodes
+ *   INPUTS: pcb: process whose window is released
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void mmap_release(pcb_t* pcb) {
+    pt_entry_t* table;
+    uint32_t it;
+
+    if (pcb == NULL) {
+        return;
+    }
+
+    table = pcb->mmap_table;
+    for (it = 0; it < pcb->mmap_used; it++) {
+        if (table[it].present && (table[it].available & PTE_PRIVATE)) {
+            cow_free((uint8_t*) (table[it].page_base_addr << 12));
+        }
+        table[it].present = 0;
+    }
+    pcb->mmap_used = 0;
+    pcb->mmap_files = 0;
+}
+
+/*
+ * mmap_usage
+ *   DESCRIPTION: counts the pages a process has mapped and the copy-on-write frames in use
+ *   INPUTS: pcb: process, or NULL; cow_used: set to the frames taken from the pool by any process
+ *   OUTPUTS: none
+ *   RETURN VALUE: pages handed out in the process's window
+ *   SIDE EFFECTS: none
+ */
+uint32_t mmap_usage(pcb_t* pcb, uint32_t* cow_used) {
+    if (cow_used != NULL) {
+        *cow_used = cow_in_use;
+    }
+    return (pcb != NULL) ? pcb->mmap_used : 0;
+}
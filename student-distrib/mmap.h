@@ -0,0 +1,39 @@
+#ifndef _MMAP_H
+#define _MMAP_H
+
+#include "types.h"
+#include "pcb.h"
+#include "paging_c.h"
+
+#define MMAP_IDX        34          /* page directory entry holding each process's mmap window  */
+#define MMAP_PAGES      1024        /* 4kB pages in the window (one page table)                 */
+#define MMAP_COW_FRAMES 64          /* most frames private copies of mapped pages take at once  */
+
+/* bits kept in the "available" field of mmap page table entries */
+#define PTE_COW         0x1         /* read-only view of filesystem data, copied on write       */
+#define PTE_PRIVATE     0x2         /* frame from the copy-on-write pool, owned by the process  */
+
+/* page fault error code bits */
+#define PF_PRESENT      0x1
+#define PF_WRITE        0x2
+#define PF_USER         0x4
+
+/* maps a regular file's data blocks into the current process's mmap window */
+int32_t mmap_file(uint32_t inode, uint8_t** start);
+
+/* mmap operation for open regular files of the image */
+int32_t file_mmap(int32_t fd, uint8_t** start);
+
+/* gives a process its own copy of a mapped page it wrote to */
+int32_t mmap_page_fault(uint32_t addr, uint32_t err);
+
+/* loads a process's mmap window into the page directory (NULL unloads it) */
+void mmap_load(pcb_t* pcb);
+
+/* unmaps a process's window and frees its private pages */
+void mmap_release(pcb_t* pcb);
+
+/* pages mapped by a process, and copy-on-write frames in use */
+uint32_t mmap_usage(pcb_t* pcb, uint32_t* cow_used);
+
+#endif /* _MMAP_H */
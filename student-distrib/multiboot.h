@@ -9,6 +9,7 @@
 #define MULTIBOOT_HEADER_FLAGS          0x00000003
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
+#define MULTIBOOT_MEMORY_AVAILABLE      1       /* memory_map_t type of usable RAM */
 
 #ifndef ASM
 
@@ -244,3 +244,44 @@ pd_entry_bigPage_t* get_bigPage(uint32_t dir_idx) {
 
     return &page_dir[dir_idx].bigPage;
 }
+
+
+/*
+ * set_page_table
+ *   DESCRIPTION: points an entry in the page directory at a page table of user 4kB pages,
+ *                or marks the entry not present if table is NULL; the individual page
+ *                table entries decide whether each page is writable
+ *   INPUTS: dir_idx: index in page directory; table: 4kB-aligned page table, or NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: flushes the TLB
+ */
+void set_page_table(uint32_t dir_idx, pt_entry_t* table) {
+    pd_entry_smallPage_t pt_entry;
+
+    /* assert that index is within bounds of directory */
+    if (dir_idx >= 1024) {
+        return;
+    }
+
+    if (table == NULL) {
+        page_directory[dir_idx] = pd_clear_entry;
+    }
+    else {
+        pt_entry.present = 1;
+        pt_entry.rw_enable = 1;
+        pt_entry.user_super = 1;
+        pt_entry.write_through = 0;
+        pt_entry.cache_disabled = 0;
+        pt_entry.accessed = 0;
+        pt_entry.reserved = 0;
+        pt_entry.page_size = 0;
+        pt_entry.global_page = 0;
+        pt_entry.available = 0;
+        pt_entry.page_table_base_addr = (uint32_t) ((TWENTY_MSB & ((uint32_t) table)) >> 12);
+        page_directory[dir_idx].smallPage = pt_entry;
+    }
+
+    /* flush TLB */
+    lpdt(ret_dir_ptr());
+}
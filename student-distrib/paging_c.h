@@ -81,4 +81,7 @@ pt_entry_t* get_pageTable_entry(uint32_t dir_idx, uint32_t table_idx);
 /* returns pointer to a page directory entry (4MB page) */
 pd_entry_bigPage_t* get_bigPage(uint32_t dir_idx);
 
+/* points a page directory entry at a user page table, or clears it for NULL */
+void set_page_table(uint32_t dir_idx, pt_entry_t* table);
+
 #endif
@@ -0,0 +1,359 @@
+#include "palloc.h"
+#include "lib.h"
+
+#if PALLOC_FRAMES > 65536
+#error "free list links are 16 bits, so PALLOC_MAX_MEM can be 256MB at most"
+#endif
+
+#define FRAME_FREE      0x80    /* frame_state of the first frame of a free block; the order is in the low bits */
+#define FRAME_NONE      0       /* end of a free list; frame 0 is never given to the allocator */
+
+/* per frame: whether it heads a free block and of what order, and its free list links */
+static uint8_t frame_state[PALLOC_FRAMES];
+static uint16_t frame_next[PALLOC_FRAMES];
+static uint16_t frame_prev[PALLOC_FRAMES];
+/* one bit per frame, set once it has been given to the allocator */
+static uint8_t frame_ram[PALLOC_FRAMES / 8];
+
+static uint16_t free_head[PALLOC_ZONES][PALLOC_ORDERS];
+static palloc_zone_t zones[PALLOC_ZONES];
+
+static uint32_t reserved_start[PALLOC_MAX_RESERVED];
+static uint32_t reserved_end[PALLOC_MAX_RESERVED];
+static uint32_t n_reserved;
+
+/* end of the kernel image, bss included; defined by the linker */
+extern uint8_t _end[];
+
+/*
+ * zone_of
+ * DESCRIPTION: finds the zone a frame is in
+ * INPUTS: frame: frame number
+ * OUTPUTS: none
+ * RETURN VALUE: ZONE_KERNEL or ZONE_USER
+ */
+static uint32_t zone_of(uint32_t frame) {
+    return (frame < EIGHT_MB / FOUR_KB) ? ZONE_KERNEL : ZONE_USER;
+}
+
+/*
+ * list_push
+ * DESCRIPTION: puts a free block at the front of its zone's free list for its order
+ * INPUTS: frame: its first frame; order: its order
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void list_push(uint32_t frame, uint32_t order) {
+    uint32_t zone = zone_of(frame);
+    uint16_t head = free_head[zone][order];
+
+    frame_state[frame] = FRAME_FREE | order;
+    frame_prev[frame] = FRAME_NONE;
+    frame_next[frame] = head;
+    if (head != FRAME_NONE) {
+        frame_prev[head] = frame;
+    }
+    free_head[zone][order] = frame;
+    zones[zone].free_blocks[order]++;
+    zones[zone].free_pages += 1 << order;
+}
+
+/*
+ * list_remove
+ * DESCRIPTION: takes a free block off its free list, wherever it is in it
+ * INPUTS: frame: its first frame; order: its order
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void list_remove(uint32_t frame, uint32_t order) {
+    uint32_t zone = zone_of(frame);
+
+    if (frame_prev[frame] != FRAME_NONE) {
+        frame_next[frame_prev[frame]] = frame_next[frame];
+    }
+    else {
+        free_head[zone][order] = frame_next[frame];
+    }
+    if (frame_next[frame] != FRAME_NONE) {
+        frame_prev[frame_next[frame]] = frame_prev[frame];
+    }
+    frame_state[frame] = 0;
+    zones[zone].free_blocks[order]--;
+    zones[zone].free_pages -= 1 << order;
+}
+
+/*
+ * release_block
+ * DESCRIPTION: frees a block, joining it with its buddy for as long as the buddy is free too
+ * INPUTS: frame: its first frame; order: its order
+ * OUTPUTS: none
+ * RETURN VALUE: buddies joined
+ */
+static uint32_t release_block(uint32_t frame, uint32_t order) {
+    uint32_t buddy;
+    uint32_t merges = 0;
+
+    while (order < PALLOC_MAX_ORDER) {
+        buddy = frame ^ (1 << order);
+        if (buddy >= PALLOC_FRAMES || frame_state[buddy] != (FRAME_FREE | order)) {
+            break;
+        }
+        list_remove(buddy, order);
+        frame &= ~(1 << order);
+        order++;
+        merges++;
+    }
+    list_push(frame, order);
+    return merges;
+}
+
+/*
+ * is_reserved
+ * DESCRIPTION: checks a frame against the reserved ranges
+ * INPUTS: frame: frame number
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if any of it is reserved, else 0
+ */
+static uint32_t is_reserved(uint32_t frame) {
+    uint32_t addr = frame * FOUR_KB;
+    uint32_t it;
+
+    for (it = 0; it < n_reserved; it++) {
+        if (addr < reserved_end[it] && addr + FOUR_KB > reserved_start[it]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * palloc_init
+ * DESCRIPTION: empties every free list and forgets all RAM, then reserves the kernel image
+ *              and the boot stack at the top of the kernel's page
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void palloc_init(void) {
+    memset(frame_state, 0, sizeof(frame_state));
+    memset(frame_ram, 0, sizeof(frame_ram));
+    memset(free_head, 0, sizeof(free_head));
+    memset(zones, 0, sizeof(zones));
+    n_reserved = 0;
+
+    palloc_reserve(KER_ADDR, (uint32_t) _end);
+    palloc_reserve(KPAGE_TOP, EIGHT_MB);
+}
+
+/*
+ * palloc_reserve
+ * DESCRIPTION: keeps the frames a range of physical memory touches out of the allocator; only
+ *              RAM added after this is affected
+ * INPUTS: start, end: the range, end excluded
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void palloc_reserve(uint32_t start, uint32_t end) {
+    if (end <= start || n_reserved == PALLOC_MAX_RESERVED) {
+        return;
+    }
+    reserved_start[n_reserved] = start;
+    reserved_end[n_reserved] = end;
+    n_reserved++;
+}
+
+/*
+ * palloc_add
+ * DESCRIPTION: gives the whole frames of a range of RAM to the allocator, except reserved
+ *              ones, ones below the kernel's page, which the kernel can't reach, and ones
+ *              past PALLOC_MAX_MEM. A range may overlap one added before
+ * INPUTS: start, end: the range, end excluded
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void palloc_add(uint32_t start, uint32_t end) {
+    uint32_t first;
+    uint32_t last;
+    uint32_t frame;
+
+    if (start < KER_ADDR) {
+        start = KER_ADDR;
+    }
+    if (end > PALLOC_MAX_MEM) {
+        end = PALLOC_MAX_MEM;
+    }
+    if (end <= start) {
+        return;
+    }
+    first = (start + FOUR_KB - 1) / FOUR_KB;
+    last = end / FOUR_KB;
+
+    for (frame = first; frame < last; frame++) {
+        if ((frame_ram[frame >> 3] & (1 << (frame & 7))) || is_reserved(frame)) {
+            continue;
+        }
+        frame_ram[frame >> 3] |= 1 << (frame & 7);
+        zones[zone_of(frame)].pages++;
+        release_block(frame, 0);
+    }
+}
+
+/*
+ * frame_alloc
+ * DESCRIPTION: takes a block from the smallest free list of the zone that isn't empty, at or
+ *              above the order, and splits it down, freeing the halves it doesn't need
+ * INPUTS: order: 0 to PALLOC_MAX_ORDER; zone: ZONE_KERNEL or ZONE_USER
+ * OUTPUTS: none
+ * RETURN VALUE: the physical address of the block, aligned to its size, or 0 if none is free
+ */
+uint32_t frame_alloc(uint32_t order, uint32_t zone) {
+    uint32_t frame;
+    uint32_t it;
+
+    if (order > PALLOC_MAX_ORDER || zone >= PALLOC_ZONES) {
+        return 0;
+    }
+    for (it = order; it <= PALLOC_MAX_ORDER && free_head[zone][it] == FRAME_NONE; it++);
+    if (it > PALLOC_MAX_ORDER) {
+        zones[zone].failures++;
+        return 0;
+    }
+
+    frame = free_head[zone][it];
+    list_remove(frame, it);
+    while (it > order) {
+        it--;
+        list_push(frame + (1 << it), it);
+        zones[zone].splits++;
+    }
+    zones[zone].allocs++;
+    return frame * FOUR_KB;
+}
+
+/*
+ * frame_free
+ * DESCRIPTION: returns a block to its zone, joined with any free buddies
+ * INPUTS: addr: what frame_alloc returned; order: the order it was taken with
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void frame_free(uint32_t addr, uint32_t order) {
+    uint32_t frame = addr / FOUR_KB;
+
+    if (frame == FRAME_NONE || frame >= PALLOC_FRAMES || order > PALLOC_MAX_ORDER ||
+        (frame & ((1 << order) - 1)) != 0 || (frame_state[frame] & FRAME_FREE)) {
+        return;
+    }
+    zones[zone_of(frame)].merges += release_block(frame, order);
+}
+
+/*
+ * frame_order
+ * DESCRIPTION: rounds a number of frames up to a block order
+ * INPUTS: pages: frames wanted
+ * OUTPUTS: none
+ * RETURN VALUE: the smallest order whose blocks hold that many
+ */
+uint32_t frame_order(uint32_t pages) {
+    uint32_t order = 0;
+
+    while ((1U << order) < pages) {
+        order++;
+    }
+    return order;
+}
+
+/*
+ * kpage_alloc
+ * DESCRIPTION: takes a block of the kernel zone big enough for some pages
+ * INPUTS: pages: pages wanted, which the block is rounded up to a power of two for
+ * OUTPUTS: none
+ * RETURN VALUE: the address of the first page, or NULL if no block is free
+ */
+void* kpage_alloc(uint32_t pages) {
+    if (pages == 0) {
+        return NULL;
+    }
+    return (void*) frame_alloc(frame_order(pages), ZONE_KERNEL);
+}
+
+/*
+ * kpage_free
+ * DESCRIPTION: returns pages from kpage_alloc
+ * INPUTS: addr: the first page; pages: how many were asked for
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void kpage_free(void* addr, uint32_t pages) {
+    frame_free((uint32_t) addr, frame_order(pages));
+}
+
+/*
+ * user_frame_alloc
+ * DESCRIPTION: takes a 4MB block of the user zone for a user page
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: its physical address, or 0 if none is free
+ */
+uint32_t user_frame_alloc(void) {
+    return frame_alloc(PALLOC_MAX_ORDER, ZONE_USER);
+}
+
+/*
+ * user_frame_free
+ * DESCRIPTION: returns a frame from user_frame_alloc
+ * INPUTS: addr: its physical address
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void user_frame_free(uint32_t addr) {
+    frame_free(addr, PALLOC_MAX_ORDER);
+}
+
+/*
+ * palloc_get_stats
+ * DESCRIPTION: copies out the sizes of the zones as processes use them
+ * INPUTS: out: where to put them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void palloc_get_stats(palloc_stats_t* out) {
+    out->kpages = zones[ZONE_KERNEL].pages;
+    out->kpages_free = zones[ZONE_KERNEL].free_pages;
+    out->user_frames = zones[ZONE_USER].pages >> PALLOC_MAX_ORDER;
+    out->user_frames_free = zones[ZONE_USER].free_blocks[PALLOC_MAX_ORDER];
+}
+
+/*
+ * palloc_get_zone
+ * DESCRIPTION: copies out the counters of a zone
+ * INPUTS: zone: ZONE_KERNEL or ZONE_USER; out: where to put them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void palloc_get_zone(uint32_t zone, palloc_zone_t* out) {
+    if (zone < PALLOC_ZONES) {
+        *out = zones[zone];
+    }
+}
+
+/*
+ * palloc_fragmentation
+ * DESCRIPTION: works out how much of a zone's free memory is in blocks smaller than an order,
+ *              so no request of that order can use it
+ * INPUTS: zone: ZONE_KERNEL or ZONE_USER; order: the request's order
+ * OUTPUTS: none
+ * RETURN VALUE: that share of the free frames in percent, 0 if nothing is free
+ */
+uint32_t palloc_fragmentation(uint32_t zone, uint32_t order) {
+    uint32_t usable = 0;
+    uint32_t it;
+
+    if (zone >= PALLOC_ZONES || zones[zone].free_pages == 0) {
+        return 0;
+    }
+    for (it = order; it <= PALLOC_MAX_ORDER; it++) {
+        usable += zones[zone].free_blocks[it] << it;
+    }
+    return (zones[zone].free_pages - usable) * 100 / zones[zone].free_pages;
+}
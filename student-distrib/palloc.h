@@ -0,0 +1,83 @@
+#ifndef _PALLOC_H
+#define _PALLOC_H
+
+#include "types.h"
+#include "paging_c.h"
+
+/*
+ * Physical page frames. A buddy allocator hands out blocks of 2^order 4kB frames, from one
+ * frame up to a 4MB user page, out of the RAM the boot loader's memory map lists, less the
+ * kernel image, the boot stack and the boot modules. RAM is split in two zones at 8MB: the
+ * kernel zone is inside the kernel's own 4MB page, so the kernel can use its frames directly;
+ * the user zone is only reached through user pages. A block is aligned to its size, so none
+ * crosses a 4MB boundary, 8MB included, and each zone keeps its own free lists. A free list
+ * per order makes taking and returning a block constant time, splitting or merging at most
+ * PALLOC_MAX_ORDER times.
+ */
+
+#define PALLOC_MAX_ORDER    10                  /* 4kB << 10 is 4MB                             */
+#define PALLOC_ORDERS       (PALLOC_MAX_ORDER + 1)
+#ifndef PALLOC_MAX_MEM
+#define PALLOC_MAX_MEM      0x10000000          /* RAM past 256MB is left unused                */
+#endif
+#define PALLOC_FRAMES       (PALLOC_MAX_MEM / FOUR_KB)
+#define PALLOC_MAX_RESERVED 8                   /* ranges palloc_reserve can keep out           */
+
+#define ZONE_KERNEL         0                   /* 4MB to 8MB, in the kernel's page             */
+#define ZONE_USER           1                   /* above 8MB, for user pages                    */
+#define PALLOC_ZONES        2
+
+#define KPAGE_TOP           (EIGHT_MB - EIGHT_KB)   /* the boot stack sits above the kernel zone */
+#define LOW_MEM_TOP         0x00100000          /* the boot loader's mem_upper counts from here */
+#ifndef PALLOC_DEFAULT_TOP
+#define PALLOC_DEFAULT_TOP  (16 * 1024 * 1024)  /* RAM assumed when the boot loader won't say   */
+#endif
+
+/* frames of the two zones as processes use them, in total and free */
+typedef struct palloc_stats {
+    uint32_t kpages;                /* 4kB frames in the kernel zone                            */
+    uint32_t kpages_free;
+    uint32_t user_frames;           /* 4MB blocks in the user zone                              */
+    uint32_t user_frames_free;
+} palloc_stats_t;
+
+/* free blocks of one zone by order, for seeing how fragmented it is */
+typedef struct palloc_zone {
+    uint32_t pages;                 /* 4kB frames given to the zone                             */
+    uint32_t free_pages;
+    uint32_t free_blocks[PALLOC_ORDERS];
+    uint32_t allocs;                /* blocks handed out since boot                             */
+    uint32_t splits;                /* blocks split to serve a smaller order                    */
+    uint32_t merges;                /* buddies joined on the way back                           */
+    uint32_t failures;              /* requests no free block was big enough for                */
+} palloc_zone_t;
+
+/* empties the allocator, keeping the kernel image and the boot stack reserved */
+void palloc_init(void);
+/* keeps a range the kernel uses, like a boot module, out of the allocator; before palloc_add */
+void palloc_reserve(uint32_t start, uint32_t end);
+/* gives a range of RAM from the memory map to the allocator, less what is reserved */
+void palloc_add(uint32_t start, uint32_t end);
+
+/* physical address of a free block of 2^order frames in a zone, or 0 */
+uint32_t frame_alloc(uint32_t order, uint32_t zone);
+/* returns a block from frame_alloc, of the order it was taken with */
+void frame_free(uint32_t addr, uint32_t order);
+/* smallest order of a block holding pages frames */
+uint32_t frame_order(uint32_t pages);
+
+/* contiguous 4kB pages in the kernel zone, or NULL */
+void* kpage_alloc(uint32_t pages);
+void kpage_free(void* addr, uint32_t pages);
+
+/* physical address of a free 4MB user frame, or 0 */
+uint32_t user_frame_alloc(void);
+void user_frame_free(uint32_t addr);
+
+void palloc_get_stats(palloc_stats_t* out);
+void palloc_get_zone(uint32_t zone, palloc_zone_t* out);
+/* free frames of a zone in blocks too small for a request of an order, in percent: 0 when */
+/* all free memory could serve it, 100 when none can                                       */
+uint32_t palloc_fragmentation(uint32_t zone, uint32_t order);
+
+#endif /* _PALLOC_H */
@@ -3,30 +3,55 @@
 
 #include "types.h"
 
+#define PID_MAX         1024    /* process ids; how many processes fit is up to free memory */
+#define MAX_FDS         8       /* file descriptors per process; 0 and 1 are the terminal */
+#define MMAP_MAX_FILES  8       /* files a process can have mapped at once */
+
+struct stat;
+struct pt_entry;
+
+/* operations of one kind of open file; entries after write_ptr are NULL when unsupported */
 typedef struct fd_ops {
-    int32_t (*open_ptr)(const uint8_t*);
+    int32_t (*open_ptr)(int32_t, const uint8_t*);
     int32_t (*close_ptr)(int32_t);
     int32_t (*read_ptr)(int32_t, void*, int32_t);
     int32_t (*write_ptr)(int32_t, const void*, int32_t);
+    int32_t (*lseek_ptr)(int32_t, int32_t, int32_t);
+    int32_t (*pread_ptr)(int32_t, void*, int32_t, uint32_t);
+    int32_t (*getdents_ptr)(int32_t, void*, int32_t);
+    int32_t (*truncate_ptr)(int32_t, uint32_t);
+    int32_t (*fstat_ptr)(int32_t, struct stat*);
+    int32_t (*mmap_ptr)(int32_t, uint8_t**);
+    int32_t (*sendfile_ptr)(int32_t, int32_t, uint32_t);
 } fd_ops_t;
 
 typedef struct file_desc {
     fd_ops_t* file_op_ptr;      /* file operations jmp table associated with file type  */
     uint32_t inode;             /* inode number for this file                           */
-    uint32_t file_pos;          /* file position                                        */
+    uint32_t file_pos;          /* file position; byte offset, or entry for directories */
     uint32_t flags;             /* Flags:   [0]:    in use (1), not in use (0)          */
                                 /*          [2:1]:  filetype (0, 1, 2)                  */
-                                /*          [19:8]: index in inode (data block number)  */
-                                /*          [31:20] offset                              */
 } file_desc_t;
 
 typedef struct pcb {
-    file_desc_t file_array[8];
+    file_desc_t file_array[MAX_FDS];
     struct pcb_t* old_pcb_ptr;
     uint8_t input[1024];
     uint32_t old_phys_addr;
     uint32_t old_esp0;
     uint32_t old_ebp;
+    uint32_t pid;               /* process id, from the bitmap in sched.c                           */
+    uint32_t kernel_esp0;       /* top of its kernel stack                                          */
+    uint32_t user_page;         /* page_base_addr of its 4MB user page                              */
+    struct pt_entry* mmap_table;/* page table of its mmap window                                    */
+    uint32_t mmap_used;         /* pages of the window handed out so far                            */
+    uint32_t mmap_inodes[MMAP_MAX_FILES]; /* inodes mapped in the window, kept from being freed     */
+    uint32_t mmap_files;        /* entries in mmap_inodes                                           */
+    uint32_t sched_esp;         /* kernel stack pointer saved while it waits in the run queue       */
+    struct pcb* sched_next;     /* next process in the run queue                                    */
+    uint32_t sched_flags;       /* SCHED_DETACHED, SCHED_RESPAWN                                    */
+    uint32_t run_ticks;         /* timer ticks it was running for                                   */
+    uint32_t terminal;          /* virtual terminal of its stdin and stdout                         */
 } pcb_t;
 
 pcb_t* cur_pcb;
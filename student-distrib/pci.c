@@ -0,0 +1,244 @@
+#include "pci.h"
+#include "i8259.h"
+#include "lib.h"
+
+static pci_dev_t devices[PCI_MAX_FUNCTIONS];
+static uint32_t n_devices;
+
+/* handlers registered on each line PCI interrupts can come in on */
+static void (*irq_handlers[PCI_IRQ_LAST - PCI_IRQ_FIRST + 1][PCI_IRQ_SHARED])(void);
+
+/*
+ * config_read
+ * DESCRIPTION: reads a word of configuration space by address
+ * INPUTS: bus, dev, func: the function
+ *         reg: byte offset of the word
+ * OUTPUTS: none
+ * RETURN VALUE: the word, all ones if there is no such function
+ */
+static uint32_t config_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg) {
+    outl(PCI_ENABLE | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDR);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/*
+ * record
+ * DESCRIPTION: adds a function to the table with its IDs, class, BARs and interrupt line
+ * INPUTS: bus, dev, func: the function, known to be there
+ * OUTPUTS: none
+ * RETURN VALUE: the entry, or NULL if the table is full
+ */
+static pci_dev_t* record(uint32_t bus, uint32_t dev, uint32_t func) {
+    pci_dev_t* pdev;
+    uint32_t id;
+    uint32_t it;
+
+    if (n_devices == PCI_MAX_FUNCTIONS) {
+        return NULL;
+    }
+    pdev = &devices[n_devices++];
+    id = config_read(bus, dev, func, PCI_REG_ID);
+    pdev->bus = bus;
+    pdev->dev = dev;
+    pdev->func = func;
+    pdev->vendor = id & 0xFFFF;
+    pdev->device = id >> 16;
+    pdev->class_code = config_read(bus, dev, func, PCI_REG_CLASS) >> 16;
+    pdev->irq = config_read(bus, dev, func, PCI_REG_IRQ) & 0xFF;
+    pdev->reserved = 0;
+    for (it = 0; it < PCI_NUM_BARS; it++) {
+        pdev->bar[it] = config_read(bus, dev, func, PCI_REG_BAR0 + 4 * it);
+    }
+    return pdev;
+}
+
+/*
+ * pci_init
+ * DESCRIPTION: enumerates configuration space from bus 0, following bridges to the buses
+ *              behind them, and records every function found
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pci_init(void) {
+    uint8_t queued[PCI_NUM_BUSES];
+    uint8_t buses[PCI_NUM_BUSES];
+    uint32_t n_buses;
+    uint32_t next;
+    uint32_t bus, dev, func, n_funcs;
+    uint32_t secondary;
+    pci_dev_t* pdev;
+
+    n_devices = 0;
+    memset(queued, 0, sizeof(queued));
+    buses[0] = 0;
+    queued[0] = 1;
+    n_buses = 1;
+
+    for (next = 0; next < n_buses; next++) {
+        bus = buses[next];
+        for (dev = 0; dev < PCI_NUM_DEVS; dev++) {
+            if ((config_read(bus, dev, 0, PCI_REG_ID) & 0xFFFF) == PCI_NO_VENDOR) {
+                continue;
+            }
+            n_funcs = (config_read(bus, dev, 0, PCI_REG_HEADER) >> 16) & PCI_HEADER_MULTI ? PCI_NUM_FUNCS : 1;
+            for (func = 0; func < n_funcs; func++) {
+                if ((config_read(bus, dev, func, PCI_REG_ID) & 0xFFFF) == PCI_NO_VENDOR ||
+                    (pdev = record(bus, dev, func)) == NULL) {
+                    continue;
+                }
+                if (pdev->class_code != PCI_CLASS_BRIDGE) {
+                    continue;
+                }
+                secondary = (config_read(bus, dev, func, PCI_REG_BUSES) >> 8) & 0xFF;
+                if (!queued[secondary]) {
+                    queued[secondary] = 1;
+                    buses[n_buses++] = secondary;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * pci_device
+ * DESCRIPTION: returns a recorded function by position, for listing them
+ * INPUTS: idx: position in the order pci_init found them
+ * OUTPUTS: none
+ * RETURN VALUE: the function, or NULL if idx is past the last
+ */
+pci_dev_t* pci_device(uint32_t idx) {
+    return (idx < n_devices) ? &devices[idx] : NULL;
+}
+
+/*
+ * pci_find
+ * DESCRIPTION: finds the first recorded function with a vendor and device ID
+ * INPUTS: vendor, device: the IDs
+ * OUTPUTS: none
+ * RETURN VALUE: the function, or NULL if there is none
+ */
+pci_dev_t* pci_find(uint16_t vendor, uint16_t device) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n_devices; idx++) {
+        if (devices[idx].vendor == vendor && devices[idx].device == device) {
+            return &devices[idx];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * pci_find_class
+ * DESCRIPTION: finds the first recorded function of a class
+ * INPUTS: class_code: class in the high byte, subclass in the low byte
+ * OUTPUTS: none
+ * RETURN VALUE: the function, or NULL if there is none
+ */
+pci_dev_t* pci_find_class(uint16_t class_code) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n_devices; idx++) {
+        if (devices[idx].class_code == class_code) {
+            return &devices[idx];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * pci_read
+ * DESCRIPTION: reads a word of a function's configuration space
+ * INPUTS: pdev: the function
+ *         reg: byte offset of the word
+ * OUTPUTS: none
+ * RETURN VALUE: the word
+ */
+uint32_t pci_read(pci_dev_t* pdev, uint32_t reg) {
+    return config_read(pdev->bus, pdev->dev, pdev->func, reg);
+}
+
+/*
+ * pci_write
+ * DESCRIPTION: writes a word of a function's configuration space
+ * INPUTS: pdev: the function
+ *         reg: byte offset of the word
+ *         value: the word
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pci_write(pci_dev_t* pdev, uint32_t reg, uint32_t value) {
+    outl(PCI_ENABLE | (pdev->bus << 16) | (pdev->dev << 11) | (pdev->func << 8) | (reg & 0xFC), PCI_CONFIG_ADDR);
+    outl(value, PCI_CONFIG_DATA);
+}
+
+/*
+ * pci_io_base
+ * DESCRIPTION: returns where an I/O BAR puts the function's registers
+ * INPUTS: pdev: the function
+ *         bar: 0 to PCI_NUM_BARS - 1
+ * OUTPUTS: none
+ * RETURN VALUE: the first port, or 0 if the BAR maps memory or nothing
+ */
+uint32_t pci_io_base(pci_dev_t* pdev, uint32_t bar) {
+    if (bar >= PCI_NUM_BARS || (pdev->bar[bar] & PCI_BAR_IO) == 0) {
+        return 0;
+    }
+    return pdev->bar[bar] & PCI_BAR_IO_MASK;
+}
+
+/*
+ * pci_enable
+ * DESCRIPTION: sets the I/O space and bus master bits of the command register
+ * INPUTS: pdev: the function
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pci_enable(pci_dev_t* pdev) {
+    /* the status half is write-one-to-clear, so write it back as 0 */
+    pci_write(pdev, PCI_REG_COMMAND, (pci_read(pdev, PCI_REG_COMMAND) & 0xFFFF) | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+}
+
+/*
+ * pci_set_irq_handler
+ * DESCRIPTION: adds a handler to the function's interrupt line and unmasks the line. PCI lines
+ *              are shared and level triggered, so every handler on a line is called on each
+ *              interrupt and must quiet its own device if it was the one asking
+ * INPUTS: pdev: the function
+ *         handler: called with interrupts off; pci_irq_handler sends the EOI after it
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the line has no stub or no room for another handler
+ */
+int32_t pci_set_irq_handler(pci_dev_t* pdev, void (*handler)(void)) {
+    uint32_t it;
+
+    if (pdev->irq < PCI_IRQ_FIRST || pdev->irq > PCI_IRQ_LAST) {
+        return -1;
+    }
+    for (it = 0; it < PCI_IRQ_SHARED; it++) {
+        if (irq_handlers[pdev->irq - PCI_IRQ_FIRST][it] == NULL) {
+            irq_handlers[pdev->irq - PCI_IRQ_FIRST][it] = handler;
+            enable_irq(2);
+            enable_irq(pdev->irq);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * pci_irq_handler
+ * DESCRIPTION: interrupt handler for the PCI lines; runs every handler on the line
+ * INPUTS: irq: the line, PCI_IRQ_FIRST to PCI_IRQ_LAST
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pci_irq_handler(uint32_t irq) {
+    uint32_t it;
+
+    for (it = 0; it < PCI_IRQ_SHARED && irq_handlers[irq - PCI_IRQ_FIRST][it] != NULL; it++) {
+        irq_handlers[irq - PCI_IRQ_FIRST][it]();
+    }
+    send_eoi(irq);
+}
@@ -0,0 +1,75 @@
+#ifndef _PCI_H
+#define _PCI_H
+
+#include "types.h"
+
+/* configuration mechanism #1 */
+#define PCI_CONFIG_ADDR     0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_ENABLE          0x80000000
+
+/* configuration space registers */
+#define PCI_REG_ID          0x00        /* vendor in the low half, device in the high half      */
+#define PCI_REG_COMMAND     0x04        /* command in the low half, status in the high half     */
+#define PCI_REG_CLASS       0x08        /* class, subclass, prog if, revision from the top      */
+#define PCI_REG_HEADER      0x0C        /* header type in bits 16-23                            */
+#define PCI_REG_BAR0        0x10
+#define PCI_REG_BUSES       0x18        /* bridges: secondary bus number in bits 8-15           */
+#define PCI_REG_IRQ         0x3C        /* interrupt line the firmware routed the device to     */
+
+#define PCI_CMD_IO          0x0001
+#define PCI_CMD_BUS_MASTER  0x0004
+#define PCI_HEADER_MULTI    0x80        /* function 0 of a device with more than one function   */
+#define PCI_BAR_IO          0x00000001
+#define PCI_BAR_IO_MASK     0xFFFFFFFC
+#define PCI_NO_VENDOR       0xFFFF      /* reads of a function that isn't there                 */
+
+#define PCI_CLASS_IDE       0x0101      /* mass storage, IDE                                    */
+#define PCI_CLASS_BRIDGE    0x0604      /* PCI to PCI bridge                                    */
+
+#define PCI_NUM_BUSES       256
+#define PCI_NUM_DEVS        32
+#define PCI_NUM_FUNCS       8
+#define PCI_NUM_BARS        6
+#define PCI_MAX_FUNCTIONS   32          /* functions pci_init records                           */
+
+/* interrupt lines the firmware routes PCI interrupts to, each with a stub in exceptions.S */
+#define PCI_IRQ_FIRST       9
+#define PCI_IRQ_LAST        11
+#define PCI_IRQ_SHARED      4           /* handlers that can share one line                     */
+
+/* one function found by pci_init */
+typedef struct pci_dev {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t func;
+    uint8_t irq;                        /* interrupt line, 0xFF if it has none                  */
+    uint16_t vendor;
+    uint16_t device;
+    uint16_t class_code;                /* class in the high byte, subclass in the low byte     */
+    uint16_t reserved;
+    uint32_t bar[PCI_NUM_BARS];
+} pci_dev_t;
+
+/* walks every bus reachable from bus 0 and records the functions on them */
+void pci_init(void);
+/* the idx-th function pci_init found, or NULL past the last */
+pci_dev_t* pci_device(uint32_t idx);
+/* first function with the given IDs or class, or NULL */
+pci_dev_t* pci_find(uint16_t vendor, uint16_t device);
+pci_dev_t* pci_find_class(uint16_t class_code);
+
+/* configuration space words of a recorded function */
+uint32_t pci_read(pci_dev_t* pdev, uint32_t reg);
+void pci_write(pci_dev_t* pdev, uint32_t reg, uint32_t value);
+/* I/O port base of an I/O BAR, or 0 if the BAR is memory or unused */
+uint32_t pci_io_base(pci_dev_t* pdev, uint32_t bar);
+/* turns on I/O decoding and bus mastering so the function can be driven and do DMA */
+void pci_enable(pci_dev_t* pdev);
+/* calls handler on every interrupt on the function's line and unmasks it */
+int32_t pci_set_irq_handler(pci_dev_t* pdev, void (*handler)(void));
+
+/* called by the interrupt stubs with their line */
+void pci_irq_handler(uint32_t irq);
+
+#endif /* _PCI_H */
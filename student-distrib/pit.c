@@ -0,0 +1,64 @@
+#include "pit.h"
+#include "i8259.h"
+#include "lib.h"
+#include "sched.h"
+
+static volatile uint32_t ticks;
+static uint32_t divisor;
+
+/*
+ * pit_init
+ * DESCRIPTION: programs channel 0 as a square wave of the given rate and unmasks its
+ *              interrupt
+ * INPUTS: hz: interrupts per second, PIT_MIN_HZ or more
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pit_init(uint32_t hz) {
+    if (hz < PIT_MIN_HZ) {
+        hz = PIT_MIN_HZ;
+    }
+    divisor = PIT_BASE_HZ / hz;
+    ticks = 0;
+    outb(PIT_CMD_CH0_SQUARE, PIT_CMD_PORT);
+    outb(divisor & 0xFF, PIT_CH0_PORT);
+    outb((divisor >> 8) & 0xFF, PIT_CH0_PORT);
+    enable_irq(PIT_IRQ);
+}
+
+/*
+ * pit_hz
+ * DESCRIPTION: returns the interrupt rate channel 0 was set to
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: interrupts per second, 0 before pit_init
+ */
+uint32_t pit_hz(void) {
+    return (divisor == 0) ? 0 : PIT_BASE_HZ / divisor;
+}
+
+/*
+ * pit_ticks
+ * DESCRIPTION: returns the number of timer interrupts so far
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the count, which wraps after 2^32
+ */
+uint32_t pit_ticks(void) {
+    return ticks;
+}
+
+/*
+ * pit_handler
+ * DESCRIPTION: counts the tick and lets the scheduler charge it to the running task, which
+ *              may switch to another one. The EOI goes out first, because a switch does not
+ *              come back here until this task runs again
+ * INPUTS: cs: code segment of the interrupted code; the low bits are its privilege level
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void pit_handler(uint32_t cs) {
+    ticks++;
+    send_eoi(PIT_IRQ);
+    sched_tick((cs & 0x3) == 0x3);
+}
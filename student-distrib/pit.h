@@ -0,0 +1,30 @@
+#ifndef _PIT_H
+#define _PIT_H
+
+#include "types.h"
+
+/* 8253/8254 programmable interval timer, channel 0 on IRQ 0 */
+#define PIT_BASE_HZ         1193182     /* input clock of every channel                         */
+#define PIT_CH0_PORT        0x40
+#define PIT_CMD_PORT        0x43
+#define PIT_CMD_CH0_SQUARE  0x36        /* channel 0, low then high byte of the divisor, mode 3 */
+#define PIT_IRQ             0
+#define PIT_IDT             0x20        /* PIC_MASTER_IDT + 0                                   */
+#define PIT_MIN_HZ          19          /* the divisor has to fit in 16 bits                    */
+
+/* timer interrupts per second; the scheduler's time slices are counted in these */
+#ifndef PIT_HZ
+#define PIT_HZ              100
+#endif
+
+/* sets channel 0 to interrupt hz times a second and unmasks IRQ 0 */
+void pit_init(uint32_t hz);
+/* the rate pit_init actually set, after rounding the divisor */
+uint32_t pit_hz(void);
+/* timer interrupts since pit_init */
+uint32_t pit_ticks(void);
+
+/* interrupt handler; cs is the code segment that was interrupted */
+void pit_handler(uint32_t cs);
+
+#endif /* _PIT_H */
@@ -0,0 +1,727 @@
+#include "procfs.h"
+#include "vfs.h"
+#include "i8259.h"
+#include "block_cache.h"
+#include "mmap.h"
+#include "tmpfs.h"
+#include "pci.h"
+#include "ata.h"
+#include "virtio_blk.h"
+#include "sched.h"
+#include "pit.h"
+#include "palloc.h"
+#include "slab.h"
+
+uint32_t syscall_counts[NUM_SYSCALLS];
+
+/* text of the file being read, rebuilt by each read */
+static uint8_t text[PROCFS_BUF_SIZE];
+static uint32_t text_len;
+
+/* one file: its name and the function that writes its text */
+typedef struct procfs_file {
+    const int8_t* name;
+    void (*generate)(void);
+} procfs_file_t;
+
+static void gen_syscalls(void);
+static void gen_irqs(void);
+static void gen_fds(void);
+static void gen_procs(void);
+static void gen_cache(void);
+static void gen_mem(void);
+static void gen_frames(void);
+static void gen_slabs(void);
+static void gen_pci(void);
+static void gen_disks(void);
+static void gen_sched(void);
+
+static procfs_file_t files[] = {
+    {"syscalls", &gen_syscalls},
+    {"irqs", &gen_irqs},
+    {"fds", &gen_fds},
+    {"procs", &gen_procs},
+    {"cache", &gen_cache},
+    {"mem", &gen_mem},
+    {"frames", &gen_frames},
+    {"slabs", &gen_slabs},
+    {"pci", &gen_pci},
+    {"disks", &gen_disks},
+    {"sched", &gen_sched},
+};
+#define NUM_FILES   (sizeof(files) / sizeof(files[0]))
+
+/* in jump table order */
+static const int8_t* syscall_names[NUM_SYSCALLS] = {
+    "halt", "execute", "read", "write", "open", "close", "getargs", "vidmap", "set_handler",
+    "sigreturn", "mmap", "create", "unlink", "truncate", "getdents", "lseek", "pread", "stat",
+    "fstat", "sendfile"
+};
+
+static fd_ops_t procfs_file_table = {&procfs_open, &procfs_close, &procfs_read, &procfs_write, &procfs_lseek};
+static fd_ops_t procfs_dir_table = {&procfs_dir_open, &procfs_dir_close, &procfs_dir_read, &procfs_write,
+                                    NULL, NULL, &procfs_dir_getdents};
+
+/*
+ * put_str
+ * DESCRIPTION: appends a string to the text, dropping what doesn't fit
+ * INPUTS: str: the string
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_str(const int8_t* str) {
+    while (*str != '\0' && text_len < PROCFS_BUF_SIZE) {
+        text[text_len++] = *str++;
+    }
+}
+
+/*
+ * put_num
+ * DESCRIPTION: appends a number in decimal to the text
+ * INPUTS: value: the number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_num(uint32_t value) {
+    int8_t digits[11];
+
+    put_str(itoa(value, digits, 10));
+}
+
+/*
+ * put_hex
+ * DESCRIPTION: appends a number in hex to the text, zero padded
+ * INPUTS: value: the number
+ *         width: digits to pad to
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_hex(uint32_t value, uint32_t width) {
+    int8_t digits[9];
+    uint32_t len;
+
+    itoa(value, digits, 16);
+    for (len = strlen(digits); len < width; len++) {
+        put_str("0");
+    }
+    put_str(digits);
+}
+
+/*
+ * put_field
+ * DESCRIPTION: appends a "label: value" line to the text
+ * INPUTS: label: name of the value
+ *         value: the number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_field(const int8_t* label, uint32_t value) {
+    put_str(label);
+    put_str(": ");
+    put_num(value);
+    put_str("\n");
+}
+
+/* calls made to each system call since boot */
+static void gen_syscalls(void) {
+    uint32_t it;
+
+    for (it = 0; it < NUM_SYSCALLS; it++) {
+        put_field(syscall_names[it], syscall_counts[it]);
+    }
+}
+
+/* interrupts taken on each PIC line since boot */
+static void gen_irqs(void) {
+    uint32_t it;
+
+    for (it = 0; it < NUM_IRQS; it++) {
+        put_str("irq ");
+        put_num(it);
+        put_str(": ");
+        put_num(irq_counts[it]);
+        put_str("\n");
+    }
+}
+
+/* one "pid N: fd fd ..." line per running process, listing its open descriptors */
+static void gen_fds(void) {
+    pcb_t* pcb;
+    uint32_t pid;
+    uint32_t fd;
+
+    for (pid = 0; pid < PID_MAX; pid++) {
+        if ((pcb = sched_pcb(pid)) == NULL) {
+            continue;
+        }
+        put_str("pid ");
+        put_num(pcb->pid);
+        put_str(":");
+        for (fd = 0; fd < MAX_FDS; fd++) {
+            if (pcb->file_array[fd].flags & USE_MASK) {
+                put_str(" ");
+                put_num(fd);
+            }
+        }
+        put_str("\n");
+    }
+}
+
+/* processes running and the most there can be with the memory left */
+static void gen_procs(void) {
+    put_field("running", process_number);
+    put_field("max", sched_max_tasks());
+}
+
+/* block cache counters */
+static void gen_cache(void) {
+    cache_stats_t stats;
+
+    cache_get_stats(&stats);
+    put_field("blocks", CACHE_BLOCKS);
+    put_field("dirty", cache_dirty_count());
+    put_field("hits", stats.hits);
+    put_field("misses", stats.misses);
+    put_field("evictions", stats.evictions);
+    put_field("flushes", stats.flushes);
+    put_field("writebacks", stats.writebacks);
+    put_field("readaheads", stats.readaheads);
+}
+
+/* memory held by processes, mmap and tmpfs, in kB */
+static void gen_mem(void) {
+    palloc_stats_t pages;
+    uint32_t pid;
+    uint32_t mapped = 0;
+    uint32_t cow_used;
+
+    for (pid = 0; pid < PID_MAX; pid++) {
+        mapped += mmap_usage(sched_pcb(pid), NULL);
+    }
+    mmap_usage(NULL, &cow_used);
+    palloc_get_stats(&pages);
+
+    put_field("user_kb", (pages.user_frames - pages.user_frames_free) * (FOUR_MB / 1024));
+    put_field("user_free_kb", pages.user_frames_free * (FOUR_MB / 1024));
+    put_field("kernel_stacks_kb", process_number * KSTACK_PAGES * (FOUR_KB / 1024));
+    put_field("kernel_pages_kb", (pages.kpages - pages.kpages_free) * (FOUR_KB / 1024));
+    put_field("kernel_pages_free_kb", pages.kpages_free * (FOUR_KB / 1024));
+    put_field("mmap_mapped_kb", mapped * (FOUR_KB / 1024));
+    put_field("mmap_cow_kb", cow_used * (FOUR_KB / 1024));
+    put_field("mmap_cow_free_kb", (MMAP_COW_FRAMES - cow_used) * (FOUR_KB / 1024));
+    put_field("tmpfs_kb", (TMPFS_PAGES - tmpfs_free_pages()) * (FOUR_KB / 1024));
+    put_field("tmpfs_free_kb", tmpfs_free_pages() * (FOUR_KB / 1024));
+    put_field("cache_kb", CACHE_BLOCKS * (CACHE_BLOCK_SIZE / 1024));
+}
+
+/*
+ * put_zone
+ * DESCRIPTION: appends the counters of one zone of the frame allocator, each label prefixed
+ *              with its name, and the free blocks of each order on one line
+ * INPUTS: name: the zone's name; zone: ZONE_KERNEL or ZONE_USER
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_zone(const int8_t* name, uint32_t zone) {
+    palloc_zone_t stats;
+    uint32_t order;
+
+    palloc_get_zone(zone, &stats);
+    put_str(name);
+    put_field("_pages", stats.pages);
+    put_str(name);
+    put_field("_free_pages", stats.free_pages);
+    put_str(name);
+    put_str("_free_blocks:");
+    for (order = 0; order <= PALLOC_MAX_ORDER; order++) {
+        put_str(" ");
+        put_num(stats.free_blocks[order]);
+    }
+    put_str("\n");
+    put_str(name);
+    put_field("_allocs", stats.allocs);
+    put_str(name);
+    put_field("_splits", stats.splits);
+    put_str(name);
+    put_field("_merges", stats.merges);
+    put_str(name);
+    put_field("_failures", stats.failures);
+}
+
+/* the buddy allocator's zones, with free blocks counted by order from 4kB to 4MB, and how */
+/* much free memory is in pieces too small for a kernel stack or a user page              */
+static void gen_frames(void) {
+    put_zone("kernel", ZONE_KERNEL);
+    put_field("kernel_frag_stack_pct", palloc_fragmentation(ZONE_KERNEL, frame_order(KSTACK_PAGES)));
+    put_zone("user", ZONE_USER);
+    put_field("user_frag_page_pct", palloc_fragmentation(ZONE_USER, PALLOC_MAX_ORDER));
+}
+
+/* one "name: size S active A/T slabs N order O allocs ... failures F" line per object cache, */
+/* where T is the objects its slabs hold, so T - A are constructed and waiting                 */
+static void gen_slabs(void) {
+    kmem_cache_t* cache;
+    uint32_t idx;
+
+    for (idx = 0; (cache = kmem_cache_get(idx)) != NULL; idx++) {
+        put_str(cache->name);
+        put_str(": size ");
+        put_num(cache->size);
+        put_str(" active ");
+        put_num(cache->active);
+        put_str("/");
+        put_num(cache->slabs * cache->per_slab);
+        put_str(" slabs ");
+        put_num(cache->slabs);
+        put_str(" order ");
+        put_num(cache->order);
+        put_str(" allocs ");
+        put_num(cache->allocs);
+        put_str(" frees ");
+        put_num(cache->frees);
+        put_str(" grows ");
+        put_num(cache->grows);
+        put_str(" shrinks ");
+        put_num(cache->shrinks);
+        put_str(" failures ");
+        put_num(cache->failures);
+        put_str("\n");
+    }
+}
+
+/* one "bus:dev.func vendor:device class C irq N" line per PCI function, in hex but the irq */
+static void gen_pci(void) {
+    pci_dev_t* pdev;
+    uint32_t idx;
+
+    for (idx = 0; (pdev = pci_device(idx)) != NULL; idx++) {
+        put_hex(pdev->bus, 2);
+        put_str(":");
+        put_hex(pdev->dev, 2);
+        put_str(".");
+        put_hex(pdev->func, 1);
+        put_str(" ");
+        put_hex(pdev->vendor, 4);
+        put_str(":");
+        put_hex(pdev->device, 4);
+        put_str(" class ");
+        put_hex(pdev->class_code, 4);
+        put_str(" irq ");
+        put_num(pdev->irq);
+        put_str("\n");
+    }
+}
+
+/*
+ * put_disk
+ * DESCRIPTION: appends the counters of one disk backend, each label prefixed with its name
+ * INPUTS: name: the backend
+ *         size: 4kB blocks on the disk, 0 if there is none
+ *         stats: its counters
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void put_disk(const int8_t* name, uint32_t size, blk_stats_t* stats) {
+    put_str(name);
+    put_field("_size_blocks", size);
+    put_str(name);
+    put_field("_requests", stats->requests);
+    put_str(name);
+    put_field("_submits", stats->submits);
+    put_str(name);
+    put_field("_blocks", stats->blocks);
+    put_str(name);
+    put_field("_errors", stats->errors);
+    put_str(name);
+    put_field("_avg_latency_cycles", blk_stats_avg_latency(stats));
+    put_str(name);
+    put_field("_max_latency_cycles", stats->max_latency);
+}
+
+/* request counts and latencies of the IDE and virtio disks; IOPS is the TSC rate over the */
+/* average latency for one request at a time, times the requests per submit when batched */
+static void gen_disks(void) {
+    blk_stats_t stats;
+
+    ata_get_stats(&stats);
+    put_disk("ata", ata_block_count(), &stats);
+    virtio_blk_get_stats(&stats);
+    put_disk("virtio", virtio_blk_block_count(), &stats);
+}
+
+/*
+ * task_state
+ * DESCRIPTION: tells whether a process has the CPU, waits for a child to halt or waits in
+ *              the run queue
+ * INPUTS: pcb: the process
+ * OUTPUTS: none
+ * RETURN VALUE: "running", "waiting" or "ready"
+ */
+static const int8_t* task_state(pcb_t* pcb) {
+    pcb_t* other;
+    uint32_t pid;
+
+    if (pcb == cur_pcb) {
+        return "running";
+    }
+    for (pid = 0; pid < PID_MAX; pid++) {
+        if ((other = sched_pcb(pid)) != NULL && (pcb_t*) other->old_pcb_ptr == pcb) {
+            return "waiting";
+        }
+    }
+    return "ready";
+}
+
+/* timer and scheduler counters, then one "pid N: T ticks state ttyK" line per process. The busy */
+/* ticks are CPU time all programs got together, split between them by their tick counts, */
+/* and programs finished per minute is the throughput of the whole mix                    */
+static void gen_sched(void) {
+    sched_stats_t stats;
+    pcb_t* pcb;
+    uint32_t pid;
+    uint32_t ticks = pit_ticks();
+
+    sched_get_stats(&stats);
+    put_field("hz", pit_hz());
+    put_field("slice_ticks", sched_slice());
+    put_field("ticks", ticks);
+    put_field("busy_ticks", stats.busy_ticks);
+    put_field("idle_ticks", stats.idle_ticks);
+    put_field("switches", stats.switches);
+    put_field("preemptions", stats.preemptions);
+    put_field("yields", stats.yields);
+    put_field("ready", sched_queued());
+    put_field("exited", stats.exited);
+    put_field("exited_ticks", stats.exited_ticks);
+    put_field("exited_per_min", (ticks == 0) ? 0 : stats.exited * 60 * pit_hz() / ticks);
+    for (pid = 0; pid < PID_MAX; pid++) {
+        if ((pcb = sched_pcb(pid)) == NULL) {
+            continue;
+        }
+        put_str("pid ");
+        put_num(pid);
+        put_str(": ");
+        put_num(pcb->run_ticks);
+        put_str(" ticks ");
+        put_str(task_state(pcb));
+        put_str(" tty");
+        put_num(pcb->terminal + 1);
+        put_str("\n");
+    }
+}
+
+/*
+ * generate
+ * DESCRIPTION: rebuilds the text of a file from the current counters
+ * INPUTS: idx: index of the file
+ * OUTPUTS: none
+ * RETURN VALUE: length of the text
+ */
+static uint32_t generate(uint32_t idx) {
+    text_len = 0;
+    files[idx].generate();
+    return text_len;
+}
+
+/*
+ * find_file
+ * DESCRIPTION: looks a name up among the files
+ * INPUTS: name: the name
+ * OUTPUTS: none
+ * RETURN VALUE: index of the file, or -1 if there's none by that name
+ */
+static int32_t find_file(const uint8_t* name) {
+    uint32_t idx;
+
+    for (idx = 0; idx < NUM_FILES; idx++) {
+        if (strncmp(files[idx].name, (int8_t*) name, NAME_LEN + 1) == 0) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/*
+ * fd_valid
+ * DESCRIPTION: checks a descriptor of the current process is open on procfs operations
+ * INPUTS: fd: the descriptor
+ *         ops: procfs_file_table or procfs_dir_table, whichever the descriptor must have
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if it is, else 0
+ */
+static int32_t fd_valid(int32_t fd, fd_ops_t* ops) {
+    file_desc_t* desc;
+
+    if (fd < FD_FIRST || fd >= MAX_FDS) {
+        return 0;
+    }
+    desc = &(cur_pcb->file_array)[fd];
+    return (desc->flags & USE_MASK) && desc->file_op_ptr == ops && desc->inode < NUM_FILES;
+}
+
+/*
+ * procfs_lookup
+ * DESCRIPTION: picks the operations for opening a name: the directory for "", else a file
+ * INPUTS: name: name relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: the operations, or NULL if there's no such file
+ */
+static fd_ops_t* procfs_lookup(const uint8_t* name) {
+    if (name[0] == '\0') {
+        return &procfs_dir_table;
+    }
+    return (find_file(name) >= 0) ? &procfs_file_table : NULL;
+}
+
+/* kernel statistics, mounted at PROCFS_MOUNT by the kernel; files can't be created or removed */
+vfs_fs_t procfs_fs = {&procfs_lookup, &procfs_stat, NULL, NULL};
+
+/*
+ * procfs_stat
+ * DESCRIPTION: fills in the type, index and current text length of a file, or the type of the
+ *              directory
+ * INPUTS: name: name relative to the mount point
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there's no such file
+ */
+int32_t procfs_stat(const uint8_t* name, stat_t* st) {
+    int32_t idx;
+
+    if (name == NULL || st == NULL) {
+        return -1;
+    }
+    if (name[0] == '\0') {
+        st->type = DIR_FILE;
+        st->inode = 0;
+        st->size = 0;
+        st->blocks = 0;
+        return 0;
+    }
+    if ((idx = find_file(name)) < 0) {
+        return -1;
+    }
+    st->type = REG_FILE;
+    st->inode = idx;
+    st->size = generate(idx);
+    st->blocks = 0;
+    return 0;
+}
+
+/*
+ * procfs_open
+ * DESCRIPTION: open operation for procfs files
+ * INPUTS: fd: free descriptor to set up, picked by the caller
+ *         name: name relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there's no such file
+ */
+int32_t procfs_open(int32_t fd, const uint8_t* name) {
+    int32_t idx;
+
+    if (fd < FD_FIRST || fd >= MAX_FDS || name == NULL || (idx = find_file(name)) < 0) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].inode = idx;
+    (cur_pcb->file_array)[fd].file_pos = 0;
+    (cur_pcb->file_array)[fd].flags = USE_MASK | (REG_FILE << TYPE_SHIFT);
+    return 0;
+}
+
+/*
+ * procfs_close
+ * DESCRIPTION: close operation for procfs files
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if fd isn't an open procfs file
+ */
+int32_t procfs_close(int32_t fd) {
+    if (!fd_valid(fd, &procfs_file_table)) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].flags = 0;
+    return 0;
+}
+
+/*
+ * procfs_read
+ * DESCRIPTION: read operation for procfs files; generates the text from the current counters
+ *              and copies it from the file position on, so a file read in pieces can see the
+ *              counters move between pieces
+ * INPUTS: fd: the descriptor
+ *         buf: where to copy to
+ *         nbytes: bytes wanted
+ * OUTPUTS: none
+ * RETURN VALUE: bytes read, 0 at the end of the text, -1 on failure
+ */
+int32_t procfs_read(int32_t fd, void* buf, int32_t nbytes) {
+    file_desc_t* desc;
+    uint32_t length;
+
+    if (buf == NULL || nbytes < 0 || !fd_valid(fd, &procfs_file_table)) {
+        return -1;
+    }
+    desc = &(cur_pcb->file_array)[fd];
+
+    length = generate(desc->inode);
+    if (desc->file_pos >= length) {
+        return 0;
+    }
+    if ((uint32_t) nbytes > length - desc->file_pos) {
+        nbytes = length - desc->file_pos;
+    }
+    memcpy(buf, text + desc->file_pos, nbytes);
+    desc->file_pos += nbytes;
+    return nbytes;
+}
+
+/*
+ * procfs_write
+ * DESCRIPTION: write operation for procfs files and the directory; they are read-only
+ * INPUTS: fd: the descriptor
+ *         buf: ignored
+ *         nbytes: ignored
+ * OUTPUTS: none
+ * RETURN VALUE: -1
+ */
+int32_t procfs_write(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/*
+ * procfs_lseek
+ * DESCRIPTION: moves the file position of a procfs file; SEEK_END is relative to the text as
+ *              it would be generated now
+ * INPUTS: fd: the descriptor
+ *         offset: byte offset relative to whence
+ *         whence: SEEK_SET, SEEK_CUR or SEEK_END
+ * OUTPUTS: none
+ * RETURN VALUE: the new file position, or -1 on failure
+ */
+int32_t procfs_lseek(int32_t fd, int32_t offset, int32_t whence) {
+    file_desc_t* desc;
+    uint32_t base;
+
+    if (!fd_valid(fd, &procfs_file_table)) {
+        return -1;
+    }
+    desc = &(cur_pcb->file_array)[fd];
+
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = desc->file_pos;
+            break;
+        case SEEK_END:
+            base = generate(desc->inode);
+            break;
+        default:
+            return -1;
+    }
+
+    if (offset < 0 && (uint32_t) -offset > base) {
+        return -1;
+    }
+    desc->file_pos = base + offset;
+    return base + offset;
+}
+
+/*
+ * procfs_dir_open
+ * DESCRIPTION: open operation for the procfs directory; the file position is the index of the
+ *              next file to list
+ * INPUTS: fd: free descriptor to set up, picked by the caller
+ *         name: "" (the mount point)
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t procfs_dir_open(int32_t fd, const uint8_t* name) {
+    if (fd < FD_FIRST || fd >= MAX_FDS || name == NULL || name[0] != '\0') {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].inode = 0;
+    (cur_pcb->file_array)[fd].file_pos = 0;
+    (cur_pcb->file_array)[fd].flags = USE_MASK | (DIR_FILE << TYPE_SHIFT);
+    return 0;
+}
+
+/*
+ * procfs_dir_close
+ * DESCRIPTION: close operation for the procfs directory
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if fd isn't open on the directory
+ */
+int32_t procfs_dir_close(int32_t fd) {
+    if (!fd_valid(fd, &procfs_dir_table)) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].flags = 0;
+    return 0;
+}
+
+/*
+ * procfs_dir_read
+ * DESCRIPTION: read operation for the procfs directory; one name per call, like dir_read
+ * INPUTS: fd: the descriptor
+ *         buf: where to copy the name
+ *         nbytes: room in buf
+ * OUTPUTS: none
+ * RETURN VALUE: characters copied, 0 once every file has been listed, -1 on failure
+ */
+int32_t procfs_dir_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint8_t* buf_ptr = (uint8_t*) buf;
+    uint32_t* pos;
+    int32_t cnt;
+
+    if (buf == NULL || nbytes < 0 || !fd_valid(fd, &procfs_dir_table)) {
+        return -1;
+    }
+    pos = &(cur_pcb->file_array)[fd].file_pos;
+    if (*pos >= NUM_FILES) {
+        return 0;
+    }
+
+    for (cnt = 0; cnt < nbytes && files[*pos].name[cnt] != '\0'; cnt++) {
+        buf_ptr[cnt] = files[*pos].name[cnt];
+    }
+    if (cnt < nbytes) {
+        buf_ptr[cnt] = 0;
+    }
+    (*pos)++;
+    return cnt;
+}
+
+/*
+ * procfs_dir_getdents
+ * DESCRIPTION: reads as many directory records as fit in the buffer, like dir_getdents; sizes
+ *              are left 0 rather than generating every file
+ * INPUTS: fd: the descriptor
+ *         buf: where to write the dirent_t records
+ *         nbytes: size of buf
+ * OUTPUTS: none
+ * RETURN VALUE: bytes written (a multiple of sizeof(dirent_t)), 0 at the end of the directory,
+ *               -1 on failure
+ */
+int32_t procfs_dir_getdents(int32_t fd, void* buf, int32_t nbytes) {
+    dirent_t* ent = (dirent_t*) buf;
+    uint32_t* pos;
+    uint32_t n_fit;
+    uint32_t cnt;
+
+    if (buf == NULL || nbytes < (int32_t) sizeof(dirent_t) || !fd_valid(fd, &procfs_dir_table)) {
+        return -1;
+    }
+    pos = &(cur_pcb->file_array)[fd].file_pos;
+
+    n_fit = nbytes / sizeof(dirent_t);
+    for (cnt = 0; cnt < n_fit && *pos < NUM_FILES; cnt++, (*pos)++) {
+        memset(&ent[cnt], 0, sizeof(dirent_t));
+        strncpy((int8_t*) ent[cnt].name, files[*pos].name, NAME_LEN);
+        ent[cnt].type = REG_FILE;
+        ent[cnt].inode = *pos;
+    }
+    return cnt * sizeof(dirent_t);
+}
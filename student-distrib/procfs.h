@@ -0,0 +1,39 @@
+#ifndef _PROCFS_H
+#define _PROCFS_H
+
+#include "types.h"
+#include "pcb.h"
+#include "filesys.h"
+
+#define PROCFS_MOUNT        "proc"      /* where the kernel mounts it                           */
+#define PROCFS_BUF_SIZE     2048        /* longest text a file can generate                     */
+#define NUM_SYSCALLS        20          /* entries in the system call jump table                */
+
+/* calls made to each system call, counted by the assembly linkage in exceptions.S */
+extern uint32_t syscall_counts[NUM_SYSCALLS];
+/* processes running, from sys_calls.h */
+extern uint32_t process_number;
+
+/*
+ * Read-only files of kernel statistics. Nothing is kept up to date for them: the text of a
+ * file is generated from the live counters on every read (and stat), so it costs nothing
+ * until someone looks.
+ */
+
+/* names relative to the mount point; "" is its directory */
+int32_t procfs_stat(const uint8_t* name, stat_t* st);
+
+/* file driver functions */
+int32_t procfs_open(int32_t fd, const uint8_t* name);
+int32_t procfs_close(int32_t fd);
+int32_t procfs_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t procfs_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t procfs_lseek(int32_t fd, int32_t offset, int32_t whence);
+
+/* directory driver functions */
+int32_t procfs_dir_open(int32_t fd, const uint8_t* name);
+int32_t procfs_dir_close(int32_t fd);
+int32_t procfs_dir_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t procfs_dir_getdents(int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* _PROCFS_H */
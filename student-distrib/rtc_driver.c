@@ -2,25 +2,38 @@
 #include "i8259.h"
 #include "lib.h"
 #include "pcb.h"
+#include "vfs.h"
+#include "sched.h"
+
+/* interrupts since boot, which rtc_read waits on */
+static volatile uint32_t rtc_ticks;
+
+static fd_ops_t rtc_table = {&rtc_open, &rtc_close, &rtc_read, &rtc_write};
 
 /* void rtc_init
  *   Inputs: None
  *   Outputs: None
- *   Function: Sets the registers in RTC to initialize it
+ *   Function: Sets the registers in RTC to initialize it, and registers the driver for
+ *             rtc files
 */
 void rtc_init(){
 	outb(RTC_REGB, RTC_PORT);
 	char prev=inb(RTC_PORT+1);
 	outb(RTC_REGB, RTC_PORT);
 	outb( prev | RTC_6_BIT, RTC_PORT+1);
+	vfs_register_type(RTC_FILE, &rtc_table);
 };
 
 /* void rtc_open
- *   Inputs: None
+ *   Inputs: fd - free descriptor to set up, picked by the caller; filename - unused
  *   Outputs: Returns zero upon successful initialization
  *   Function: Initializes rtc to 2khz
 */
-int rtc_open(const uint8_t* filename){
+int rtc_open(int32_t fd, const uint8_t* filename){
+	if (fd < FD_FIRST || fd >= MAX_FDS) {
+		return -1;
+	}
+
 	// initialize rtc frequency to 2Hz;
 	unsigned char rate = init_rate;			// rate must be above 2 and not over 15
 	cli();
@@ -33,26 +46,11 @@ int rtc_open(const uint8_t* filename){
 	enable_irq(8);
 	rtc_interrupt = 0;
 	// Add rtc to the file array
-	// Find an empty file descriptor
-	int i, file_idx;
-	file_idx = -1;
-	for(i = 2; i<8;i++){
-		// Check each entry in the file array for an unused entry
-		if((cur_pcb->file_array)[i].flags % 2 == 0){
-			file_idx = i;
-			break;
-		}
-	}
-	// No empty file descriptor found
-	if (file_idx == -1){
-		return -1;
-	}
-
-	(cur_pcb->file_array)[file_idx].inode = 0;        // set inode num
-    (cur_pcb->file_array)[file_idx].file_pos = 0;                         // start at oth byte
-    (cur_pcb->file_array)[file_idx].flags = 0x00000001;                   // mark as in use
-    (cur_pcb->file_array)[file_idx].flags |= 0 << 1;      // mark as rtc type
-    (cur_pcb->file_array)[file_idx].flags |= 0x1 << 8;
+	(cur_pcb->file_array)[fd].inode = 0;        // set inode num
+    (cur_pcb->file_array)[fd].file_pos = 0;                         // start at oth byte
+    (cur_pcb->file_array)[fd].flags = 0x00000001;                   // mark as in use
+    (cur_pcb->file_array)[fd].flags |= 0 << 1;      // mark as rtc type
+    (cur_pcb->file_array)[fd].flags |= 0x1 << 8;
 	sti();
 	return 0;
 };
@@ -123,16 +121,13 @@ int rtc_write(int32_t fd, const void* buf, int32_t nbytes){
  *   Function: Spins until an rtc interrupt is received
 */
 int rtc_read(int32_t fd, void* buf, int32_t nbytes){
-	// Wait for an interrupt
-	while(1){
-		// if interrupt happens
-		cli();
-		if(rtc_interrupt){
-			rtc_interrupt = 0;
-			break;
-		}
-		sti();
+	// Wait for the next interrupt; counting them wakes every program waiting, not just one
+	uint32_t start = rtc_ticks;
+	while(rtc_ticks == start){
+		// let other programs run meanwhile
+		sched_yield();
 	}
+	rtc_interrupt = 0;
 	// Service Interrupt
 	return 0;
 }
@@ -144,6 +139,7 @@ extern void rtc_handler() {
 	cli();
 	// Receive and service the interrupt
 	rtc_interrupt = 1;
+	rtc_ticks++;
 	outb(RTC_REGC,RTC_PORT);
 	inb(RTC_PORT+1);
 	send_eoi(8);
@@ -6,7 +6,7 @@
 // RTC Initialization
 void rtc_init();
 // RTC Initialization to freq 2048Hz
-int rtc_open(const uint8_t* filename);
+int rtc_open(int32_t fd, const uint8_t* filename);
 // DOes nothing
 int rtc_close(int32_t fd);
 // Change rtc to inputted rate
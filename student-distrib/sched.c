@@ -0,0 +1,380 @@
+#include "sched.h"
+#include "context.h"
+#include "x86_desc.h"
+#include "paging_c.h"
+#include "mmap.h"
+#include "palloc.h"
+#include "slab.h"
+#include "key_driver.h"
+#include "lib.h"
+
+/* one bit per process id, set while it's in use; ids are handed out round the map, so a */
+/* halted process's id isn't given to the next one at once */
+static uint32_t pid_map[PID_MAX / 32];
+static uint32_t next_pid;
+/* pcb of each id in use */
+static pcb_t* pid_table[PID_MAX];
+/* where pcbs come from */
+static kmem_cache_t* pcb_cache;
+
+/* run queue, linked through sched_next; the running task is not in it */
+static pcb_t* queue_head;
+static pcb_t* queue_tail;
+static uint32_t n_queued;
+
+static uint32_t slice = SCHED_SLICE_TICKS;
+static uint32_t slice_used;
+static sched_stats_t stats;
+
+/* stack pointer of a task that won't run again, saved by sched_exit and never used */
+static uint32_t dead_esp;
+
+/*
+ * claim_pid
+ * DESCRIPTION: finds the next free process id after the last one handed out and marks it used
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the id, or -1 if all PID_MAX are taken
+ */
+static int32_t claim_pid(void) {
+    uint32_t pid = next_pid;
+    uint32_t tried;
+
+    for (tried = 0; tried < PID_MAX; tried++, pid = (pid + 1) % PID_MAX) {
+        if ((pid_map[pid >> 5] & (1U << (pid & 31))) == 0) {
+            pid_map[pid >> 5] |= 1U << (pid & 31);
+            next_pid = (pid + 1) % PID_MAX;
+            return pid;
+        }
+    }
+    return -1;
+}
+
+/*
+ * release_pid
+ * DESCRIPTION: marks a process id free
+ * INPUTS: pid: the id
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void release_pid(uint32_t pid) {
+    pid_map[pid >> 5] &= ~(1U << (pid & 31));
+    pid_table[pid] = NULL;
+}
+
+/*
+ * sched_init
+ * DESCRIPTION: makes the cache pcbs are taken from
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_init(void) {
+    pcb_cache = kmem_cache_create("pcb", sizeof(pcb_t), NULL);
+}
+
+/*
+ * sched_new_task
+ * DESCRIPTION: gives a new process an id, a pcb, a kernel stack, an empty mmap page table
+ *              and a 4MB user page
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the zeroed pcb with pid, kernel_esp0, user_page and mmap_table set, or NULL
+ *               if the ids or memory ran out
+ */
+pcb_t* sched_new_task(void) {
+    int32_t pid;
+    uint8_t* stack;
+    pt_entry_t* table;
+    uint32_t frame;
+    pcb_t* pcb;
+
+    if ((pid = claim_pid()) == -1) {
+        return NULL;
+    }
+    pcb = kmem_cache_alloc(pcb_cache);
+    stack = kpage_alloc(KSTACK_PAGES);
+    table = kpage_alloc(1);
+    frame = user_frame_alloc();
+    if (pcb == NULL || stack == NULL || table == NULL || frame == 0) {
+        if (pcb != NULL) {
+            kmem_cache_free(pcb_cache, pcb);
+        }
+        if (stack != NULL) {
+            kpage_free(stack, KSTACK_PAGES);
+        }
+        if (table != NULL) {
+            kpage_free(table, 1);
+        }
+        if (frame != 0) {
+            user_frame_free(frame);
+        }
+        release_pid(pid);
+        return NULL;
+    }
+
+    memset(pcb, 0, sizeof(pcb_t));
+    memset(table, 0, FOUR_KB);
+    pcb->pid = pid;
+    pcb->kernel_esp0 = (uint32_t) stack + KSTACK_PAGES * FOUR_KB;
+    pcb->user_page = frame / FOUR_MB;
+    pcb->mmap_table = table;
+    pid_table[pid] = pcb;
+    return pcb;
+}
+
+/*
+ * sched_release_task
+ * DESCRIPTION: frees the id, user page and mmap page table of a halted process and counts its
+ *              run time; its pcb and kernel stack, which it may still be running on, are
+ *              freed by sched_free_task
+ * INPUTS: pcb: the process, with its mmap window released
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_release_task(pcb_t* pcb) {
+    stats.exited++;
+    stats.exited_ticks += pcb->run_ticks;
+    user_frame_free(pcb->user_page * FOUR_MB);
+    kpage_free(pcb->mmap_table, 1);
+    release_pid(pcb->pid);
+}
+
+/*
+ * sched_free_task
+ * DESCRIPTION: frees the kernel stack and pcb of a released process. Nothing allocates from
+ *              an interrupt and freeing writes neither, so the caller may still be on the
+ *              stack and read the pcb until it switches away
+ * INPUTS: pcb: the process
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_free_task(pcb_t* pcb) {
+    kpage_free((void*) (pcb->kernel_esp0 - KSTACK_PAGES * FOUR_KB), KSTACK_PAGES);
+    kmem_cache_free(pcb_cache, pcb);
+}
+
+/*
+ * sched_max_tasks
+ * DESCRIPTION: counts the processes there could be at once: the running ones, and as many
+ *              more as there are ids and free memory for
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the count
+ */
+uint32_t sched_max_tasks(void) {
+    palloc_stats_t pages;
+    uint32_t running = 0;
+    uint32_t more;
+    uint32_t pid;
+
+    for (pid = 0; pid < PID_MAX; pid++) {
+        running += (pid_table[pid] != NULL);
+    }
+    palloc_get_stats(&pages);
+    /* kernel pages may be too scattered for every stack, so this is an upper bound */
+    more = pages.kpages_free / (KSTACK_PAGES + 1);
+    if (more > pages.user_frames_free) {
+        more = pages.user_frames_free;
+    }
+    if (more > PID_MAX - running) {
+        more = PID_MAX - running;
+    }
+    return running + more;
+}
+
+/*
+ * sched_pcb
+ * DESCRIPTION: finds the PCB of a process id
+ * INPUTS: pid: the id
+ * OUTPUTS: none
+ * RETURN VALUE: the PCB, or NULL if no process has the id
+ */
+pcb_t* sched_pcb(uint32_t pid) {
+    if (pid >= PID_MAX) {
+        return NULL;
+    }
+    return pid_table[pid];
+}
+
+/*
+ * sched_enqueue
+ * DESCRIPTION: puts a task at the back of the run queue
+ * INPUTS: pcb: the task, with sched_esp saved; not the running task
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_enqueue(pcb_t* pcb) {
+    pcb->sched_next = NULL;
+    if (queue_tail == NULL) {
+        queue_head = pcb;
+    }
+    else {
+        queue_tail->sched_next = pcb;
+    }
+    queue_tail = pcb;
+    n_queued++;
+}
+
+/*
+ * sched_queued
+ * DESCRIPTION: returns the number of tasks waiting for the CPU
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the length of the run queue
+ */
+uint32_t sched_queued(void) {
+    return n_queued;
+}
+
+/*
+ * sched_set_slice
+ * DESCRIPTION: sets how many timer ticks a task runs before it is preempted
+ * INPUTS: ticks: 1 to SCHED_MAX_SLICE
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if ticks is out of range
+ */
+int32_t sched_set_slice(uint32_t ticks) {
+    if (ticks == 0 || ticks > SCHED_MAX_SLICE) {
+        return -1;
+    }
+    slice = ticks;
+    return 0;
+}
+
+/*
+ * sched_slice
+ * DESCRIPTION: returns the length of a time slice
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: timer ticks per slice
+ */
+uint32_t sched_slice(void) {
+    return slice;
+}
+
+/*
+ * dequeue
+ * DESCRIPTION: takes the task at the front of the run queue
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the task, or NULL if the queue is empty
+ */
+static pcb_t* dequeue(void) {
+    pcb_t* pcb = queue_head;
+
+    if (pcb != NULL) {
+        queue_head = pcb->sched_next;
+        if (queue_head == NULL) {
+            queue_tail = NULL;
+        }
+        n_queued--;
+    }
+    return pcb;
+}
+
+/*
+ * switch_to_next
+ * DESCRIPTION: gives the CPU to the task at the front of the run queue: makes it cur_pcb,
+ *              points tss.esp0 at its kernel stack, maps its user page, screen and mmap
+ *              window and moves to the stack it was saved on
+ * INPUTS: save_esp: where the stack pointer of the task giving up the CPU is kept
+ * OUTPUTS: none
+ * RETURN VALUE: none; returns when the caller's task is switched back to
+ * SIDE EFFECTS: must be called with interrupts off and a task in the queue
+ */
+static void switch_to_next(uint32_t* save_esp) {
+    pd_entry_bigPage_t* program_page = get_bigPage(PRO_ADDR);
+    pcb_t* next = dequeue();
+
+    cur_pcb = next;
+    tss.esp0 = next->kernel_esp0;
+    program_page->page_base_addr = next->user_page;
+    terminal_map_video(next);
+    /* loading the mmap window flushes the TLB, so the old user and video pages go with it */
+    mmap_load(next);
+    slice_used = 0;
+    stats.switches++;
+    switch_stack(save_esp, next->sched_esp);
+}
+
+/*
+ * sched_tick
+ * DESCRIPTION: charges a timer tick to the running task and, once its slice is used up
+ *              and there is another task waiting, moves it to the back of the run queue.
+ *              A task in the kernel is left alone until it returns to user mode or yields
+ * INPUTS: user: 1 if the tick interrupted user code
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: called from the timer interrupt, with interrupts off
+ */
+void sched_tick(uint32_t user) {
+    pcb_t* prev = cur_pcb;
+
+    if (prev == NULL) {
+        stats.idle_ticks++;
+        return;
+    }
+    stats.busy_ticks++;
+    prev->run_ticks++;
+    if (++slice_used < slice || !user || queue_head == NULL) {
+        return;
+    }
+    stats.preemptions++;
+    sched_enqueue(prev);
+    switch_to_next(&prev->sched_esp);
+}
+
+/*
+ * sched_yield
+ * DESCRIPTION: moves the running task to the back of the run queue so the next one runs;
+ *              returns at once if no other task is waiting
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_yield(void) {
+    pcb_t* prev = cur_pcb;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (prev != NULL && queue_head != NULL) {
+        stats.yields++;
+        sched_enqueue(prev);
+        switch_to_next(&prev->sched_esp);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * sched_exit
+ * DESCRIPTION: leaves a background task that has halted and been released, for the next
+ *              task in the run queue, freeing its pcb and kernel stack on the way
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none; does not return
+ */
+void sched_exit(void) {
+    cli();
+    sched_free_task(cur_pcb);
+    if (queue_head == NULL) {
+        /* the boot shell's chain is always a task, so this is not expected */
+        cur_pcb = NULL;
+        sti();
+        while (1) {
+            asm volatile ("hlt");
+        }
+    }
+    switch_to_next(&dead_esp);
+}
+
+/*
+ * sched_get_stats
+ * DESCRIPTION: copies out the scheduler counters
+ * INPUTS: out: where to put them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void sched_get_stats(sched_stats_t* out) {
+    *out = stats;
+}
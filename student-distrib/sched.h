@@ -0,0 +1,72 @@
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "types.h"
+#include "pcb.h"
+
+/* timer ticks a task runs before the next one in the run queue gets the CPU */
+#ifndef SCHED_SLICE_TICKS
+#define SCHED_SLICE_TICKS   2
+#endif
+#define SCHED_MAX_SLICE     1000        /* longest slice sched_set_slice accepts                */
+#define KSTACK_PAGES        2           /* 4kB pages of a kernel stack                          */
+
+#define SCHED_DETACHED      0x00000001  /* started in the background; nothing waits for its halt */
+#define SCHED_RESPAWN       0x00000002  /* a terminal's own shell, started again when it halts  */
+
+/*
+ * Round-robin scheduling of processes. A task is the innermost process of a chain of
+ * executes: its parents wait in the kernel for it to halt, so only the task runs. The
+ * running task is cur_pcb; the others wait in a FIFO run queue with their kernel stacks
+ * saved by switch_stack. The timer takes the CPU from a task only while it runs user
+ * code, since the kernel is not reentrant; a task waiting in the kernel for input gives
+ * it up itself with sched_yield.
+ */
+
+/* scheduler counters since boot */
+typedef struct sched_stats {
+    uint32_t switches;          /* context switches, for any reason                     */
+    uint32_t preemptions;       /* switches because a time slice ran out                */
+    uint32_t yields;            /* switches because a task waiting in the kernel yielded */
+    uint32_t busy_ticks;        /* timer ticks with a process running                   */
+    uint32_t idle_ticks;        /* timer ticks with only the kernel running             */
+    uint32_t exited;            /* processes that have halted                           */
+    uint32_t exited_ticks;      /* timer ticks those processes ran for                  */
+} sched_stats_t;
+
+/* makes the pcb cache; after slab_init */
+void sched_init(void);
+/* gives a new process an id, pcb, kernel stack, mmap table and user page, or returns NULL */
+pcb_t* sched_new_task(void);
+/* frees all of a halted process but its pcb and kernel stack, adding its run time to the counters */
+void sched_release_task(pcb_t* pcb);
+/* frees the pcb and kernel stack of a released process */
+void sched_free_task(pcb_t* pcb);
+/* processes there could be at once, running ones included, given free ids and memory */
+uint32_t sched_max_tasks(void);
+/* PCB of a process id in use, or NULL */
+pcb_t* sched_pcb(uint32_t pid);
+
+/* adds a task that isn't running to the back of the run queue */
+void sched_enqueue(pcb_t* pcb);
+/* tasks waiting in the run queue */
+uint32_t sched_queued(void);
+
+/* length of a time slice in timer ticks, 1 to SCHED_MAX_SLICE */
+int32_t sched_set_slice(uint32_t ticks);
+uint32_t sched_slice(void);
+
+/* charges a timer tick to the running task and preempts it if its slice is over */
+void sched_tick(uint32_t user);
+/* lets the next task run, if there is one; for loops that wait in the kernel */
+void sched_yield(void);
+/* switches away from a halted background task for good */
+void sched_exit(void);
+
+void sched_get_stats(sched_stats_t* out);
+
+/* starts a program in the background on a terminal, with SCHED_DETACHED and any other */
+/* flags; it's in sys_calls.c, next to execute. Returns 0, or -1 if it can't be run     */
+int32_t spawn_program(const uint8_t* command, uint32_t flags, uint32_t terminal);
+
+#endif /* _SCHED_H */
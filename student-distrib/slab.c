@@ -0,0 +1,309 @@
+#include "slab.h"
+#include "lib.h"
+
+#define KERNEL_PAGES    (FOUR_MB / FOUR_KB)     /* frames of the kernel zone's 4MB page */
+
+static kmem_cache_t caches[SLAB_MAX_CACHES];
+static uint32_t n_caches;
+
+/* slab each kernel zone frame belongs to, so a pointer finds its slab whatever the order */
+static slab_t* frame_slab[KERNEL_PAGES];
+
+static kmem_cache_t* kmalloc_caches[KMALLOC_CACHES];
+static const int8_t* kmalloc_names[KMALLOC_CACHES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256", "kmalloc-512",
+    "kmalloc-1024", "kmalloc-2048"
+};
+
+/*
+ * list_add
+ * DESCRIPTION: puts a slab at the front of one of its cache's lists
+ * INPUTS: list: the list; slab: the slab, on no list
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void list_add(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/*
+ * list_del
+ * DESCRIPTION: takes a slab off the list it is on
+ * INPUTS: list: the list; slab: the slab
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void list_del(slab_t** list, slab_t* slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    }
+    else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/*
+ * slab_fit
+ * DESCRIPTION: works out how many objects of a cache fit in a slab of an order and where
+ *              the first one goes, after the header and its free index stack
+ * INPUTS: stride: bytes per object; order: the slab's order; offset: set to the first
+ *         object's offset from the slab
+ * OUTPUTS: none
+ * RETURN VALUE: objects that fit
+ */
+static uint32_t slab_fit(uint32_t stride, uint32_t order, uint32_t* offset) {
+    uint32_t bytes = FOUR_KB << order;
+    uint32_t count = (bytes - sizeof(slab_t)) / (stride + sizeof(uint16_t));
+
+    while (count > 0) {
+        *offset = (sizeof(slab_t) + count * sizeof(uint16_t) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+        if (*offset + count * stride <= bytes) {
+            break;
+        }
+        count--;
+    }
+    return count;
+}
+
+/*
+ * slab_grow
+ * DESCRIPTION: makes a slab for a cache from palloc frames and constructs its objects
+ * INPUTS: cache: the cache
+ * OUTPUTS: none
+ * RETURN VALUE: the slab, not on any list, or NULL if palloc is out of frames
+ */
+static slab_t* slab_grow(kmem_cache_t* cache) {
+    slab_t* slab;
+    uint32_t offset;
+    uint32_t it;
+
+    if ((slab = kpage_alloc(1 << cache->order)) == NULL) {
+        cache->failures++;
+        return NULL;
+    }
+    slab_fit(cache->stride, cache->order, &offset);
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->objects = (uint8_t*) slab + offset;
+    slab->in_use = 0;
+    slab->n_free = cache->per_slab;
+    /* hand out low objects first */
+    for (it = 0; it < cache->per_slab; it++) {
+        slab->free[it] = cache->per_slab - 1 - it;
+        if (cache->ctor != NULL) {
+            cache->ctor(slab->objects + it * cache->stride);
+        }
+    }
+    for (it = 0; it < (1U << cache->order); it++) {
+        frame_slab[((uint32_t) slab - KER_ADDR) / FOUR_KB + it] = slab;
+    }
+    cache->slabs++;
+    cache->grows++;
+    return slab;
+}
+
+/*
+ * slab_shrink
+ * DESCRIPTION: gives the frames of an empty slab back to palloc
+ * INPUTS: slab: the slab, on no list
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void slab_shrink(slab_t* slab) {
+    kmem_cache_t* cache = slab->cache;
+    uint32_t it;
+
+    for (it = 0; it < (1U << cache->order); it++) {
+        frame_slab[((uint32_t) slab - KER_ADDR) / FOUR_KB + it] = NULL;
+    }
+    slab->magic = 0;
+    kpage_free(slab, 1 << cache->order);
+    cache->slabs--;
+    cache->shrinks++;
+}
+
+/*
+ * find_slab
+ * DESCRIPTION: finds the slab an object came from
+ * INPUTS: obj: the object
+ * OUTPUTS: none
+ * RETURN VALUE: the slab, or NULL if obj isn't in one
+ */
+static slab_t* find_slab(void* obj) {
+    uint32_t addr = (uint32_t) obj;
+    slab_t* slab;
+
+    if (addr < KER_ADDR || addr >= KER_ADDR + FOUR_MB) {
+        return NULL;
+    }
+    slab = frame_slab[(addr - KER_ADDR) / FOUR_KB];
+    if (slab == NULL || slab->magic != SLAB_MAGIC) {
+        return NULL;
+    }
+    return slab;
+}
+
+/*
+ * slab_init
+ * DESCRIPTION: makes the kmalloc caches, one per power of two from KMALLOC_MIN to KMALLOC_MAX
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void slab_init(void) {
+    uint32_t it;
+
+    for (it = 0; it < KMALLOC_CACHES; it++) {
+        kmalloc_caches[it] = kmem_cache_create(kmalloc_names[it], KMALLOC_MIN << it, NULL);
+    }
+}
+
+/*
+ * kmem_cache_create
+ * DESCRIPTION: sets up a cache, picking the smallest slab order that holds SLAB_MIN_OBJECTS
+ *              objects, or SLAB_MAX_ORDER if none does. No slab is made until the first alloc
+ * INPUTS: name: shown in proc/slabs; size: bytes per object; ctor: sets up each new object,
+ *         or NULL
+ * OUTPUTS: none
+ * RETURN VALUE: the cache, or NULL if SLAB_MAX_CACHES exist or no slab holds an object
+ */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, void (*ctor)(void*)) {
+    kmem_cache_t* cache;
+    uint32_t offset;
+
+    if (n_caches == SLAB_MAX_CACHES || size == 0) {
+        return NULL;
+    }
+    cache = &caches[n_caches];
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+    cache->size = size;
+    cache->stride = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+    cache->ctor = ctor;
+    for (cache->order = 0; cache->order < SLAB_MAX_ORDER; cache->order++) {
+        if (slab_fit(cache->stride, cache->order, &offset) >= SLAB_MIN_OBJECTS) {
+            break;
+        }
+    }
+    if ((cache->per_slab = slab_fit(cache->stride, cache->order, &offset)) == 0) {
+        return NULL;
+    }
+    n_caches++;
+    return cache;
+}
+
+/*
+ * kmem_cache_alloc
+ * DESCRIPTION: takes an object from a partly used slab, else the empty one, else a new one
+ * INPUTS: cache: the cache
+ * OUTPUTS: none
+ * RETURN VALUE: the object, constructed, or NULL if there are no frames for a slab
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    slab_t* slab;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    if ((slab = cache->partial) != NULL) {
+        list_del(&cache->partial, slab);
+    }
+    else if ((slab = cache->empty) != NULL) {
+        list_del(&cache->empty, slab);
+    }
+    else if ((slab = slab_grow(cache)) == NULL) {
+        return NULL;
+    }
+
+    slab->in_use++;
+    list_add((slab->in_use == cache->per_slab) ? &cache->full : &cache->partial, slab);
+    cache->active++;
+    cache->allocs++;
+    return slab->objects + slab->free[--slab->n_free] * cache->stride;
+}
+
+/*
+ * kmem_cache_free
+ * DESCRIPTION: gives an object back to its slab, moving the slab to the list for its new
+ *              state; a second empty slab goes back to palloc
+ * INPUTS: cache: the cache it came from; obj: the object, in its constructed state
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    slab_t* slab = find_slab(obj);
+
+    if (slab == NULL || slab->cache != cache || slab->in_use == 0) {
+        return;
+    }
+    list_del((slab->in_use == cache->per_slab) ? &cache->full : &cache->partial, slab);
+    slab->free[slab->n_free++] = ((uint8_t*) obj - slab->objects) / cache->stride;
+    slab->in_use--;
+    cache->active--;
+    cache->frees++;
+
+    if (slab->in_use > 0) {
+        list_add(&cache->partial, slab);
+    }
+    else if (cache->empty == NULL) {
+        list_add(&cache->empty, slab);
+    }
+    else {
+        slab_shrink(slab);
+    }
+}
+
+/*
+ * kmem_cache_get
+ * DESCRIPTION: returns a cache by the order they were made in
+ * INPUTS: idx: the index
+ * OUTPUTS: none
+ * RETURN VALUE: the cache, or NULL if idx is past the last
+ */
+kmem_cache_t* kmem_cache_get(uint32_t idx) {
+    return (idx < n_caches) ? &caches[idx] : NULL;
+}
+
+/*
+ * kmalloc
+ * DESCRIPTION: takes an object from the smallest kmalloc cache it fits in
+ * INPUTS: size: bytes wanted, 1 to KMALLOC_MAX
+ * OUTPUTS: none
+ * RETURN VALUE: the memory, or NULL
+ */
+void* kmalloc(uint32_t size) {
+    uint32_t it;
+
+    if (size == 0) {
+        return NULL;
+    }
+    for (it = 0; it < KMALLOC_CACHES; it++) {
+        if (size <= (KMALLOC_MIN << it)) {
+            return kmem_cache_alloc(kmalloc_caches[it]);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * kfree
+ * DESCRIPTION: gives memory from kmalloc back to its cache, which its slab knows
+ * INPUTS: ptr: what kmalloc returned; NULL is ignored
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void kfree(void* ptr) {
+    slab_t* slab = find_slab(ptr);
+
+    if (slab != NULL) {
+        kmem_cache_free(slab->cache, ptr);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "palloc.h"
+
+/*
+ * Object caches for kernel structures. A cache hands out objects of one size from slabs,
+ * blocks of kernel zone frames from palloc holding a header and as many objects as fit.
+ * Objects are constructed once, when their slab is made, and must go back to the cache in
+ * the constructed state, so taking one skips the setup. A slab is on one of three lists, by
+ * whether all, some or none of its objects are in use, and a cache keeps at most one empty
+ * slab, giving the rest back to palloc. kmalloc is a set of caches of power of two sizes.
+ */
+
+#define SLAB_MAX_CACHES     16          /* caches that can exist at once                        */
+#define SLAB_MAX_ORDER      3           /* largest slab, 2^3 frames                             */
+#define SLAB_MIN_OBJECTS    8           /* objects a slab should hold, if SLAB_MAX_ORDER allows */
+#define SLAB_ALIGN          8           /* objects start on this boundary                       */
+#define SLAB_MAGIC          0x51AB51AB  /* marks a slab header, to catch bad frees              */
+
+#define KMALLOC_MIN         16          /* smallest kmalloc size class                          */
+#define KMALLOC_MAX         2048        /* largest; bigger blocks come from kpage_alloc         */
+#define KMALLOC_CACHES      8           /* size classes, 16 to 2048 bytes                       */
+
+struct kmem_cache;
+
+/* header at the start of every slab; the stack of free object indices follows it */
+typedef struct slab {
+    uint32_t magic;
+    struct kmem_cache* cache;
+    struct slab* prev;                  /* neighbours in the cache's list for this slab's state */
+    struct slab* next;
+    uint8_t* objects;                   /* the first object                                     */
+    uint16_t in_use;                    /* objects handed out                                   */
+    uint16_t n_free;                    /* entries in free[]                                    */
+    uint16_t free[0];                   /* indices of the free objects                          */
+} slab_t;
+
+typedef struct kmem_cache {
+    const int8_t* name;
+    uint32_t size;                      /* object size asked for                                */
+    uint32_t stride;                    /* bytes from one object to the next                    */
+    uint32_t order;                     /* slabs are 2^order frames                             */
+    uint32_t per_slab;                  /* objects in a slab                                    */
+    void (*ctor)(void*);                /* sets up a new object, or NULL                        */
+    slab_t* full;                       /* slabs with every object in use                       */
+    slab_t* partial;                    /* slabs with some in use                               */
+    slab_t* empty;                      /* a slab with none in use, kept for the next alloc     */
+    uint32_t slabs;                     /* slabs the cache has                                  */
+    uint32_t active;                    /* objects in use                                       */
+    uint32_t allocs;                    /* objects handed out since the cache was made          */
+    uint32_t frees;                     /* and given back                                       */
+    uint32_t grows;                     /* slabs made                                           */
+    uint32_t shrinks;                   /* slabs given back to palloc                           */
+    uint32_t failures;                  /* allocations palloc had no frames for                 */
+} kmem_cache_t;
+
+/* makes the kmalloc caches; after palloc has its RAM */
+void slab_init(void);
+
+/* makes a cache of objects of a size, each set up by ctor (may be NULL); NULL if there's no */
+/* room for another cache or the objects are too big for a slab                              */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, void (*ctor)(void*));
+/* a constructed object, or NULL if there are no frames for another slab */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+/* gives an object back, in its constructed state */
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+/* the cache with an index, for listing them; NULL past the last */
+kmem_cache_t* kmem_cache_get(uint32_t idx);
+
+/* size bytes of kernel memory, up to KMALLOC_MAX, or NULL; not zeroed */
+void* kmalloc(uint32_t size);
+/* gives back memory from kmalloc */
+void kfree(void* ptr);
+
+#endif /* _SLAB_H */
@@ -3,7 +3,43 @@
 #define TERMINAL_FILE_FLAGS 0x7 //mark in use, of file type 4, ...000111
 #define STDIN_INDEX			0
 #define STDOUT_INDEX		1
-#define FD_SIZE				7
+
+/* process sys_halt_c is returning from; a global, as its locals are out of reach once it */
+/* is on the parent's frame */
+static pcb_t* halted_pcb;
+
+/*
+ * user_range
+ * checks a buffer the kernel reads or writes for a user program lies
+ * wholly in the program's own 4MB page, so it can't reach kernel memory
+ * return 1 if it does, 0 if not
+ */
+static int32_t user_range(const void* ptr, uint32_t size){
+	uint32_t start = (uint32_t) ptr;
+
+	if (start < (PRO_IDX << 22) || size > FOUR_MB || start > ((PRO_IDX + 1) << 22) - size) {
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * user_string
+ * checks a string the kernel reads for a user program starts in the
+ * program's own 4MB page and ends before the page does
+ * return 1 if it does, 0 if not
+ */
+static int32_t user_string(const uint8_t* str){
+	const uint8_t* end = (const uint8_t*) ((PRO_IDX + 1) << 22);
+
+	if (!user_range(str, 1)) {
+		return 0;
+	}
+	while (str < end && *str != '\0') {
+		str++;
+	}
+	return str < end;
+}
 
 // System Call 1 - Halt
 extern int32_t sys_halt_c(uint8_t status){
@@ -14,137 +50,220 @@ extern int32_t sys_halt_c(uint8_t status){
 	process_number--;
 
 	pd_entry_bigPage_t* program_page;
+	pcb_t* parent_pcb;
 	if (NULL == (program_page = get_bigPage(PRO_IDX))) {
 		return -1;
 	}
 
 	/* clear fd */
-	uint32_t fd;
-	for (fd = 0; fd < 8; fd++) {
-		if ((cur_pcb->file_array)[fd].flags % 2 != 0) {
-			((cur_pcb->file_array)[fd].file_op_ptr->close_ptr)(fd);
+	int32_t fd;
+	for (fd = 0; fd < MAX_FDS; fd++) {
+		vfs_close(fd);
+	}
+	/* drop the mmap window and restore parent data and parent paging */
+	parent_pcb = (pcb_t*) cur_pcb->old_pcb_ptr;
+	mmap_release(cur_pcb);
+	sched_release_task(cur_pcb);
+	/* nothing waits for a background program, so the next task runs instead; a terminal's */
+	/* shell is started again first. The pcb and kernel stack go last, once this is on the */
+	/* parent's frame and done reading the pcb; the stack is still in use, but freeing it */
+	/* doesn't write it and nothing allocates before the return */
+	if (cur_pcb->sched_flags & SCHED_DETACHED) {
+		if (cur_pcb->sched_flags & SCHED_RESPAWN) {
+			spawn_program(cur_pcb->input, cur_pcb->sched_flags, cur_pcb->terminal);
 		}
+		sched_exit();
 	}
-	/* restore parent data and parent paging */
+	mmap_load(parent_pcb);
 	tss.esp0 = cur_pcb->old_esp0;
 	program_page->page_base_addr = cur_pcb->old_phys_addr;
 	lpdt(ret_dir_ptr());
+	halted_pcb = cur_pcb;
+	cur_pcb = parent_pcb;
 	asm("					\n\
 		movl	%0, %%ebp 	\n\
 		"
 		:
-		: "r"(cur_pcb->old_ebp)
+		: "r"(halted_pcb->old_ebp)
 	);
- 	cur_pcb = (pcb_t*) cur_pcb->old_pcb_ptr;
+	sched_free_task(halted_pcb);
 
 	return 0xFF & status;
 };
 
-// System Call 2 - Execute
-extern int32_t sys_execute_c(const uint8_t* command){
+/*
+ * start_program
+ * loads a program into a new process and sets up its pcb. A program started with
+ * SCHED_DETACHED gets a kernel stack that runs it the first time the scheduler switches
+ * to it, and is queued; any other is left for the caller to run, with its user page mapped
+ * inputs: command: program name and arguments; len: bytes of it to use
+ *         flags: its sched_flags; terminal: the terminal of its stdin and stdout
+ *         eip: set to the entry point of the program
+ * return the pcb, or NULL if the program can't be run or there is no memory for it
+ */
+static pcb_t* start_program(const uint8_t* command, uint32_t len, uint32_t flags, uint32_t terminal, uint32_t* eip){
 	uint8_t file_name[33];
 	uint32_t idx;
 	dentry_t dentry;
 	uint8_t header[32];
 	pd_entry_bigPage_t* program_page;
-
-	if (process_number >= 6) {
-		return -1;
-	}
+	pcb_t* pcb;
 
 	/*better fix for newline issue, doesn't read newline into the file_name to be searched for*/
-	for (idx = 0; idx < 33; idx++) {
+	for (idx = 0; idx < 32 && idx < len; idx++) {
 		if (command[idx] == ' ' || command[idx] == 0 || command[idx] == '\n') {
-	 		break;
-	 	}
+			break;
+		}
 		file_name[idx] = command[idx];
 	}
 	file_name[idx] = 0;
 
 	/* read file and check that it is a regular file */
 	if (read_dentry_by_name(file_name, &dentry) == -1) {
-		return -1;
+		return NULL;
 	}
 	if (dentry.filetype != REG_FILE) {
-		return -1;
+		return NULL;
 	}
 	/* read header of file, containing ELF (if executable, bytes 0-3) and EIP (bytes 24-27) */
-	if (read_data(dentry.inode_num, 0, header, 32, -1) == -1) {
-		return -1;
+	if (read_data(dentry.inode_num, 0, header, 32) == -1) {
+		return NULL;
 	}
 	if (strncmp((int8_t*) elf_text, (int8_t*) header, 4) != 0) {
-		return -1;
+		return NULL;
 	}
 
-	/* create new pcb */
-	pcb_t new_pcb;
-	strcpy((int8_t*) new_pcb.input, (int8_t*) command);
-
 	/** PAGING **/
 	/* assert page is present before modifying */
 	if (NULL == (program_page = get_bigPage(PRO_IDX))) {
-		asm("					\n\
-			movl	$-1, %%ebx 	\n\
-			"
-			:
-			:
-		);
-		return -1;
+		return NULL;
+	}
+	/* take a process id, kernel stack, mmap table and user page; the pcb comes zeroed */
+	if ((pcb = sched_new_task()) == NULL) {
+		return NULL;
 	}
+	/* keep the command for getargs */
+	if (len >= sizeof(pcb->input)) {
+		len = sizeof(pcb->input) - 1;
+	}
+	strncpy((int8_t*) pcb->input, (int8_t*) command, len);
+	pcb->input[len] = 0;
 	/* save old physical address in pcb */
-	new_pcb.old_phys_addr = program_page->page_base_addr;
+	pcb->old_phys_addr = program_page->page_base_addr;
 	/* update physical address */
-	uint32_t p_addr = ((EIGHT_MB + process_number*FOUR_MB) & EIGHT_MASK) >> EIGHT_S;
-	program_page->page_base_addr = p_addr;
+	program_page->page_base_addr = pcb->user_page;
 	/* flush TLB */
 	lpdt(ret_dir_ptr());
 	/* copy program to physical memory */
 	uint32_t v_addr = USER_PROG;
 	uint8_t *v_ptr = (uint8_t*) v_addr;
-	read_data(dentry.inode_num, 0, v_ptr, FOUR_MB, -1);
+	read_data(dentry.inode_num, 0, v_ptr, FOUR_MB);
+	/* a background program's page is only mapped while it runs */
+	if (flags & SCHED_DETACHED) {
+		program_page->page_base_addr = pcb->old_phys_addr;
+		lpdt(ret_dir_ptr());
+	}
 
 	/** PCB **/
 	uint32_t fd_idx;
 	/* file array entry for stdin (fd = 0) */
-	new_pcb.file_array[0].file_op_ptr = &terminal_table;
-	new_pcb.file_array[0].inode = 0;
-	new_pcb.file_array[0].file_pos = 0;
-	new_pcb.file_array[0].flags = TERMINAL_FILE_FLAGS;
+	pcb->file_array[0].file_op_ptr = vfs_type_ops(TERMINAL_FILE);
+	pcb->file_array[0].inode = 0;
+	pcb->file_array[0].file_pos = 0;
+	pcb->file_array[0].flags = TERMINAL_FILE_FLAGS;
 	/* file array entry for stdout (fd = 1) */
-	new_pcb.file_array[1].file_op_ptr = &terminal_table;
-	new_pcb.file_array[1].inode = 0;
-	new_pcb.file_array[1].file_pos = 0;
-	new_pcb.file_array[1].flags = TERMINAL_FILE_FLAGS;
+	pcb->file_array[1].file_op_ptr = vfs_type_ops(TERMINAL_FILE);
+	pcb->file_array[1].inode = 0;
+	pcb->file_array[1].file_pos = 0;
+	pcb->file_array[1].flags = TERMINAL_FILE_FLAGS;
 	/* open stdin/out */
-	terminal_open((uint8_t*) "temp");
+	keyboard_environment();
 	/* clear file array entries [2-8) */
-	for (fd_idx = 2; fd_idx < 8; fd_idx++) {
-		new_pcb.file_array[fd_idx] = clear_fd;
+	for (fd_idx = FD_FIRST; fd_idx < MAX_FDS; fd_idx++) {
+		pcb->file_array[fd_idx] = clear_fd;
 	}
-	/* store cur_pcb ptr */
-	new_pcb.old_pcb_ptr = (struct pcb_t*) cur_pcb;
-	new_pcb.old_esp0 = tss.esp0;
+	/* store cur_pcb ptr; a background program has no parent waiting for it */
+	pcb->old_pcb_ptr = (flags & SCHED_DETACHED) ? NULL : (struct pcb_t*) cur_pcb;
+	pcb->old_esp0 = tss.esp0;
+	pcb->sched_flags = flags;
+	pcb->terminal = terminal;
 
+	/* finally increment process number */
+	process_number++;
 
-	/* update pcb ptr to new pcb */
-	uint32_t* pcb_addr = (uint32_t*) (EIGHT_MB - process_number*EIGHT_KB - EIGHT_KB);
-	*((pcb_t*) pcb_addr) = new_pcb;
+	*eip = header[24] + (header[25] << 8) + (header[26] << 16) + (header[27] << 24);
+
+	/* build a stack its first switch_stack returns from into task_entry, which irets to */
+	/* the program, and queue it */
+	if (flags & SCHED_DETACHED) {
+		uint32_t* frame = (uint32_t*) pcb->kernel_esp0;
+		*--frame = USER_DS;
+		*--frame = v_addr | (FOUR_MB - 4);
+		*--frame = USER_EFLAGS;
+		*--frame = USER_CS;
+		*--frame = *eip;
+		*--frame = (uint32_t) task_entry;
+		for (idx = 0; idx < SWITCH_SAVED_REGS; idx++) {
+			*--frame = 0;
+		}
+		pcb->sched_esp = (uint32_t) frame;
+		sched_enqueue(pcb);
+	}
+	return pcb;
+}
 
-	cur_pcb = (pcb_t*) pcb_addr;
+/*
+ * spawn_program
+ * starts a program in the background, on any terminal
+ * inputs: command: program name and arguments; flags: sched_flags besides SCHED_DETACHED
+ *         terminal: the terminal of its stdin and stdout
+ * return 0, or -1 if the program can't be run or every slot is in use
+ */
+int32_t spawn_program(const uint8_t* command, uint32_t flags, uint32_t terminal){
+	uint32_t eip;
 
-	/* finally increment process number */
-	process_number++;
+	if (start_program(command, strlen((int8_t*) command), flags | SCHED_DETACHED, terminal, &eip) == NULL) {
+		return -1;
+	}
+	return 0;
+}
 
+// System Call 2 - Execute
+extern int32_t sys_execute_c(const uint8_t* command){
+	uint32_t len;
+	uint32_t background = 0;
+	uint32_t terminal;
+	pcb_t* pcb;
+
+	/* a trailing '&' runs the program in the background, next to the caller */
+	for (len = strlen((int8_t*) command); len > 0 && command[len - 1] == ' '; len--);
+	if (len > 0 && command[len - 1] == '&') {
+		background = 1;
+		for (len--; len > 0 && command[len - 1] == ' '; len--);
+	}
+	/* the kernel starts the first terminal's shell */
+	terminal = (cur_pcb == NULL) ? 0 : cur_pcb->terminal;
 
+	uint32_t eip;
+	if ((pcb = start_program(command, len, background ? SCHED_DETACHED : 0, terminal, &eip)) == NULL) {
+		return -1;
+	}
+	/* the caller carries on */
+	if (background) {
+		return EXEC_BACKGROUND;
+	}
 
+	/* update pcb ptr to new pcb */
+	cur_pcb = pcb;
+	terminal_map_video(cur_pcb);
+	mmap_load(cur_pcb);
 
 	/* must save ebp */
 	/* prepare for context_switch */
 	uint32_t cs = USER_CS;
 	uint32_t ds = ((cs & 0x3) == 0) ? KERNEL_DS:USER_DS;
-	uint32_t eip = header[24] + (header[25] << 8) + (header[26] << 16) + (header[27] << 24);
-	uint32_t esp = v_addr | (FOUR_MB - 4);
-	tss.esp0 = EIGHT_MB - process_number*EIGHT_KB;
+	uint32_t esp = USER_PROG | (FOUR_MB - 4);
+	tss.esp0 = cur_pcb->kernel_esp0;
 	register uint32_t ebp asm("ebp");
 	cur_pcb->old_ebp = ebp;
 	//cur_pcb->old_ebp = asm("ebp");
@@ -171,10 +290,9 @@ extern int32_t sys_execute_c(const uint8_t* command){
  * return the number of bytes read
  */
 extern int32_t sys_read_c(int32_t fd, void* buf, int32_t nbytes){
+	file_desc_t* desc;
+
 	/* Check validity of inputs */
-	if (fd < 0 || fd > FD_SIZE) {
-		return -1;
-	}
 	if (buf == NULL) {
 		return -1;
 	}
@@ -183,12 +301,12 @@ extern int32_t sys_read_c(int32_t fd, void* buf, int32_t nbytes){
 	}
 
 	// Assert the fd is open
-	if ((cur_pcb->file_array)[fd].flags % 2 == 0) {
+	if ((desc = vfs_get_fd(fd)) == NULL) {
 		return - 1;
 	}
 
 	/* call the correct read function with File Operations Jump Table */
-	return ((cur_pcb->file_array)[fd].file_op_ptr->read_ptr)(fd, buf, nbytes);
+	return (desc->file_op_ptr->read_ptr)(fd, buf, nbytes);
 };
 
 // System Call 4 - write
@@ -198,10 +316,9 @@ extern int32_t sys_read_c(int32_t fd, void* buf, int32_t nbytes){
  * return the number of bytes written
  */
 extern int32_t sys_write_c(int32_t fd, const void* buf, int32_t nbytes){
+	file_desc_t* desc;
+
 	/* Check validity of inputs */
-	if (fd < 0 || fd > FD_SIZE) {
-		return -1;
-	}
 	if (buf == NULL) {
 		return -1;
 	}
@@ -210,78 +327,38 @@ extern int32_t sys_write_c(int32_t fd, const void* buf, int32_t nbytes){
 	}
 
 	// Assert the fd is open
-	if ((cur_pcb->file_array)[fd].flags % 2 == 0) {
+	if ((desc = vfs_get_fd(fd)) == NULL) {
 		return - 1;
 	}
 
 	/* call the correct write function with File Operations Jump Table */
-	return ((cur_pcb->file_array)[fd].file_op_ptr->write_ptr)(fd, buf, nbytes);
+	return (desc->file_op_ptr->write_ptr)(fd, buf, nbytes);
 };
 
 // System Call 5 - open
+/*
+ * sys_open_c
+ * opens a file, directory or device through the filesystem mounted at its path
+ * return the file array index the file was opened in
+ */
 extern int32_t sys_open_c(const uint8_t* filename){
-	dentry_t dentry;
-	uint32_t i;
-
 	/* check validity of args */
 	if (filename == NULL) {
 		return -1;
 	}
 
-	/* assert dentry exists */
-	if (read_dentry_by_name(filename, &dentry) == -1) {
-		return -1;
-	}
-
-	/* find next unused file_desc in file array */
-	for(i = 2; i < 8; i++) {
-		// Check each entry in the file array for an unused entry
-		if ((cur_pcb->file_array)[i].flags % 2 == 0){
-			break;
-		}
-	}
-	/* assert there was an fd found in the file array */
-	if (i >= 8) {
-		return -1;
-	}
-
-	/* set up correct function table */
-	switch (dentry.filetype) {
-		case RTC_FILE:
-			(cur_pcb->file_array)[i].file_op_ptr = &rtc_table;
-			break;
-		case DIR_FILE:
-			(cur_pcb->file_array)[i].file_op_ptr = &dir_table;
-			break;
-		case REG_FILE:
-			(cur_pcb->file_array)[i].file_op_ptr = &file_table;
-			break;
-		default:
-			(cur_pcb->file_array)[i].file_op_ptr = &terminal_table;
-			break;
-	}
-
-	/* Call the correct open function with File Operations Jump Table */
-	((cur_pcb->file_array)[i].file_op_ptr->open_ptr)(filename);
-
-	/* return the file array index the file was opened in */
-	return i;
+	return vfs_open(filename);
 };
 
 // System Call 6 - Close
 extern int32_t sys_close_c(int32_t fd){
-	/* assert fd is valid */
-	if (fd < 2 || fd > FD_SIZE) {
-		return -1;
-	}
-
-	// Assert the fd is open
-	if ((cur_pcb->file_array)[fd].flags % 2 == 0) {
+	/* stdin and stdout stay open */
+	if (fd < FD_FIRST) {
 		return -1;
 	}
 
 	// Call the correct close function with File Operations Jump Table
-	return ((cur_pcb->file_array)[fd].file_op_ptr->close_ptr)(fd);
+	return vfs_close(fd);
 };
 
 // System Call 7 - Get Args
@@ -290,6 +367,10 @@ extern int32_t sys_getargs_c(uint8_t* buf, int32_t nbytes){
 	uint32_t in_idx = 0;
 	uint32_t idx;
 	while ((cur_pcb->input)[in_idx] != ' ') {
+		/* no arguments after the program name */
+		if ((cur_pcb->input)[in_idx] == 0) {
+			return -1;
+		}
 		in_idx++;
 	}
 
@@ -336,3 +417,198 @@ extern int32_t sys_set_handler_c(int32_t signum, void* handler_address){
 extern int32_t sys_sigreturn_c(void){
 	return -1;
 };
+
+// System Call 11 - mmap
+/*
+ * sys_mmap_c
+ * maps an open regular file read-only into the process, straight from the
+ * filesystem image; writes go to private copies of the pages touched
+ * return the length of the file, with *start set to its first byte
+ */
+extern int32_t sys_mmap_c(int32_t fd, uint8_t** start){
+	file_desc_t* desc;
+
+	/* the kernel writes *start, so all of it has to be in the program's own 4MB page */
+	if (!user_range(start, sizeof(uint8_t*))) {
+		return -1;
+	}
+
+	// Assert the fd is open and can be mapped
+	if ((desc = vfs_get_fd(fd)) == NULL || desc->file_op_ptr->mmap_ptr == NULL) {
+		return -1;
+	}
+
+	return (desc->file_op_ptr->mmap_ptr)(fd, start);
+};
+
+// System Call 12 - create
+/*
+ * sys_create_c
+ * adds an empty regular file to the filesystem
+ * return 0 on success
+ */
+extern int32_t sys_create_c(const uint8_t* filename){
+	/* check validity of args */
+	if (!user_string(filename)) {
+		return -1;
+	}
+
+	return vfs_create(filename);
+};
+
+// System Call 13 - unlink
+/*
+ * sys_unlink_c
+ * removes a regular file that no process has open
+ * return 0 on success
+ */
+extern int32_t sys_unlink_c(const uint8_t* filename){
+	/* check validity of args */
+	if (!user_string(filename)) {
+		return -1;
+	}
+
+	return vfs_unlink(filename);
+};
+
+// System Call 14 - truncate
+/*
+ * sys_truncate_c
+ * shortens an open regular file, pulling its file position back if needed
+ * return 0 on success
+ */
+extern int32_t sys_truncate_c(int32_t fd, uint32_t length){
+	file_desc_t* desc;
+
+	// Assert the fd is open and can be truncated
+	if ((desc = vfs_get_fd(fd)) == NULL || desc->file_op_ptr->truncate_ptr == NULL) {
+		return -1;
+	}
+
+	return (desc->file_op_ptr->truncate_ptr)(fd, length);
+};
+
+// System Call 15 - getdents
+/*
+ * sys_getdents_c
+ * reads as many fixed-size entry records from an open directory as fit in buf
+ * return the number of bytes read, 0 at the end of the directory
+ */
+extern int32_t sys_getdents_c(int32_t fd, void* buf, int32_t nbytes){
+	file_desc_t* desc;
+
+	/* Check validity of inputs */
+	if (nbytes < 0 || !user_range(buf, nbytes)) {
+		return -1;
+	}
+
+	// Assert the fd is an open directory
+	if ((desc = vfs_get_fd(fd)) == NULL || desc->file_op_ptr->getdents_ptr == NULL) {
+		return -1;
+	}
+
+	return (desc->file_op_ptr->getdents_ptr)(fd, buf, nbytes);
+};
+
+// System Call 16 - lseek
+/*
+ * sys_lseek_c
+ * moves the position of an open regular file (in bytes) or directory (in entries)
+ * return the new position
+ */
+extern int32_t sys_lseek_c(int32_t fd, int32_t offset, int32_t whence){
+	file_desc_t* desc;
+
+	/* only files and directories have a position to move */
+	if ((desc = vfs_get_fd(fd)) == NULL || desc->file_op_ptr->lseek_ptr == NULL) {
+		return -1;
+	}
+
+	return (desc->file_op_ptr->lseek_ptr)(fd, offset, whence);
+};
+
+// System Call 17 - pread
+/*
+ * sys_pread_c
+ * reads an open regular file at an offset without moving its file position
+ * return the number of bytes read
+ */
+extern int32_t sys_pread_c(int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+	file_desc_t* desc;
+
+	/* Check validity of inputs */
+	if (nbytes < 0) {
+		return -1;
+	}
+	if (!user_range(buf, nbytes)) {
+		return -1;
+	}
+
+	// Assert the fd is open and can be read at an offset
+	if ((desc = vfs_get_fd(fd)) == NULL || desc->file_op_ptr->pread_ptr == NULL) {
+		return -1;
+	}
+
+	return (desc->file_op_ptr->pread_ptr)(fd, buf, nbytes, offset);
+};
+
+// System Call 18 - stat
+/*
+ * sys_stat_c
+ * reports the type, inode, size and block count of a file by name
+ * return 0 on success
+ */
+extern int32_t sys_stat_c(const uint8_t* filename, stat_t* buf){
+	/* check validity of args */
+	if (!user_string(filename) || !user_range(buf, sizeof(stat_t))) {
+		return -1;
+	}
+
+	return vfs_stat(filename, buf);
+};
+
+// System Call 19 - fstat
+/*
+ * sys_fstat_c
+ * reports the type, inode, size and block count of an open file;
+ * devices, stdin and stdout report only their type
+ * return 0 on success
+ */
+extern int32_t sys_fstat_c(int32_t fd, stat_t* buf){
+	file_desc_t* desc;
+
+	/* Check validity of inputs */
+	if (!user_range(buf, sizeof(stat_t))) {
+		return -1;
+	}
+
+	// Assert the fd is open
+	if ((desc = vfs_get_fd(fd)) == NULL) {
+		return -1;
+	}
+
+	if (desc->file_op_ptr->fstat_ptr != NULL) {
+		return (desc->file_op_ptr->fstat_ptr)(fd, buf);
+	}
+	buf->type = (desc->flags & TYPE_MASK) >> TYPE_SHIFT;
+	buf->inode = 0;
+	buf->size = 0;
+	buf->blocks = 0;
+	return 0;
+};
+
+// System Call 20 - sendfile
+/*
+ * sys_sendfile_c
+ * copies up to count bytes from the position of in_fd to out_fd without a user buffer,
+ * moving in_fd's position
+ * return the number of bytes sent, 0 at the end of in_fd
+ */
+extern int32_t sys_sendfile_c(int32_t out_fd, int32_t in_fd, int32_t count){
+	/* Check validity of inputs */
+	if (count < 0) {
+		return -1;
+	}
+
+	return vfs_sendfile(out_fd, in_fd, count);
+};
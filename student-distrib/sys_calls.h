@@ -3,9 +3,10 @@
 
 #define ELF         0x7F
 #define PRO_IDX     32
-#define EIGHT_MASK  0xFFC00000
-#define EIGHT_S     22
 #define USER_PROG   0x8048000
+#define USER_EFLAGS 0x00000202  /* interrupts on, for programs started by task_entry   */
+#define EXEC_BACKGROUND 512     /* execute started the program in the background; exec_done in exceptions.S returns 0 */
+#define SWITCH_SAVED_REGS 4     /* registers switch_stack pushes: ebp, ebx, esi, edi  */
 
 #include "x86_desc.h"
 #include "rtc_driver.h"
@@ -13,6 +14,10 @@
 #include "key_driver.h"
 #include "paging_c.h"
 #include "paging.h"
+#include "mmap.h"
+#include "vfs.h"
+#include "sched.h"
+#include "context.h"
 #include "types.h"
 #include "lib.h"
 
@@ -22,11 +27,6 @@ file_desc_t clear_fd;
 uint32_t process_number = 0;
 int8_t elf_text[4] = {ELF, 'E', 'L', 'F'};
 
-fd_ops_t rtc_table = {&rtc_open, &rtc_close, &rtc_read, &rtc_write};
-fd_ops_t dir_table = {&dir_open, &dir_close, &dir_read, &dir_write};
-fd_ops_t file_table = {&file_open, &file_close, &file_read, &file_write};
-fd_ops_t terminal_table = {&terminal_open, &terminal_close, &terminal_read, &terminal_write};
-
 
 // System Call 1 - Halt
 extern int32_t sys_halt_c(uint8_t status);
@@ -48,6 +48,26 @@ extern int32_t sys_vidmap_c(uint8_t** screen_start);
 extern int32_t sys_set_handler_c(int32_t signum, void* handler_address);
 // System Call 10 - sigreturn
 extern int32_t sys_sigreturn_c(void);
+// System Call 11 - mmap
+extern int32_t sys_mmap_c(int32_t fd, uint8_t** start);
+// System Call 12 - create
+extern int32_t sys_create_c(const uint8_t* filename);
+// System Call 13 - unlink
+extern int32_t sys_unlink_c(const uint8_t* filename);
+// System Call 14 - truncate
+extern int32_t sys_truncate_c(int32_t fd, uint32_t length);
+// System Call 15 - getdents
+extern int32_t sys_getdents_c(int32_t fd, void* buf, int32_t nbytes);
+// System Call 16 - lseek
+extern int32_t sys_lseek_c(int32_t fd, int32_t offset, int32_t whence);
+// System Call 17 - pread
+extern int32_t sys_pread_c(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+// System Call 18 - stat
+extern int32_t sys_stat_c(const uint8_t* filename, stat_t* buf);
+// System Call 19 - fstat
+extern int32_t sys_fstat_c(int32_t fd, stat_t* buf);
+// System Call 20 - sendfile
+extern int32_t sys_sendfile_c(int32_t out_fd, int32_t in_fd, int32_t count);
 
 
 #endif
@@ -7,6 +7,16 @@
 #include "filesys.h"
 #include "rtc_driver.h"
 #include "key_driver.h"
+#include "vfs.h"
+#include "tmpfs.h"
+#include "procfs.h"
+#include "ata.h"
+#include "virtio_blk.h"
+#include "pit.h"
+#include "sched.h"
+#include "palloc.h"
+#include "slab.h"
+#include "mmap.h"
 #include "types.h"
 
 #define PASS 1
@@ -275,7 +285,7 @@ void rtc_test_driver(){
 	printf("Testing RTC\n");
 	// Initialize RTC
 	uint8_t in_test[] = "rtc";
-	rtc_open(in_test);
+	rtc_open(2, in_test);
 	printf("After RTC OPEN, F = 2Hz\n");
 	unsigned int count = 30;
 	unsigned char rate = 1;
@@ -341,13 +351,14 @@ void dir_open_test() {
 	uint8_t filename[33];
 	file_desc_t* file_desc;
 
-	file_desc = get_file_desc();
+	/* the descriptor the tests open directories in */
+	file_desc = &(cur_pcb->file_array)[2];
 	printf("init file descriptor flags: 0x%x\n\n", file_desc->flags);
 
 	str_length = strlen(".");
 	temp = strncpy((int8_t*) filename, ".", str_length);
 	filename[str_length] = 0;
-	if (dir_open(filename) == 0) {
+	if (dir_open(2, filename) == 0) {
 		printf("opening directory %s: PASS; ", filename);
 		printf("file descriptor flags: 0x%x\n", file_desc->flags);
 		if (dir_close(2) == 0) {
@@ -367,7 +378,7 @@ void dir_open_test() {
 	str_length = strlen("sigtest");
 	temp = strncpy((int8_t*) filename, "sigtest", str_length);
 	filename[str_length] = 0;
-	if (dir_open(filename) != 0) {
+	if (dir_open(2, filename) != 0) {
 		printf("opening directory %s: PASS; ", filename);
 	}
 	else {
@@ -378,7 +389,7 @@ void dir_open_test() {
 	str_length = strlen("rtc");
 	temp = strncpy((int8_t*) filename, "rtc", str_length);
 	filename[str_length] = 0;
-	if (dir_open(filename) != 0) {
+	if (dir_open(2, filename) != 0) {
 		printf("opening directory %s: PASS; ", filename);
 	}
 	else {
@@ -389,7 +400,7 @@ void dir_open_test() {
 	str_length = strlen("verylargetextwithverylongname.tx");
 	temp = strncpy((int8_t*) filename, "verylargetextwithverylongname.tx", str_length);
 	filename[str_length] = 0;
-	if (dir_open(filename) != 0) {
+	if (dir_open(2, filename) != 0) {
 		printf("opening directory large.txt: PASS; ");
 	}
 	else {
@@ -404,15 +415,12 @@ void dir_read_test() {
 	uint8_t filename[33];
 	uint8_t buffer[33];
 	uint32_t padding;
-
-	dentry_t* read_dentry;
-
-	read_dentry = get_read_dentry();
+	dentry_t dentry;
 
 	str_length = strlen(".");
 	temp = strncpy((int8_t*) filename, ".", str_length);
 	filename[str_length] = 0;
-	if (dir_open((uint8_t*) filename) != 0) {
+	if (dir_open(2, (uint8_t*) filename) != 0) {
 		printf("dir read test: FAIL; couldn't open directory: %s\n", filename);
 		return;
 	}
@@ -428,7 +436,11 @@ void dir_read_test() {
 			printf(" ");
 			padding--;
 		}
-		printf(", file_type: %d, file_size: %d\n", read_dentry->filetype, get_file_size(read_dentry));
+		if (read_dentry_by_name(buffer, &dentry) != 0) {
+			printf(", not found\n");
+			continue;
+		}
+		printf(", file_type: %d, file_size: %d\n", dentry.filetype, get_file_size(&dentry));
 	}
 
 	if (dir_close(2) != 0) {
@@ -478,7 +490,7 @@ void file_open_test() {
 	str_length = strlen(".");
 	temp = strncpy((int8_t*) filename, ".", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("file open test: FAIL; opened a directory file %s\n", filename);
 		return;
 	}
@@ -490,7 +502,7 @@ void file_open_test() {
 	str_length = strlen("sigtest");
 	temp = strncpy((int8_t*) filename, "sigtest", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -503,7 +515,7 @@ void file_open_test() {
 	str_length = strlen("shell");
 	temp = strncpy((int8_t*) filename, "shell", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -516,7 +528,7 @@ void file_open_test() {
 	str_length = strlen("grep");
 	temp = strncpy((int8_t*) filename, "grep", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -529,7 +541,7 @@ void file_open_test() {
 	str_length = strlen("syserr");
 	temp = strncpy((int8_t*) filename, "syserr", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -542,7 +554,7 @@ void file_open_test() {
 	str_length = strlen("rtc");
 	temp = strncpy((int8_t*) filename, "rtc", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opened an rtc file %s: FAIL\n", filename);
 	}
 	else {
@@ -552,7 +564,7 @@ void file_open_test() {
 	str_length = strlen("fish");
 	temp = strncpy((int8_t*) filename, "fish", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -565,7 +577,7 @@ void file_open_test() {
 	str_length = strlen("counter");
 	temp = strncpy((int8_t*) filename, "counter", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -578,7 +590,7 @@ void file_open_test() {
 	str_length = strlen("pingpong");
 	temp = strncpy((int8_t*) filename, "pingpong", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -591,7 +603,7 @@ void file_open_test() {
 	str_length = strlen("cat");
 	temp = strncpy((int8_t*) filename, "cat", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -604,7 +616,7 @@ void file_open_test() {
 	str_length = strlen("frame0.txt");
 	temp = strncpy((int8_t*) filename, "frame0.txt", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -617,7 +629,7 @@ void file_open_test() {
 	str_length = strlen("verylargetextwithverylongname.tx");
 	temp = strncpy((int8_t*) filename, "verylargetextwithverylongname.tx", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file large.txt: PASS\n");
 	}
 	else {
@@ -630,7 +642,7 @@ void file_open_test() {
 	str_length = strlen("ls");
 	temp = strncpy((int8_t*) filename, "ls", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -643,7 +655,7 @@ void file_open_test() {
 	str_length = strlen("testprint");
 	temp = strncpy((int8_t*) filename, "testprint", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -656,7 +668,7 @@ void file_open_test() {
 	str_length = strlen("created.txt");
 	temp = strncpy((int8_t*) filename, "created.txt", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -669,7 +681,7 @@ void file_open_test() {
 	str_length = strlen("frame1.txt");
 	temp = strncpy((int8_t*) filename, "frame1.txt", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -682,7 +694,7 @@ void file_open_test() {
 	str_length = strlen("hello");
 	temp = strncpy((int8_t*) filename, "hello", str_length);
 	filename[str_length] = 0;
-	if (file_open(filename) == 0) {
+	if (file_open(2, filename) == 0) {
 		printf("opening regular file %s: PASS\n", filename);
 	}
 	else {
@@ -705,7 +717,7 @@ void file_read_test() {
 	temp = strncpy((int8_t*) filename, "hello", str_length);
 	filename[str_length] = 0;
 
-	if (file_open(filename) != 0) {
+	if (file_open(2, filename) != 0) {
 		printf("file read test: FAIL; failed opening %s\n", (uint8_t*) filename);
 		return;
 	}
@@ -731,42 +743,1581 @@ void file_write_test() {
 	}
 }
 
-void terminal_tests(){
-    terminal_open(0);
-	char input[129];
-	while(1){
-	terminal_read(0, input, 128);
-	terminal_write(0, input, 128);
+/* Dentry Lookup Test
+ *
+ * Looks up every name in the loaded image through the name index, checks each result
+ * against read_dentry_by_index, and times hits and misses with the TSC
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints average cycles per lookup
+ * Side Effects: None
+ * Coverage: read_dentry_by_name, read_dentry_by_index, name index built in init_filesys
+ * Files: filesys.c/h
+ */
+#define LOOKUP_ITERS	64
+int dentry_lookup_test() {
+	TEST_HEADER;
+
+	uint8_t* missing[] = {(uint8_t*) "nonexistent", (uint8_t*) "shel", (uint8_t*) "shellx",
+						  (uint8_t*) "verylargetextwithverylongname.txt", (uint8_t*) ""};
+	uint8_t name[NAME_LEN + 1];
+	dentry_t by_idx;
+	dentry_t by_name;
+	uint32_t idx, it, n_names, n_missing;
+	uint32_t start, hit_cycles, miss_cycles;
+	int result = PASS;
+
+	n_missing = sizeof(missing) / sizeof(missing[0]);
+	hit_cycles = 0;
+	miss_cycles = 0;
+
+	/* every directory entry must be found, and must match the same entry read by index */
+	for (idx = 0; read_dentry_by_index(idx, &by_idx) == 0; idx++) {
+		strncpy((int8_t*) name, (int8_t*) by_idx.filename, NAME_LEN);
+		name[NAME_LEN] = 0;
+
+		start = rdtsc();
+		for (it = 0; it < LOOKUP_ITERS; it++) {
+			if (read_dentry_by_name(name, &by_name) != 0) {
+				result = FAIL;
+			}
+		}
+		hit_cycles += rdtsc() - start;
+
+		if (strncmp((int8_t*) by_name.filename, (int8_t*) by_idx.filename, NAME_LEN) != 0 ||
+			by_name.filetype != by_idx.filetype || by_name.inode_num != by_idx.inode_num) {
+			printf("lookup of %s returned the wrong dentry\n", name);
+			result = FAIL;
+		}
+	}
+	n_names = idx;
+
+	/* names that aren't in the directory must miss */
+	for (idx = 0; idx < n_missing; idx++) {
+		start = rdtsc();
+		for (it = 0; it < LOOKUP_ITERS; it++) {
+			if (read_dentry_by_name(missing[idx], &by_name) != -1) {
+				result = FAIL;
+			}
+		}
+		miss_cycles += rdtsc() - start;
+	}
+
+	if (n_names == 0) {
+		result = FAIL;
+	}
+	else {
+		printf("%d names: %d cycles/hit, %d cycles/miss\n", n_names,
+			   hit_cycles / (n_names * LOOKUP_ITERS), miss_cycles / (n_missing * LOOKUP_ITERS));
 	}
+
+	return result;
 }
 
-/* Checkpoint 3 tests */
-/* Checkpoint 4 tests */
-/* Checkpoint 5 tests */
+/* Read Data Benchmark
+ *
+ * Reads every regular file in the image in one call and again in odd-sized chunks that
+ * straddle data block boundaries, checks both agree, and reports cycles per byte
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints cycles per byte for whole-file reads
+ * Side Effects: None
+ * Coverage: read_data, get_data_run
+ * Files: filesys.c/h
+ */
+#define BENCH_BUF_SIZE	(FOUR_KB*16)
+#define BENCH_CHUNK		1000
+int read_data_bench_test() {
+	TEST_HEADER;
 
+	static uint8_t whole[BENCH_BUF_SIZE + 1];
+	static uint8_t chunked[BENCH_BUF_SIZE + 1];
+	dentry_t dentry;
+	uint32_t idx, offset, bytes, cycles, start;
+	int32_t size, ret_val;
+	int result = PASS;
 
-/* Test suite entry point */
-void launch_tests(){
- 	// TEST_OUTPUT("idt_test", idt_test());
-	// launch your tests here
-	// TEST_OUTPUT("idt_test", idt_test());
-	// TEST_OUTPUT("rtc test", rtc_test());
-	//TEST_OUTPUT("keyboard test", keyboard_test());
-	//TEST_OUTPUT("Exception Test", exception_test());
+	bytes = 0;
+	cycles = 0;
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		size = get_file_size(&dentry);
+		if (dentry.filetype != REG_FILE || size > BENCH_BUF_SIZE) {
+			continue;
+		}
 
-	//paging_dereferencing_test();
-	//paging_test();
+		start = rdtsc();
+		ret_val = read_data(dentry.inode_num, 0, whole, BENCH_BUF_SIZE);
+		cycles += rdtsc() - start;
+		if (ret_val != size) {
+			result = FAIL;
+			continue;
+		}
+		bytes += size;
 
-	clear();
-//	rtc_test_driver();
-//	terminal_tests();
-//	dir_close_test();
-//	dir_open_test();
-	dir_read_test();
-//	dir_write_test();
-//	file_close_test();
-//	file_open_test();
-//	file_read_test();
-// 	file_write_test();
+		for (offset = 0; (ret_val = read_data(dentry.inode_num, offset, chunked + offset, BENCH_CHUNK)) > 0; offset += ret_val);
+		if (offset != size || memcmp(whole, chunked, size) != 0) {
+			printf("chunked read of %s doesn't match\n", dentry.filename);
+			result = FAIL;
+		}
+	}
+
+	if (bytes == 0) {
+		result = FAIL;
+	}
+	else {
+		printf("%d bytes: %d.%d cycles/byte\n", bytes, cycles / bytes, ((cycles % bytes) * 100) / bytes);
+	}
+
+	return result;
+}
+
+/* Filesystem Write Test
+ *
+ * Creates a file, grows it with writes that straddle data block boundaries, overwrites part
+ * of it, and reads it back before and after flushing the block cache; then truncates,
+ * appends, and unlinks it, checking the directory ends up as it started
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints cache counters
+ * Side Effects: Creates and removes "write_test.txt" in the loaded image
+ * Coverage: create_file, write_data, truncate_data, unlink_file, sync_filesys, block cache
+ * Files: filesys.c/h, block_cache.c/h
+ */
+#define WRITE_TEST_SIZE		(FOUR_KB*10 + 123)
+#define WRITE_TEST_CHUNK	3001
+int filesys_write_test() {
+	TEST_HEADER;
+
+	static uint8_t ref[WRITE_TEST_SIZE];
+	static uint8_t buf[WRITE_TEST_SIZE + 1];
+	uint8_t* fname = (uint8_t*) "write_test.txt";
+	dentry_t dentry;
+	cache_stats_t stats;
+	uint32_t idx, offset, chunk, n_entries;
+	int result = PASS;
+
+	for (n_entries = 0; read_dentry_by_index(n_entries, &dentry) == 0; n_entries++);
+
+	if (create_file(fname) != 0 || create_file(fname) != -1 || read_dentry_by_name(fname, &dentry) != 0) {
+		return FAIL;
+	}
+
+	for (idx = 0; idx < WRITE_TEST_SIZE; idx++) {
+		ref[idx] = (uint8_t) (idx * 7 + idx / 300);
+	}
+	for (offset = 0; offset < WRITE_TEST_SIZE; offset += chunk) {
+		chunk = (WRITE_TEST_SIZE - offset < WRITE_TEST_CHUNK) ? WRITE_TEST_SIZE - offset : WRITE_TEST_CHUNK;
+		if (write_data(dentry.inode_num, offset, ref + offset, chunk) != chunk) {
+			result = FAIL;
+		}
+	}
+	memset(ref + 5000, 'Z', 9000);
+	if (write_data(dentry.inode_num, 5000, ref + 5000, 9000) != 9000) {
+		result = FAIL;
+	}
+
+	/* unflushed writes must be visible, and still be there once they reach the image */
+	if (read_data(dentry.inode_num, 0, buf, WRITE_TEST_SIZE + 1) != WRITE_TEST_SIZE || memcmp(buf, ref, WRITE_TEST_SIZE) != 0) {
+		result = FAIL;
+	}
+	if (sync_filesys() != 0 || cache_dirty_count() != 0) {
+		result = FAIL;
+	}
+	if (read_data(dentry.inode_num, 0, buf, WRITE_TEST_SIZE + 1) != WRITE_TEST_SIZE || memcmp(buf, ref, WRITE_TEST_SIZE) != 0) {
+		result = FAIL;
+	}
+
+	/* files can't have holes or be truncated longer */
+	if (write_data(dentry.inode_num, WRITE_TEST_SIZE + 1, ref, 1) != -1 || truncate_data(dentry.inode_num, WRITE_TEST_SIZE + 1) != -1) {
+		result = FAIL;
+	}
+
+	if (truncate_data(dentry.inode_num, FOUR_KB + 1) != 0 ||
+		write_data(dentry.inode_num, FOUR_KB + 1, ref + FOUR_KB + 1, FOUR_KB*3) != FOUR_KB*3 ||
+		read_data(dentry.inode_num, 0, buf, WRITE_TEST_SIZE + 1) != FOUR_KB*4 + 1 ||
+		memcmp(buf, ref, FOUR_KB*4 + 1) != 0) {
+		result = FAIL;
+	}
+
+	if (unlink_file(fname) != 0 || read_dentry_by_name(fname, &dentry) != -1) {
+		result = FAIL;
+	}
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++);
+	if (idx != n_entries) {
+		result = FAIL;
+	}
+
+	cache_get_stats(&stats);
+	printf("cache: %d hits, %d misses, %d writebacks in %d flushes\n", stats.hits, stats.misses, stats.writebacks, stats.flushes);
+
+	return result;
+}
+
+/* Directory Chain Test
+ *
+ * Creates files until the directory spills out of the boot block into chained directory
+ * blocks, checks each one by name and by index, then unlinks them and checks the directory
+ * shrinks back to where it started
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Creates and removes files named "chain<n>" in the loaded image
+ * Coverage: create_file, unlink_file, read_dentry_by_name, read_dentry_by_index, dir chain
+ * Files: filesys.c/h
+ */
+#define CHAIN_TEST_EXTRA	5
+int dir_chain_test() {
+	TEST_HEADER;
+
+	uint8_t name[NAME_LEN + 1];
+	dentry_t by_idx;
+	dentry_t by_name;
+	uint32_t idx, n_entries, n_made;
+	int result = PASS;
+
+	for (n_entries = 0; read_dentry_by_index(n_entries, &by_idx) == 0; n_entries++);
+
+	/* fill past the boot block */
+	for (n_made = 0; n_entries + n_made < MAX_DENTRIES + CHAIN_TEST_EXTRA; n_made++) {
+		strcpy((int8_t*) name, "chain");
+		itoa(n_made, (int8_t*) name + 5, 10);
+		if (create_file(name) != 0) {
+			printf("couldn't create %s\n", name);
+			result = FAIL;
+			break;
+		}
+	}
+
+	for (idx = 0; read_dentry_by_index(idx, &by_idx) == 0; idx++) {
+		strncpy((int8_t*) name, (int8_t*) by_idx.filename, NAME_LEN);
+		name[NAME_LEN] = 0;
+		if (read_dentry_by_name(name, &by_name) != 0 || by_name.inode_num != by_idx.inode_num) {
+			result = FAIL;
+		}
+	}
+	if (idx != n_entries + n_made) {
+		result = FAIL;
+	}
+
+	for (idx = 0; idx < n_made; idx++) {
+		strcpy((int8_t*) name, "chain");
+		itoa(idx, (int8_t*) name + 5, 10);
+		if (unlink_file(name) != 0) {
+			result = FAIL;
+		}
+	}
+	for (idx = 0; read_dentry_by_index(idx, &by_idx) == 0; idx++);
+	if (idx != n_entries) {
+		result = FAIL;
+	}
+
+	return result;
+}
+
+/* Getdents Test
+ *
+ * Lists "." with dir_getdents a few records at a time and checks every record against
+ * read_dentry_by_index and get_file_size, and that a buffer too small for one record fails
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints the number of calls the listing took
+ * Side Effects: Opens and closes "." on fd 2
+ * Coverage: dir_getdents
+ * Files: filesys.c/h
+ */
+#define GETDENTS_BATCH	5
+int dir_getdents_test() {
+	TEST_HEADER;
+
+	dirent_t ents[GETDENTS_BATCH];
+	dentry_t dentry;
+	int32_t cnt, rec;
+	uint32_t idx, calls;
+	int result = PASS;
+
+	if (dir_open(2, (uint8_t*) ".") != 0) {
+		return FAIL;
+	}
+
+	if (dir_getdents(2, ents, sizeof(dirent_t) - 1) != -1) {
+		result = FAIL;
+	}
+
+	idx = 0;
+	for (calls = 1; (cnt = dir_getdents(2, ents, sizeof(ents))) > 0; calls++) {
+		for (rec = 0; rec < cnt / (int32_t) sizeof(dirent_t); rec++, idx++) {
+			if (read_dentry_by_index(idx, &dentry) != 0 ||
+				strncmp((int8_t*) ents[rec].name, (int8_t*) dentry.filename, NAME_LEN) != 0 ||
+				ents[rec].type != dentry.filetype || ents[rec].inode != dentry.inode_num ||
+				ents[rec].size != get_file_size(&dentry)) {
+				result = FAIL;
+			}
+		}
+	}
+	if (cnt != 0 || read_dentry_by_index(idx, &dentry) == 0) {
+		result = FAIL;
+	}
+	printf("%d entries in %d calls\n", idx, calls);
+
+	if (dir_close(2) != 0) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Seek Test
+ *
+ * Opens the largest regular file, checks file_pread at offsets spread over the file and
+ * file_lseek with each whence against a whole-file read_data, and compares the time of a
+ * pread at the start of the file with one at the end
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints cycles for a pread at the first and last block
+ * Side Effects: Opens and closes a file on fd 2
+ * Coverage: file_pread, file_lseek, file_read
+ * Files: filesys.c/h
+ */
+#define SEEK_TEST_BUF	(FOUR_KB*16)
+#define SEEK_TEST_READ	100
+int file_seek_test() {
+	TEST_HEADER;
+
+	static uint8_t whole[SEEK_TEST_BUF];
+	uint8_t buf[SEEK_TEST_READ];
+	uint8_t name[NAME_LEN + 1];
+	dentry_t dentry;
+	dentry_t largest;
+	uint32_t idx, offset, start, first_cycles, last_cycles;
+	int32_t size, ret_val;
+	int result = PASS;
+
+	/* find the largest regular file that fits in the buffer */
+	size = -1;
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		if (dentry.filetype == REG_FILE && get_file_size(&dentry) > size && get_file_size(&dentry) <= SEEK_TEST_BUF) {
+			size = get_file_size(&dentry);
+			largest = dentry;
+		}
+	}
+	if (size <= SEEK_TEST_READ) {
+		return FAIL;
+	}
+	strncpy((int8_t*) name, (int8_t*) largest.filename, NAME_LEN);
+	name[NAME_LEN] = 0;
+	if (read_data(largest.inode_num, 0, whole, SEEK_TEST_BUF) != size || file_open(2, name) != 0) {
+		return FAIL;
+	}
+
+	/* pread anywhere, without moving the file position */
+	for (offset = 0; offset < size; offset += size / 7 + 1) {
+		ret_val = file_pread(2, buf, SEEK_TEST_READ, offset);
+		if (ret_val != ((size - offset < SEEK_TEST_READ) ? size - offset : SEEK_TEST_READ) || memcmp(buf, whole + offset, ret_val) != 0) {
+			result = FAIL;
+		}
+	}
+	if (file_pread(2, buf, SEEK_TEST_READ, size) != 0 || (cur_pcb->file_array)[2].file_pos != 0) {
+		result = FAIL;
+	}
+
+	/* lseek each way, then read from there */
+	if (file_lseek(2, size / 2, SEEK_SET) != size / 2 || file_lseek(2, 10, SEEK_CUR) != size / 2 + 10 ||
+		file_read(2, buf, SEEK_TEST_READ) != SEEK_TEST_READ || memcmp(buf, whole + size / 2 + 10, SEEK_TEST_READ) != 0) {
+		result = FAIL;
+	}
+	if (file_lseek(2, -SEEK_TEST_READ, SEEK_END) != size - SEEK_TEST_READ ||
+		file_read(2, buf, SEEK_TEST_READ) != SEEK_TEST_READ || memcmp(buf, whole + size - SEEK_TEST_READ, SEEK_TEST_READ) != 0) {
+		result = FAIL;
+	}
+	if (file_lseek(2, 1, SEEK_END) != -1 || file_lseek(2, -1, SEEK_SET) != -1 || file_lseek(2, 0, 3) != -1) {
+		result = FAIL;
+	}
+
+	start = rdtsc();
+	file_pread(2, buf, SEEK_TEST_READ, 0);
+	first_cycles = rdtsc() - start;
+	start = rdtsc();
+	file_pread(2, buf, SEEK_TEST_READ, size - SEEK_TEST_READ);
+	last_cycles = rdtsc() - start;
+	printf("%s: pread at byte 0 %d cycles, at byte %d %d cycles\n", name, first_cycles, size - SEEK_TEST_READ, last_cycles);
+
+	if (file_close(2) != 0) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Stat Test
+ *
+ * Checks stat_file for every entry in the directory against the dentry and the number of
+ * bytes read_data returns, and that missing names and bad inodes fail
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: stat_file, stat_inode
+ * Files: filesys.c/h
+ */
+int stat_test() {
+	TEST_HEADER;
+
+	static uint8_t buf[FOUR_KB*16];
+	uint8_t name[NAME_LEN + 1];
+	dentry_t dentry;
+	stat_t st;
+	uint32_t idx;
+	int result = PASS;
+
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		strncpy((int8_t*) name, (int8_t*) dentry.filename, NAME_LEN);
+		name[NAME_LEN] = 0;
+		if (stat_file(name, &st) != 0 || st.type != dentry.filetype || st.inode != dentry.inode_num ||
+			st.size != get_file_size(&dentry) || (st.blocks != (st.size + FOUR_KB - 1) / FOUR_KB &&
+			!(st.blocks == 0 && st.size <= FS_INLINE_MAX))) {
+			printf("stat of %s doesn't match\n", name);
+			result = FAIL;
+		}
+		if (dentry.filetype == REG_FILE && st.size <= sizeof(buf) &&
+			read_data(dentry.inode_num, 0, buf, sizeof(buf)) != st.size) {
+			result = FAIL;
+		}
+	}
+
+	if (stat_file((uint8_t*) "nonexistent", &st) != -1 || stat_file((uint8_t*) ".", NULL) != -1 ||
+		stat_inode(REG_FILE, 0xFFFFFFFF, &st) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Compressed Read Test
+ *
+ * Unpacks a hand-packed block (one literal, then a long overlapping match), checks that
+ * corrupt packed data is refused, and on a compressed image reads every file twice, comparing
+ * the reads and printing the block cache counters
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: lz_decompress_block, compressed read_data, cache_get_stats
+ * Files: lz.c/h, filesys.c/h, block_cache.c/h
+ */
+#define LZ_PACKED_TEST_LEN	32
+int compressed_read_test() {
+	TEST_HEADER;
+
+	static uint8_t packed[LZ_PACKED_TEST_LEN];
+	static uint8_t block[LZ_BLOCK_SIZE];
+	static uint8_t first[FOUR_KB*4];
+	static uint8_t second[FOUR_KB*4];
+	cache_stats_t before, after;
+	dentry_t dentry;
+	uint32_t idx, len;
+	int32_t size;
+	int result = PASS;
+
+	/* 'x', then a match at offset 1 filling the rest of the block */
+	len = LZ_BLOCK_SIZE - 1 - LZ_MIN_MATCH - LZ_NIBBLE_MAX;
+	packed[0] = (1 << 4) | LZ_NIBBLE_MAX;
+	packed[1] = 'x';
+	packed[2] = 1;
+	packed[3] = 0;
+	for (idx = 4; len >= 255; len -= 255) {
+		packed[idx++] = 255;
+	}
+	packed[idx++] = len;
+	if (lz_decompress_block(packed, idx, block) != 0) {
+		result = FAIL;
+	}
+	for (len = 0; len < LZ_BLOCK_SIZE; len++) {
+		if (block[len] != 'x') {
+			result = FAIL;
+			break;
+		}
+	}
+	/* truncated, and a match reaching before the block */
+	if (lz_decompress_block(packed, idx - 1, block) != -1) {
+		result = FAIL;
+	}
+	packed[2] = 2;
+	if (lz_decompress_block(packed, idx, block) != -1) {
+		result = FAIL;
+	}
+
+	if ((get_fs_flags() & FS_COMPRESSED) == 0) {
+		printf("image is not compressed, skipping reads\n");
+		return result;
+	}
+
+	cache_get_stats(&before);
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		size = get_file_size(&dentry);
+		if (dentry.filetype != REG_FILE || size > sizeof(first)) {
+			continue;
+		}
+		if (read_data(dentry.inode_num, 0, first, sizeof(first)) != size ||
+			read_data(dentry.inode_num, 0, second, sizeof(second)) != size ||
+			memcmp(first, second, size) != 0) {
+			result = FAIL;
+		}
+	}
+	cache_get_stats(&after);
+	printf("block cache: %d hits, %d misses, %d evictions\n", after.hits - before.hits,
+		after.misses - before.misses, after.evictions - before.evictions);
+	if (after.hits == before.hits) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Shared Data Test
+ *
+ * Looks for two files with the same contents (which mkfsimg -d stores in the same blocks),
+ * changes a byte of one and checks the other still reads as before; then grows a file small
+ * enough to be stored inline past one block and truncates it back, checking its data survives
+ * the move out of the inode. Both files are restored
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Rewrites and restores files in the loaded image
+ * Coverage: write_data and truncate_data on shared blocks and inline files, stat_inode
+ * Files: filesys.c/h
+ */
+#define SHARED_TEST_MAX		(FOUR_KB*4)
+int shared_data_test() {
+	TEST_HEADER;
+
+	static uint8_t first[SHARED_TEST_MAX];
+	static uint8_t second[SHARED_TEST_MAX];
+	static uint8_t buf[SHARED_TEST_MAX + FOUR_KB];
+	dentry_t dentry, other;
+	stat_t st;
+	uint32_t idx, jdx;
+	int32_t size;
+	uint8_t flipped;
+	int found = 0;
+	int result = PASS;
+
+	if ((get_fs_flags() & FS_WRITABLE) == 0) {
+		printf("image is read-only, skipping\n");
+		return PASS;
+	}
+
+	/* a pair of files with the same contents */
+	for (idx = 0; !found && read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		size = get_file_size(&dentry);
+		if (dentry.filetype != REG_FILE || size <= 0 || size > SHARED_TEST_MAX ||
+			read_data(dentry.inode_num, 0, first, size) != size) {
+			continue;
+		}
+		for (jdx = idx + 1; !found && read_dentry_by_index(jdx, &other) == 0; jdx++) {
+			found = other.filetype == REG_FILE && get_file_size(&other) == size &&
+				read_data(other.inode_num, 0, second, size) == size && memcmp(first, second, size) == 0;
+		}
+	}
+	if (found) {
+		flipped = ~first[0];
+		if (write_data(dentry.inode_num, 0, &flipped, 1) != 1 ||
+			read_data(dentry.inode_num, 0, buf, size) != size || buf[0] != flipped ||
+			read_data(other.inode_num, 0, buf, size) != size || memcmp(buf, second, size) != 0) {
+			result = FAIL;
+		}
+		if (write_data(dentry.inode_num, 0, first, 1) != 1) {
+			result = FAIL;
+		}
+	} else {
+		printf("no files with the same contents\n");
+	}
+
+	/* a file small enough to be inline, grown past a block and cut back */
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		size = get_file_size(&dentry);
+		if (dentry.filetype == REG_FILE && size > 0 && size <= FS_INLINE_MAX) {
+			break;
+		}
+	}
+	if (read_dentry_by_index(idx, &dentry) != 0) {
+		printf("no small files\n");
+		return result;
+	}
+	memset(buf, 'z', FOUR_KB);
+	if (read_data(dentry.inode_num, 0, first, size) != size ||
+		write_data(dentry.inode_num, size, buf, FOUR_KB) != FOUR_KB ||
+		read_data(dentry.inode_num, 0, buf, sizeof(buf)) != size + FOUR_KB ||
+		memcmp(buf, first, size) != 0 || buf[size + FOUR_KB - 1] != 'z' ||
+		truncate_data(dentry.inode_num, size) != 0 ||
+		read_data(dentry.inode_num, 0, buf, sizeof(buf)) != size || memcmp(buf, first, size) != 0 ||
+		stat_inode(REG_FILE, dentry.inode_num, &st) != 0 || st.size != size || st.blocks != 1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Interleaved Read Test
+ *
+ * Lists the directory through two descriptors at once, one entry from each in turn, with a
+ * name lookup and a file read between them; each listing must match the directory, since
+ * nothing in the read path is kept between calls outside the caller's descriptor
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: dir_open, dir_read, read_dentry_by_name, read_data
+ * Files: filesys.c/h
+ */
+int interleaved_read_test() {
+	TEST_HEADER;
+
+	uint8_t name[2][NAME_LEN + 1];
+	uint8_t buf[FOUR_KB];
+	dentry_t dentry, lookup;
+	uint32_t idx;
+	int32_t fd, ret;
+	int result = PASS;
+
+	if (dir_open(2, (uint8_t*) ".") != 0 || dir_open(3, (uint8_t*) ".") != 0) {
+		return FAIL;
+	}
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		for (fd = 2; fd <= 3; fd++) {
+			memset(name[fd - 2], 0, NAME_LEN + 1);
+			if ((ret = dir_read(fd, name[fd - 2], NAME_LEN)) <= 0 ||
+				strncmp((int8_t*) name[fd - 2], (int8_t*) dentry.filename, NAME_LEN) != 0) {
+				result = FAIL;
+			}
+			/* an unrelated lookup and read in between */
+			if (read_dentry_by_name((uint8_t*) "frame0.txt", &lookup) == 0) {
+				read_data(lookup.inode_num, 0, buf, sizeof(buf));
+			}
+		}
+	}
+	if (dir_read(2, name[0], NAME_LEN) != 0 || dir_read(3, name[1], NAME_LEN) != 0) {
+		result = FAIL;
+	}
+	dir_close(2);
+	dir_close(3);
+	return result;
+}
+
+/* VFS Test
+ *
+ * Opens the directory, a regular file and the RTC through the mount table, checking each gets
+ * the lowest free descriptor and the operations of its type, that a missing name and a full
+ * file array are refused, and that closing frees the descriptor for the next open
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Opens and closes descriptors 2-7 of the current pcb
+ * Coverage: vfs_open, vfs_close, vfs_get_fd, vfs_stat, image_fs lookup
+ * Files: vfs.c/h, filesys.c/h
+ */
+int vfs_test() {
+	TEST_HEADER;
+
+	dentry_t dentry;
+	stat_t st;
+	file_desc_t* desc;
+	int32_t fd, dir_fd, file_fd;
+	uint32_t idx;
+	int result = PASS;
+
+	/* any regular file with a NUL-terminated name */
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		if (dentry.filetype == REG_FILE && dentry.filename[NAME_LEN - 1] == 0) {
+			break;
+		}
+	}
+	if (dentry.filetype != REG_FILE || dentry.filename[NAME_LEN - 1] != 0) {
+		return FAIL;
+	}
+
+	dir_fd = vfs_open((uint8_t*) ".");
+	file_fd = vfs_open(dentry.filename);
+	if (dir_fd != FD_FIRST || file_fd != FD_FIRST + 1 || vfs_open((uint8_t*) "nonexistent") != -1) {
+		result = FAIL;
+	}
+	if ((desc = vfs_get_fd(file_fd)) == NULL || desc->inode != dentry.inode_num ||
+		desc->file_op_ptr->read_ptr != &file_read || vfs_get_fd(dir_fd)->file_op_ptr->getdents_ptr != &dir_getdents) {
+		result = FAIL;
+	}
+	if (vfs_stat(dentry.filename, &st) != 0 || st.inode != dentry.inode_num) {
+		result = FAIL;
+	}
+
+	/* fill the file array */
+	for (fd = file_fd + 1; fd < MAX_FDS; fd++) {
+		if (vfs_open((uint8_t*) "rtc") != fd) {
+			result = FAIL;
+		}
+	}
+	if (vfs_open((uint8_t*) ".") != -1) {
+		result = FAIL;
+	}
+
+	if (vfs_close(dir_fd) != 0 || vfs_get_fd(dir_fd) != NULL || vfs_close(dir_fd) != -1 ||
+		vfs_open((uint8_t*) ".") != dir_fd) {
+		result = FAIL;
+	}
+	for (fd = FD_FIRST; fd < MAX_FDS; fd++) {
+		vfs_close(fd);
+	}
+	return result;
+}
+
+/* Tmpfs Test
+ *
+ * Creates a file under the tmpfs mount point, writes a pattern across several pages, and checks
+ * it reads back the same, that lseek, pread and fstat agree with it, that truncating and
+ * unlinking give the pages back to the pool, and that an open file can't be unlinked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Opens and closes descriptor 2 of the current pcb; creates and removes tmp/scratch
+ * Coverage: tmpfs_create, tmpfs_unlink, tmpfs_open, tmpfs_read, tmpfs_write, tmpfs_lseek,
+ *           tmpfs_pread, tmpfs_truncate, tmpfs_fstat, tmpfs_dir_read
+ * Files: tmpfs.c/h, vfs.c/h
+ */
+#define TMPFS_TEST_LEN	(3*FOUR_KB + 100)
+int tmpfs_test() {
+	TEST_HEADER;
+
+	static uint8_t out[TMPFS_TEST_LEN];
+	static uint8_t in[TMPFS_TEST_LEN];
+	uint8_t name[NAME_LEN + 1];
+	file_desc_t* desc;
+	stat_t st;
+	uint32_t free_pages = tmpfs_free_pages();
+	uint32_t idx;
+	int32_t fd;
+	int32_t cnt;
+	int result = PASS;
+
+	for (idx = 0; idx < TMPFS_TEST_LEN; idx++) {
+		out[idx] = idx * 7 + (idx >> 12);
+	}
+
+	if (vfs_create((uint8_t*) "tmp/scratch") != 0 || vfs_create((uint8_t*) "tmp/scratch") != -1 ||
+		(fd = vfs_open((uint8_t*) "tmp/scratch")) < 0) {
+		return FAIL;
+	}
+	desc = vfs_get_fd(fd);
+
+	if (desc->file_op_ptr->write_ptr(fd, out, TMPFS_TEST_LEN) != TMPFS_TEST_LEN ||
+		tmpfs_free_pages() != free_pages - 4) {
+		result = FAIL;
+	}
+	if (desc->file_op_ptr->lseek_ptr(fd, 0, SEEK_SET) != 0 ||
+		desc->file_op_ptr->read_ptr(fd, in, TMPFS_TEST_LEN + 1) != TMPFS_TEST_LEN ||
+		memcmp(in, out, TMPFS_TEST_LEN) != 0 || desc->file_op_ptr->read_ptr(fd, in, 1) != 0) {
+		result = FAIL;
+	}
+	if (desc->file_op_ptr->pread_ptr(fd, in, 200, FOUR_KB - 100) != 200 ||
+		memcmp(in, out + FOUR_KB - 100, 200) != 0) {
+		result = FAIL;
+	}
+
+	/* can't unlink it while it is open */
+	if (vfs_unlink((uint8_t*) "tmp/scratch") != -1) {
+		result = FAIL;
+	}
+
+	if (desc->file_op_ptr->truncate_ptr(fd, 100) != 0 || tmpfs_free_pages() != free_pages - 1 ||
+		desc->file_op_ptr->fstat_ptr(fd, &st) != 0 || st.size != 100 || st.blocks != 1 ||
+		desc->file_pos != 100) {
+		result = FAIL;
+	}
+
+	/* the directory lists it */
+	vfs_close(fd);
+	if ((fd = vfs_open((uint8_t*) "tmp")) < 0) {
+		result = FAIL;
+	} else {
+		cnt = vfs_get_fd(fd)->file_op_ptr->read_ptr(fd, name, NAME_LEN);
+		if (cnt != 7 || strncmp((int8_t*) name, "scratch", 7) != 0) {
+			result = FAIL;
+		}
+		vfs_close(fd);
+	}
+
+	if (vfs_unlink((uint8_t*) "tmp/scratch") != 0 || tmpfs_free_pages() != free_pages ||
+		vfs_stat((uint8_t*) "tmp/scratch", &st) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Procfs Test
+ *
+ * Reads proc/procs a few bytes at a time and checks the text matches process_number, that stat
+ * reports its length, that the files can't be written, created or removed, and that the
+ * directory lists the files
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Opens and closes descriptor 2 of the current pcb
+ * Coverage: procfs_stat, procfs_open, procfs_read, procfs_write, procfs_lseek, procfs_dir_read
+ * Files: procfs.c/h, vfs.c/h
+ */
+int procfs_test() {
+	TEST_HEADER;
+
+	uint8_t expect[64];
+	uint8_t got[64];
+	int8_t digits[11];
+	file_desc_t* desc;
+	stat_t st;
+	uint32_t len = 0;
+	int32_t fd;
+	int32_t cnt;
+	int result = PASS;
+
+	/* what proc/procs should say */
+	strcpy((int8_t*) expect, "running: ");
+	strcpy((int8_t*) expect + strlen((int8_t*) expect), itoa(process_number, digits, 10));
+	strcpy((int8_t*) expect + strlen((int8_t*) expect), "\nmax: ");
+	strcpy((int8_t*) expect + strlen((int8_t*) expect), itoa(sched_max_tasks(), digits, 10));
+	strcpy((int8_t*) expect + strlen((int8_t*) expect), "\n");
+
+	if ((fd = vfs_open((uint8_t*) "proc/procs")) < 0) {
+		return FAIL;
+	}
+	desc = vfs_get_fd(fd);
+	while (len < sizeof(got) - 5 && (cnt = desc->file_op_ptr->read_ptr(fd, got + len, 5)) > 0) {
+		len += cnt;
+	}
+	if (cnt != 0 || len != strlen((int8_t*) expect) || memcmp(got, expect, len) != 0) {
+		result = FAIL;
+	}
+	if (vfs_stat((uint8_t*) "proc/procs", &st) != 0 || st.size != len ||
+		desc->file_op_ptr->lseek_ptr(fd, -4, SEEK_END) != len - 4 ||
+		desc->file_op_ptr->read_ptr(fd, got, sizeof(got)) != 4 || memcmp(got, expect + len - 4, 4) != 0) {
+		result = FAIL;
+	}
+	if (desc->file_op_ptr->write_ptr(fd, expect, 1) != -1 || vfs_create((uint8_t*) "proc/new") != -1 ||
+		vfs_unlink((uint8_t*) "proc/procs") != -1) {
+		result = FAIL;
+	}
+	vfs_close(fd);
+
+	if ((fd = vfs_open((uint8_t*) "proc")) < 0) {
+		return FAIL;
+	}
+	cnt = vfs_get_fd(fd)->file_op_ptr->read_ptr(fd, got, NAME_LEN);
+	if (cnt != 8 || strncmp((int8_t*) got, "syscalls", 8) != 0) {
+		result = FAIL;
+	}
+	vfs_close(fd);
+	return result;
+}
+
+/* ATA Test
+ *
+ * Reads the first blocks of the disk one at a time with PIO, then all at once with
+ * ata_read_blocks (DMA if the controller has it) and checks both agree; also checks blocks
+ * past the end of the disk are refused. Passes without checking anything if there is no disk
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Reads the disk; leaves DMA as it found it
+ * Coverage: ata_read_block, ata_read_blocks, ata_set_dma, ata_block_count
+ * Files: ata.c/h
+ */
+#define ATA_TEST_BLOCKS 4
+int ata_test() {
+	TEST_HEADER;
+
+	static uint8_t single[ATA_TEST_BLOCKS][CACHE_BLOCK_SIZE] __attribute__((aligned(CACHE_BLOCK_SIZE)));
+	static uint8_t batch[ATA_TEST_BLOCKS][CACHE_BLOCK_SIZE] __attribute__((aligned(CACHE_BLOCK_SIZE)));
+	uint8_t* bufs[ATA_TEST_BLOCKS];
+	int32_t dma;
+	uint32_t it;
+	int result = PASS;
+
+	if (ata_block_count() < ATA_TEST_BLOCKS) {
+		return PASS;
+	}
+
+	dma = ata_set_dma(0);
+	for (it = 0; it < ATA_TEST_BLOCKS; it++) {
+		if (ata_read_block(it, single[it]) != 0) {
+			result = FAIL;
+		}
+		bufs[it] = batch[it];
+	}
+	ata_set_dma(dma);
+
+	if (ata_read_blocks(0, ATA_TEST_BLOCKS, bufs) != 0 || memcmp(single, batch, sizeof(single)) != 0) {
+		result = FAIL;
+	}
+	if (ata_read_block(ata_block_count(), single[0]) != -1 ||
+		ata_read_blocks(ata_block_count() - 1, 2, bufs) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Virtio Block Test
+ *
+ * Reads the first blocks of the virtio disk one request per doorbell, then all of them in
+ * one batch, and in reverse order through virtio_blk_submit, and checks all three agree; also
+ * checks blocks past the end are refused. Prints cycles per block for single and batched
+ * reads, and for the same reads from the IDE disk if there is one, to compare the two paths.
+ * Passes without checking anything if there is no virtio disk
+ * Inputs: None
+ * Outputs: PASS/FAIL; prints cycles per block
+ * Side Effects: Reads the disks
+ * Coverage: virtio_blk_read_block, virtio_blk_read_blocks, virtio_blk_submit,
+ *           virtio_blk_handler, ata_read_block, ata_read_blocks
+ * Files: virtio_blk.c/h, ata.c/h, pci.c/h
+ */
+#define VIRTIO_TEST_BLOCKS 16
+int virtio_blk_test() {
+	TEST_HEADER;
+
+	static uint8_t single[VIRTIO_TEST_BLOCKS][CACHE_BLOCK_SIZE] __attribute__((aligned(CACHE_BLOCK_SIZE)));
+	static uint8_t batch[VIRTIO_TEST_BLOCKS][CACHE_BLOCK_SIZE] __attribute__((aligned(CACHE_BLOCK_SIZE)));
+	uint8_t* bufs[VIRTIO_TEST_BLOCKS];
+	uint32_t blocks[VIRTIO_TEST_BLOCKS];
+	uint32_t start, single_cycles, batch_cycles;
+	uint32_t it;
+	int result = PASS;
+
+	if (virtio_blk_block_count() < VIRTIO_TEST_BLOCKS) {
+		return PASS;
+	}
+
+	start = rdtsc();
+	for (it = 0; it < VIRTIO_TEST_BLOCKS; it++) {
+		if (virtio_blk_read_block(it, single[it]) != 0) {
+			result = FAIL;
+		}
+		bufs[it] = batch[it];
+	}
+	single_cycles = rdtsc() - start;
+
+	start = rdtsc();
+	if (virtio_blk_read_blocks(0, VIRTIO_TEST_BLOCKS, bufs) != 0 || memcmp(single, batch, sizeof(single)) != 0) {
+		result = FAIL;
+	}
+	batch_cycles = rdtsc() - start;
+	printf("virtio: %d cycles/block single, %d batched\n", single_cycles / VIRTIO_TEST_BLOCKS,
+		   batch_cycles / VIRTIO_TEST_BLOCKS);
+
+	/* any blocks in any order, still one request each */
+	memset(batch, 0, sizeof(batch));
+	for (it = 0; it < VIRTIO_TEST_BLOCKS; it++) {
+		blocks[it] = VIRTIO_TEST_BLOCKS - 1 - it;
+		bufs[it] = batch[VIRTIO_TEST_BLOCKS - 1 - it];
+	}
+	if (virtio_blk_submit(blocks, bufs, VIRTIO_TEST_BLOCKS, 0) != 0 || memcmp(single, batch, sizeof(single)) != 0) {
+		result = FAIL;
+	}
+
+	blocks[0] = virtio_blk_block_count();
+	if (virtio_blk_read_block(blocks[0], single[0]) != -1 || virtio_blk_submit(blocks, bufs, 2, 0) != -1) {
+		result = FAIL;
+	}
+
+	/* the same reads from the IDE disk, for comparison */
+	if (ata_block_count() >= VIRTIO_TEST_BLOCKS) {
+		start = rdtsc();
+		for (it = 0; it < VIRTIO_TEST_BLOCKS; it++) {
+			ata_read_block(it, single[it]);
+			bufs[it] = batch[it];
+		}
+		single_cycles = rdtsc() - start;
+		start = rdtsc();
+		ata_read_blocks(0, VIRTIO_TEST_BLOCKS, bufs);
+		batch_cycles = rdtsc() - start;
+		printf("ata: %d cycles/block single, %d batched\n", single_cycles / VIRTIO_TEST_BLOCKS,
+			   batch_cycles / VIRTIO_TEST_BLOCKS);
+	}
+	return result;
+}
+
+/* Sendfile Test
+ *
+ * Sends the largest regular file of the image to a tmpfs file in two calls, then sends that
+ * tmpfs file to a second one (tmpfs can't send itself, so the kernel buffer is used) and
+ * checks both copies against read_data, and that the end of the file and a bad descriptor
+ * behave
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Opens and closes three descriptors; creates and removes tmp/sent, tmp/copy
+ * Coverage: vfs_sendfile, file_sendfile
+ * Files: vfs.c/h, filesys.c/h, tmpfs.c/h
+ */
+#define SENDFILE_TEST_BUF	(FOUR_KB*16)
+#define SENDFILE_TEST_HEAD	100
+int sendfile_test() {
+	TEST_HEADER;
+
+	static uint8_t whole[SENDFILE_TEST_BUF];
+	static uint8_t copy[SENDFILE_TEST_BUF];
+	uint8_t name[NAME_LEN + 1];
+	dentry_t dentry;
+	dentry_t largest;
+	file_desc_t* desc;
+	int32_t in_fd, out_fd, copy_fd;
+	int32_t size;
+	uint32_t idx;
+	int result = PASS;
+
+	size = -1;
+	for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+		if (dentry.filetype == REG_FILE && get_file_size(&dentry) > size && get_file_size(&dentry) <= SENDFILE_TEST_BUF) {
+			size = get_file_size(&dentry);
+			largest = dentry;
+		}
+	}
+	if (size <= SENDFILE_TEST_HEAD) {
+		return FAIL;
+	}
+	strncpy((int8_t*) name, (int8_t*) largest.filename, NAME_LEN);
+	name[NAME_LEN] = 0;
+	if (read_data(largest.inode_num, 0, whole, SENDFILE_TEST_BUF) != size ||
+		vfs_create((uint8_t*) "tmp/sent") != 0 || vfs_create((uint8_t*) "tmp/copy") != 0) {
+		return FAIL;
+	}
+	in_fd = vfs_open(name);
+	out_fd = vfs_open((uint8_t*) "tmp/sent");
+	copy_fd = vfs_open((uint8_t*) "tmp/copy");
+	if (in_fd < 0 || out_fd < 0 || copy_fd < 0) {
+		return FAIL;
+	}
+
+	/* straight from the image */
+	if (vfs_sendfile(out_fd, in_fd, SENDFILE_TEST_HEAD) != SENDFILE_TEST_HEAD ||
+		vfs_sendfile(out_fd, in_fd, 0x7FFFFFFF) != size - SENDFILE_TEST_HEAD ||
+		vfs_sendfile(out_fd, in_fd, 0x7FFFFFFF) != 0 || vfs_sendfile(MAX_FDS, in_fd, 1) != -1) {
+		result = FAIL;
+	}
+	desc = vfs_get_fd(out_fd);
+	if (desc->file_op_ptr->pread_ptr(out_fd, copy, SENDFILE_TEST_BUF, 0) != size || memcmp(copy, whole, size) != 0) {
+		result = FAIL;
+	}
+
+	/* through the kernel buffer */
+	memset(copy, 0, sizeof(copy));
+	if (desc->file_op_ptr->lseek_ptr(out_fd, 0, SEEK_SET) != 0 || vfs_sendfile(copy_fd, out_fd, size) != size ||
+		vfs_get_fd(copy_fd)->file_op_ptr->pread_ptr(copy_fd, copy, SENDFILE_TEST_BUF, 0) != size ||
+		memcmp(copy, whole, size) != 0) {
+		result = FAIL;
+	}
+
+	vfs_close(in_fd);
+	vfs_close(out_fd);
+	vfs_close(copy_fd);
+	if (vfs_unlink((uint8_t*) "tmp/sent") != 0 || vfs_unlink((uint8_t*) "tmp/copy") != 0) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Scheduler Test
+ *
+ * Waits for the timer to tick with interrupts on, checks its rate, that a yield with nothing
+ * else to run comes straight back, that slice lengths out of range are refused, and that
+ * proc/sched reports the rate
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Enables interrupts; leaves the slice length as it found it
+ * Coverage: pit_init, pit_handler, sched_yield, sched_set_slice, proc/sched
+ * Files: pit.c/h, sched.c/h, procfs.c/h
+ */
+#define SCHED_TEST_SPINS	100000000
+int sched_test() {
+	TEST_HEADER;
+
+	sched_stats_t before, after;
+	uint8_t got[16];
+	uint32_t start;
+	uint32_t spins;
+	uint32_t slice = sched_slice();
+	int32_t fd;
+	int result = PASS;
+
+	sti();
+	start = pit_ticks();
+	for (spins = 0; pit_ticks() - start < 2 && spins < SCHED_TEST_SPINS; spins++);
+	if (pit_ticks() - start < 2 || pit_hz() < PIT_HZ - 1 || pit_hz() > PIT_HZ + 1) {
+		result = FAIL;
+	}
+
+	sched_get_stats(&before);
+	if (sched_queued() == 0) {
+		sched_yield();
+		sched_get_stats(&after);
+		if (after.switches != before.switches || after.yields != before.yields) {
+			result = FAIL;
+		}
+	}
+
+	if (sched_set_slice(0) != -1 || sched_set_slice(SCHED_MAX_SLICE + 1) != -1 ||
+		sched_set_slice(slice + 1) != 0 || sched_slice() != slice + 1 || sched_set_slice(slice) != 0) {
+		result = FAIL;
+	}
+
+	if ((fd = vfs_open((uint8_t*) "proc/sched")) < 0) {
+		return FAIL;
+	}
+	if (vfs_get_fd(fd)->file_op_ptr->read_ptr(fd, got, 4) != 4 || strncmp((int8_t*) got, "hz: ", 4) != 0) {
+		result = FAIL;
+	}
+	vfs_close(fd);
+	return result;
+}
+
+/* Virtual Terminal Test
+ *
+ * Marks the screen, switches to the second terminal and back, and checks the mark is
+ * hidden and then restored, and that vidmap's page follows whether a process's terminal
+ * is shown
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Shows the first terminal at the end
+ * Coverage: terminal_switch, terminal_visible, terminal_map_video
+ * Files: key_driver.c/h
+ */
+#define TERMINAL_TEST_MARK	0x7E21
+int terminal_switch_test() {
+	TEST_HEADER;
+
+	uint16_t* screen = (uint16_t*) getvmem();
+	uint16_t saved = screen[0];
+	pt_entry_t* page;
+	pcb_t other;
+	int result = PASS;
+
+	terminal_switch(0);
+	screen[0] = TERMINAL_TEST_MARK;
+	terminal_switch(1);
+	if (terminal_visible() != 1 || screen[0] == TERMINAL_TEST_MARK) {
+		result = FAIL;
+	}
+	terminal_switch(NUM_TERMINALS);
+	if (terminal_visible() != 1) {
+		result = FAIL;
+	}
+	terminal_switch(0);
+	if (terminal_visible() != 0 || screen[0] != TERMINAL_TEST_MARK) {
+		result = FAIL;
+	}
+	screen[0] = saved;
+
+	if ((page = get_pageTable_entry(USER_VMEM, VID_ADDR >> 12)) != NULL) {
+		other.terminal = 1;
+		terminal_map_video(&other);
+		if (page->page_base_addr == VID_ADDR >> 12) {
+			result = FAIL;
+		}
+		other.terminal = 0;
+		terminal_map_video(&other);
+		if (page->page_base_addr != VID_ADDR >> 12) {
+			result = FAIL;
+		}
+		terminal_map_video(cur_pcb);
+		lpdt(ret_dir_ptr());
+	}
+	return result;
+}
+
+/* Process Allocation Test
+ *
+ * Makes three processes, frees the middle one first and checks each got its own id, pcb,
+ * kernel stack, mmap table and user page, that the stack is aligned to its size, and that
+ * freeing them in any order gives every page and frame back. One process is made and freed
+ * first, so the pcb cache's empty slab is already there when the pages are counted
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Counts four exited processes in the scheduler statistics
+ * Coverage: sched_new_task, sched_release_task, sched_free_task, sched_pcb, kpage_alloc,
+ *           user_frame_alloc, kmem_cache_alloc
+ * Files: sched.c/h, palloc.c/h
+ */
+#define ALLOC_TEST_TASKS	3
+int task_alloc_test() {
+	TEST_HEADER;
+
+	palloc_stats_t before, after;
+	pcb_t* task[ALLOC_TEST_TASKS];
+	uint32_t pid;
+	uint32_t it;
+	int result = PASS;
+
+	if ((task[0] = sched_new_task()) == NULL) {
+		return FAIL;
+	}
+	sched_release_task(task[0]);
+	sched_free_task(task[0]);
+
+	palloc_get_stats(&before);
+	for (it = 0; it < ALLOC_TEST_TASKS; it++) {
+		if ((task[it] = sched_new_task()) == NULL) {
+			return FAIL;
+		}
+		if (sched_pcb(task[it]->pid) != task[it] ||
+			(task[it]->kernel_esp0 & (KSTACK_PAGES * FOUR_KB - 1)) != 0 ||
+			task[it]->user_page < EIGHT_MB / FOUR_MB || task[it]->mmap_used != 0) {
+			result = FAIL;
+		}
+	}
+	if (task[0]->pid == task[1]->pid || task[1]->pid == task[2]->pid ||
+		task[0]->user_page == task[1]->user_page || task[1]->user_page == task[2]->user_page ||
+		task[0]->mmap_table == task[1]->mmap_table || task[0] == task[1] || task[1] == task[2]) {
+		result = FAIL;
+	}
+
+	/* the middle one goes first, as when processes halt out of order */
+	pid = task[1]->pid;
+	sched_release_task(task[1]);
+	sched_free_task(task[1]);
+	if (sched_pcb(pid) != NULL || sched_pcb(task[0]->pid) != task[0]) {
+		result = FAIL;
+	}
+	sched_release_task(task[0]);
+	sched_free_task(task[0]);
+	sched_release_task(task[2]);
+	sched_free_task(task[2]);
+
+	palloc_get_stats(&after);
+	if (after.kpages_free != before.kpages_free || after.user_frames_free != before.user_frames_free) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Frame Allocator Test
+ *
+ * Takes blocks of several orders from the kernel zone, checks each is aligned to its size,
+ * inside the zone and apart from the others, frees them out of order and checks the free
+ * lists of every order are back as they were, so the buddies were joined again
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: frame_alloc, frame_free, frame_order, palloc_get_zone, palloc_fragmentation
+ * Files: palloc.c/h
+ */
+#define FRAME_TEST_BLOCKS	4
+int frame_alloc_test() {
+	TEST_HEADER;
+
+	static const uint32_t orders[FRAME_TEST_BLOCKS] = {0, 3, 0, 1};
+	palloc_zone_t before, after;
+	uint32_t block[FRAME_TEST_BLOCKS];
+	uint32_t it;
+	uint32_t other;
+	int result = PASS;
+
+	if (frame_order(1) != 0 || frame_order(3) != 2 || frame_order(1 << PALLOC_MAX_ORDER) != PALLOC_MAX_ORDER ||
+		frame_alloc(PALLOC_MAX_ORDER + 1, ZONE_KERNEL) != 0 || frame_alloc(0, PALLOC_ZONES) != 0) {
+		result = FAIL;
+	}
+
+	palloc_get_zone(ZONE_KERNEL, &before);
+	for (it = 0; it < FRAME_TEST_BLOCKS; it++) {
+		if ((block[it] = frame_alloc(orders[it], ZONE_KERNEL)) == 0) {
+			return FAIL;
+		}
+		if ((block[it] & ((FOUR_KB << orders[it]) - 1)) != 0 || block[it] < KER_ADDR ||
+			block[it] + (FOUR_KB << orders[it]) > KPAGE_TOP) {
+			result = FAIL;
+		}
+		for (other = 0; other < it; other++) {
+			if (block[it] < block[other] + (FOUR_KB << orders[other]) &&
+				block[other] < block[it] + (FOUR_KB << orders[it])) {
+				result = FAIL;
+			}
+		}
+	}
+	if (palloc_fragmentation(ZONE_KERNEL, 0) != 0 || palloc_fragmentation(ZONE_KERNEL, PALLOC_MAX_ORDER) > 100) {
+		result = FAIL;
+	}
+
+	for (it = FRAME_TEST_BLOCKS; it > 0; it -= 2) {
+		frame_free(block[it - 2], orders[it - 2]);
+	}
+	for (it = FRAME_TEST_BLOCKS; it > 0; it -= 2) {
+		frame_free(block[it - 1], orders[it - 1]);
+	}
+	palloc_get_zone(ZONE_KERNEL, &after);
+	if (after.free_pages != before.free_pages) {
+		result = FAIL;
+	}
+	for (it = 0; it <= PALLOC_MAX_ORDER; it++) {
+		if (after.free_blocks[it] != before.free_blocks[it]) {
+			result = FAIL;
+		}
+	}
+	return result;
+}
+
+/* Slab Allocator Test
+ *
+ * Makes a cache whose constructor fills each object, takes more objects than a page holds
+ * and checks each was constructed, is aligned and doesn't overlap another, that a freed
+ * object is the next one handed out, and that kmalloc gives each size class its own block.
+ * Freeing everything must leave no object in use, and every kernel page must be either
+ * free in palloc or held by a slab, as before
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Makes the slab_test cache the first time it runs
+ * Coverage: kmem_cache_create, kmem_cache_alloc, kmem_cache_free, kmem_cache_get, kmalloc, kfree
+ * Files: slab.c/h
+ */
+#define SLAB_TEST_OBJECTS	48
+#define SLAB_TEST_SIZE		100
+#define SLAB_TEST_FILL		0x5A
+static void slab_test_ctor(void* obj) {
+	memset(obj, SLAB_TEST_FILL, SLAB_TEST_SIZE);
+}
+
+int slab_test() {
+	TEST_HEADER;
+
+	static kmem_cache_t* cache;
+	palloc_stats_t before, after;
+	kmem_cache_t* other_cache;
+	uint8_t* obj[SLAB_TEST_OBJECTS];
+	uint8_t* mem[KMALLOC_CACHES];
+	uint32_t held_before = 0;
+	uint32_t held_after = 0;
+	uint32_t it;
+	uint32_t other;
+	uint32_t byte;
+	int result = PASS;
+
+	if (cache == NULL && (cache = kmem_cache_create("slab_test", SLAB_TEST_SIZE, &slab_test_ctor)) == NULL) {
+		return FAIL;
+	}
+	if (kmem_cache_create("slab_test_big", FOUR_KB << SLAB_MAX_ORDER, NULL) != NULL ||
+		kmalloc(0) != NULL || kmalloc(KMALLOC_MAX + 1) != NULL) {
+		result = FAIL;
+	}
+
+	palloc_get_stats(&before);
+	for (it = 0; (other_cache = kmem_cache_get(it)) != NULL; it++) {
+		held_before += other_cache->slabs << other_cache->order;
+	}
+
+	for (it = 0; it < SLAB_TEST_OBJECTS; it++) {
+		if ((obj[it] = kmem_cache_alloc(cache)) == NULL) {
+			return FAIL;
+		}
+		if (((uint32_t) obj[it] & (SLAB_ALIGN - 1)) != 0) {
+			result = FAIL;
+		}
+		for (byte = 0; byte < SLAB_TEST_SIZE; byte++) {
+			if (obj[it][byte] != SLAB_TEST_FILL) {
+				result = FAIL;
+			}
+		}
+		for (other = 0; other < it; other++) {
+			if (obj[it] < obj[other] + SLAB_TEST_SIZE && obj[other] < obj[it] + SLAB_TEST_SIZE) {
+				result = FAIL;
+			}
+		}
+	}
+	if (cache->active != SLAB_TEST_OBJECTS || cache->slabs < 2) {
+		result = FAIL;
+	}
+	kmem_cache_free(cache, obj[1]);
+	if (kmem_cache_alloc(cache) != obj[1]) {
+		result = FAIL;
+	}
+	for (it = SLAB_TEST_OBJECTS; it > 0; it--) {
+		kmem_cache_free(cache, obj[it - 1]);
+	}
+	if (cache->active != 0 || cache->slabs != 1) {
+		result = FAIL;
+	}
+
+	for (it = 0; it < KMALLOC_CACHES; it++) {
+		if ((mem[it] = kmalloc(KMALLOC_MIN << it)) == NULL) {
+			return FAIL;
+		}
+		memset(mem[it], it, KMALLOC_MIN << it);
+	}
+	for (it = 0; it < KMALLOC_CACHES; it++) {
+		for (byte = 0; byte < (KMALLOC_MIN << it); byte++) {
+			if (mem[it][byte] != it) {
+				result = FAIL;
+			}
+		}
+		kfree(mem[it]);
+	}
+	kfree(NULL);
+
+	palloc_get_stats(&after);
+	for (it = 0; (other_cache = kmem_cache_get(it)) != NULL; it++) {
+		held_after += other_cache->slabs << other_cache->order;
+	}
+	if (after.kpages_free + held_after != before.kpages_free + held_before) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* Mmap Test
+ *
+ * Maps a file into the window of a new process and checks it matches read_data byte for
+ * byte. On a writable image the file is made by writing two files a block at a time in
+ * turn, so its blocks aren't consecutive and the page table has to stitch them together,
+ * and unlinking it while mapped must fail. Then writes a byte through the mapping from
+ * the kernel, which with CR0.WP faults like a user write: the byte must land in a private
+ * copy of the page, with read_data still giving the image's byte and the frame going back
+ * to the pool on release. On a compressed or disk image, checks mapping is refused
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Counts an exited process in the scheduler statistics
+ * Coverage: mmap_file, mmap_page_fault, mmap_release, mmap_usage, inode pinning in unlink_file
+ * Files: mmap.c/h, filesys.c/h
+ */
+#define MMAP_TEST_BLOCKS	3
+#define MMAP_TEST_MAX		(FOUR_KB*16)
+int mmap_test() {
+	TEST_HEADER;
+
+	static uint8_t expect[MMAP_TEST_MAX];
+	static uint8_t block[FOUR_KB];
+	dentry_t dentry, other;
+	pcb_t* saved = cur_pcb;
+	pcb_t* task;
+	uint8_t* mapped;
+	uint8_t* run_ptr;
+	uint32_t cow_before, cow_after;
+	uint32_t idx;
+	int32_t size = 0;
+	int created = 0;
+	int result = PASS;
+
+	if ((task = sched_new_task()) == NULL) {
+		return FAIL;
+	}
+	cur_pcb = task;
+	mmap_load(task);
+
+	if (get_fs_flags() & FS_WRITABLE) {
+		if (create_file((uint8_t*) "mmap_a") != 0 || create_file((uint8_t*) "mmap_b") != 0 ||
+			read_dentry_by_name((uint8_t*) "mmap_a", &dentry) != 0 ||
+			read_dentry_by_name((uint8_t*) "mmap_b", &other) != 0) {
+			result = FAIL;
+		}
+		created = (result == PASS);
+		for (idx = 0; created && idx < MMAP_TEST_BLOCKS; idx++) {
+			memset(block, 'a' + idx, FOUR_KB);
+			block[idx] = 0;
+			if (write_data(dentry.inode_num, idx*FOUR_KB, block, FOUR_KB) != FOUR_KB ||
+				write_data(other.inode_num, idx*FOUR_KB, block, FOUR_KB) != FOUR_KB) {
+				result = FAIL;
+			}
+		}
+		size = created ? get_file_size(&dentry) : 0;
+	}
+	else {
+		for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++) {
+			size = get_file_size(&dentry);
+			if (dentry.filetype == REG_FILE && size > FOUR_KB && size <= MMAP_TEST_MAX) {
+				break;
+			}
+			size = 0;
+		}
+	}
+
+	if (get_fs_flags() & (FS_COMPRESSED | FS_DISK)) {
+		/* the data isn't in memory to map */
+		if (size > 0 && mmap_file(dentry.inode_num, &mapped) != -1) {
+			result = FAIL;
+		}
+	}
+	else if (size <= FOUR_KB || read_data(dentry.inode_num, 0, expect, size) != size) {
+		printf("no file of more than one block\n");
+		result = (created || (get_fs_flags() & FS_WRITABLE)) ? FAIL : result;
+	}
+	else {
+		if (get_data_run(dentry.inode_num, 0, &run_ptr) >= size) {
+			printf("the file's blocks are consecutive\n");
+			result = created ? FAIL : result;
+		}
+		mmap_usage(NULL, &cow_before);
+		if (mmap_file(dentry.inode_num, &mapped) != size || memcmp(mapped, expect, size) != 0) {
+			result = FAIL;
+		}
+		else {
+			if (created && unlink_file((uint8_t*) "mmap_a") != -1) {
+				result = FAIL;
+			}
+			mapped[FOUR_KB] = ~expect[FOUR_KB];
+			mmap_usage(NULL, &cow_after);
+			if (mapped[FOUR_KB] != (uint8_t) ~expect[FOUR_KB] || cow_after != cow_before + 1 ||
+				memcmp(mapped, expect, FOUR_KB) != 0 ||
+				read_data(dentry.inode_num, FOUR_KB, block, 1) != 1 || block[0] != expect[FOUR_KB]) {
+				result = FAIL;
+			}
+		}
+		mmap_release(task);
+		mmap_usage(NULL, &cow_after);
+		if (cow_after != cow_before) {
+			result = FAIL;
+		}
+	}
+
+	if (created && (unlink_file((uint8_t*) "mmap_a") != 0 || unlink_file((uint8_t*) "mmap_b") != 0)) {
+		result = FAIL;
+	}
+	cur_pcb = saved;
+	mmap_load(saved);
+	sched_release_task(task);
+	sched_free_task(task);
+	return result;
+}
+
+void terminal_tests(){
+    terminal_open(0, 0);
+	char input[129];
+	while(1){
+	terminal_read(0, input, 128);
+	terminal_write(0, input, 128);
+	}
+}
+
+/* Checkpoint 3 tests */
+/* Checkpoint 4 tests */
+/* Checkpoint 5 tests */
+
+
+/* Test suite entry point */
+void launch_tests(){
+ 	// TEST_OUTPUT("idt_test", idt_test());
+	// launch your tests here
+	// TEST_OUTPUT("idt_test", idt_test());
+	// TEST_OUTPUT("rtc test", rtc_test());
+	//TEST_OUTPUT("keyboard test", keyboard_test());
+	//TEST_OUTPUT("Exception Test", exception_test());
+
+	//paging_dereferencing_test();
+	//paging_test();
+
+	clear();
+//	rtc_test_driver();
+//	terminal_tests();
+//	dir_close_test();
+//	dir_open_test();
+	dir_read_test();
+//	dir_write_test();
+//	file_close_test();
+//	file_open_test();
+//	file_read_test();
+// 	file_write_test();
+//	TEST_OUTPUT("dentry lookup test", dentry_lookup_test());
+//	TEST_OUTPUT("read data benchmark", read_data_bench_test());
+//	TEST_OUTPUT("filesystem write test", filesys_write_test());
+//	TEST_OUTPUT("directory chain test", dir_chain_test());
+//	TEST_OUTPUT("getdents test", dir_getdents_test());
+//	TEST_OUTPUT("seek test", file_seek_test());
+//	TEST_OUTPUT("stat test", stat_test());
+//	TEST_OUTPUT("compressed read test", compressed_read_test());
+//	TEST_OUTPUT("shared data test", shared_data_test());
+//	TEST_OUTPUT("interleaved read test", interleaved_read_test());
+//	TEST_OUTPUT("vfs test", vfs_test());
+//	TEST_OUTPUT("tmpfs test", tmpfs_test());
+//	TEST_OUTPUT("procfs test", procfs_test());
+//	TEST_OUTPUT("ata test", ata_test());
+//	TEST_OUTPUT("virtio blk test", virtio_blk_test());
+//	TEST_OUTPUT("sendfile test", sendfile_test());
+//	TEST_OUTPUT("scheduler test", sched_test());
+//	TEST_OUTPUT("virtual terminal test", terminal_switch_test());
+//	TEST_OUTPUT("process allocation test", task_alloc_test());
+//	TEST_OUTPUT("frame allocator test", frame_alloc_test());
+//	TEST_OUTPUT("slab allocator test", slab_test());
+	/* needs a writable image to build a file with scattered blocks */
+	if (get_fs_flags() & FS_WRITABLE) {
+		TEST_OUTPUT("mmap test", mmap_test());
+	}
 	while(1){}
 }
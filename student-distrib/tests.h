@@ -22,4 +22,27 @@ void file_open_test();
 void file_read_test();
 void file_write_test();
 
+int dentry_lookup_test();
+int read_data_bench_test();
+int filesys_write_test();
+int dir_chain_test();
+int dir_getdents_test();
+int file_seek_test();
+int stat_test();
+int compressed_read_test();
+int shared_data_test();
+int interleaved_read_test();
+int vfs_test();
+int tmpfs_test();
+int procfs_test();
+int ata_test();
+int virtio_blk_test();
+int sendfile_test();
+int sched_test();
+int terminal_switch_test();
+int task_alloc_test();
+int frame_alloc_test();
+int slab_test();
+int mmap_test();
+
 #endif /* TESTS_H */
@@ -0,0 +1,645 @@
+#include "tmpfs.h"
+#include "vfs.h"
+#include "slab.h"
+
+/* the page pool; free pages are kept on a stack so allocating and freeing one is O(1) */
+static uint8_t tmpfs_mem[TMPFS_PAGES][FOUR_KB] __attribute__((aligned(FOUR_KB)));
+static uint16_t free_stack[TMPFS_PAGES];            /* indices of the free pages                */
+static uint32_t n_free;                             /* pages on free_stack                      */
+
+/* each file is an object from file_cache; a NULL entry is a free slot */
+static tmpfs_file_t* files[TMPFS_MAX_FILES];
+static kmem_cache_t* file_cache;
+
+static fd_ops_t tmpfs_file_table = {&tmpfs_open, &tmpfs_close, &tmpfs_read, &tmpfs_write, &tmpfs_lseek,
+                                    &tmpfs_pread, NULL, &tmpfs_truncate, &tmpfs_fstat};
+static fd_ops_t tmpfs_dir_table = {&tmpfs_dir_open, &tmpfs_dir_close, &tmpfs_dir_read, &tmpfs_dir_write,
+                                   NULL, NULL, &tmpfs_dir_getdents};
+
+/*
+ * find_file
+ * DESCRIPTION: looks a name up among the files
+ * INPUTS: name: the name
+ * OUTPUTS: none
+ * RETURN VALUE: index of the file, or -1 if there's none by that name
+ */
+static int32_t find_file(const uint8_t* name) {
+    int32_t idx;
+
+    if (name[0] == '\0') {
+        return -1;
+    }
+    for (idx = 0; idx < TMPFS_MAX_FILES; idx++) {
+        if (files[idx] != NULL && strncmp((int8_t*) files[idx]->name, (int8_t*) name, NAME_LEN + 1) == 0) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/*
+ * fd_desc
+ * DESCRIPTION: checks a descriptor of the current process is open on tmpfs
+ * INPUTS: fd: the descriptor
+ *         ops: tmpfs_file_table or tmpfs_dir_table, whichever the descriptor must have
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor, or NULL if fd isn't open on ops
+ */
+static file_desc_t* fd_desc(int32_t fd, fd_ops_t* ops) {
+    file_desc_t* desc;
+
+    if (fd < FD_FIRST || fd >= MAX_FDS) {
+        return NULL;
+    }
+    desc = &(cur_pcb->file_array)[fd];
+    if ((desc->flags & USE_MASK) == 0 || desc->file_op_ptr != ops) {
+        return NULL;
+    }
+    return desc;
+}
+
+/*
+ * fd_file
+ * DESCRIPTION: finds the file behind a descriptor of the current process
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: the file, or NULL if fd isn't open on a tmpfs file
+ */
+static tmpfs_file_t* fd_file(int32_t fd) {
+    file_desc_t* desc;
+
+    if ((desc = fd_desc(fd, &tmpfs_file_table)) == NULL || desc->inode >= TMPFS_MAX_FILES) {
+        return NULL;
+    }
+    return files[desc->inode];
+}
+
+/*
+ * file_ctor
+ * DESCRIPTION: sets up a file_cache object as an empty file with no name, the state unlink
+ *              leaves it in before freeing it
+ * INPUTS: obj: the file
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void file_ctor(void* obj) {
+    tmpfs_file_t* file = (tmpfs_file_t*) obj;
+
+    file->name[0] = '\0';
+    file->length = 0;
+    file->n_pages = 0;
+    file->n_open = 0;
+}
+
+/*
+ * free_pages_from
+ * DESCRIPTION: returns the pages of a file from a page index on to the pool
+ * INPUTS: file: the file
+ *         first: first page to free
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+static void free_pages_from(tmpfs_file_t* file, uint32_t first) {
+    while (file->n_pages > first) {
+        free_stack[n_free++] = file->pages[--file->n_pages];
+    }
+}
+
+/*
+ * read_at
+ * DESCRIPTION: copies data out of a file a page at a time
+ * INPUTS: file: the file
+ *         offset: byte offset to start at
+ *         buf: where to copy to
+ *         length: bytes wanted
+ * OUTPUTS: none
+ * RETURN VALUE: bytes copied, 0 at or past the end of the file
+ */
+static int32_t read_at(tmpfs_file_t* file, uint32_t offset, uint8_t* buf, uint32_t length) {
+    uint32_t copied;
+    uint32_t chunk;
+
+    if (offset >= file->length) {
+        return 0;
+    }
+    if (length > file->length - offset) {
+        length = file->length - offset;
+    }
+
+    for (copied = 0; copied < length; copied += chunk) {
+        chunk = FOUR_KB - (offset + copied) % FOUR_KB;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        memcpy(buf + copied, tmpfs_mem[file->pages[(offset + copied) / FOUR_KB]] + (offset + copied) % FOUR_KB, chunk);
+    }
+    return copied;
+}
+
+/*
+ * write_at
+ * DESCRIPTION: copies data into a file a page at a time, taking pages from the pool as it grows;
+ *              files can't have holes, so the offset has to be within the file or at its end
+ * INPUTS: file: the file
+ *         offset: byte offset to start at
+ *         buf: data to write
+ *         length: bytes to write
+ * OUTPUTS: none
+ * RETURN VALUE: bytes written, short if the pool or the file's page list ran out, or -1 if
+ *               nothing could be written
+ */
+static int32_t write_at(tmpfs_file_t* file, uint32_t offset, const uint8_t* buf, uint32_t length) {
+    uint32_t copied;
+    uint32_t chunk;
+    uint32_t end;
+
+    if (offset > file->length) {
+        return -1;
+    }
+    if (length > TMPFS_FILE_PAGES*FOUR_KB - offset) {
+        length = TMPFS_FILE_PAGES*FOUR_KB - offset;
+    }
+
+    /* grow first, so the copy below never stops halfway through a page */
+    end = offset + length;
+    while (file->n_pages*FOUR_KB < end && n_free != 0) {
+        file->pages[file->n_pages++] = free_stack[--n_free];
+    }
+    if (end > file->n_pages*FOUR_KB) {
+        end = file->n_pages*FOUR_KB;
+    }
+    if (end <= offset && length != 0) {
+        return -1;
+    }
+    length = end - offset;
+
+    for (copied = 0; copied < length; copied += chunk) {
+        chunk = FOUR_KB - (offset + copied) % FOUR_KB;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        memcpy(tmpfs_mem[file->pages[(offset + copied) / FOUR_KB]] + (offset + copied) % FOUR_KB, buf + copied, chunk);
+    }
+    if (end > file->length) {
+        file->length = end;
+    }
+    return copied;
+}
+
+/*
+ * tmpfs_init
+ * DESCRIPTION: empties the filesystem and puts every page in the pool, making the file cache
+ *              the first time
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void tmpfs_init(void) {
+    uint32_t idx;
+
+    if (file_cache == NULL) {
+        file_cache = kmem_cache_create("tmpfs_file", sizeof(tmpfs_file_t), &file_ctor);
+    }
+    for (idx = 0; idx < TMPFS_MAX_FILES; idx++) {
+        if (files[idx] != NULL) {
+            file_ctor(files[idx]);
+            kmem_cache_free(file_cache, files[idx]);
+            files[idx] = NULL;
+        }
+    }
+    /* hand out low pages first */
+    for (n_free = 0; n_free < TMPFS_PAGES; n_free++) {
+        free_stack[n_free] = TMPFS_PAGES - 1 - n_free;
+    }
+}
+
+/*
+ * tmpfs_free_pages
+ * DESCRIPTION: counts the pages not held by any file
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: pages left in the pool
+ */
+uint32_t tmpfs_free_pages(void) {
+    return n_free;
+}
+
+/*
+ * tmpfs_lookup
+ * DESCRIPTION: picks the operations for opening a name: the directory for "", else a file
+ * INPUTS: name: name relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: the operations, or NULL if there's no such file
+ */
+static fd_ops_t* tmpfs_lookup(const uint8_t* name) {
+    if (name[0] == '\0') {
+        return &tmpfs_dir_table;
+    }
+    return (find_file(name) >= 0) ? &tmpfs_file_table : NULL;
+}
+
+/* scratch files in memory, mounted at TMPFS_MOUNT by the kernel */
+vfs_fs_t tmpfs_fs = {&tmpfs_lookup, &tmpfs_stat, &tmpfs_create, &tmpfs_unlink};
+
+/*
+ * tmpfs_stat
+ * DESCRIPTION: fills in the type, index, size and page count of a file, or the type of the
+ *              directory
+ * INPUTS: name: name relative to the mount point
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there's no such file
+ */
+int32_t tmpfs_stat(const uint8_t* name, stat_t* st) {
+    int32_t idx;
+
+    if (name == NULL || st == NULL) {
+        return -1;
+    }
+    if (name[0] == '\0') {
+        st->type = DIR_FILE;
+        st->inode = 0;
+        st->size = 0;
+        st->blocks = 0;
+        return 0;
+    }
+    if ((idx = find_file(name)) < 0) {
+        return -1;
+    }
+    st->type = REG_FILE;
+    st->inode = idx;
+    st->size = files[idx]->length;
+    st->blocks = files[idx]->n_pages;
+    return 0;
+}
+
+/*
+ * tmpfs_create
+ * DESCRIPTION: adds an empty file; it takes no pages until it is written
+ * INPUTS: name: 1 to NAME_LEN characters, no separators
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the name is invalid or taken, there are too many files or
+ *               there's no memory for one
+ */
+int32_t tmpfs_create(const uint8_t* name) {
+    uint32_t len;
+    uint32_t it;
+    int32_t idx;
+
+    if (name == NULL || (len = strlen((int8_t*) name)) == 0 || len > NAME_LEN || find_file(name) >= 0) {
+        return -1;
+    }
+    for (it = 0; it < len; it++) {
+        if (name[it] == PATH_SEP) {
+            return -1;
+        }
+    }
+
+    for (idx = 0; idx < TMPFS_MAX_FILES; idx++) {
+        if (files[idx] == NULL) {
+            if ((files[idx] = kmem_cache_alloc(file_cache)) == NULL) {
+                return -1;
+            }
+            strncpy((int8_t*) files[idx]->name, (int8_t*) name, NAME_LEN + 1);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * tmpfs_unlink
+ * DESCRIPTION: removes a file no descriptor is open on and gives its pages back to the pool
+ * INPUTS: name: name relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there's no such file or it is open
+ */
+int32_t tmpfs_unlink(const uint8_t* name) {
+    int32_t idx;
+
+    if (name == NULL || (idx = find_file(name)) < 0 || files[idx]->n_open != 0) {
+        return -1;
+    }
+    free_pages_from(files[idx], 0);
+    file_ctor(files[idx]);
+    kmem_cache_free(file_cache, files[idx]);
+    files[idx] = NULL;
+    return 0;
+}
+
+/*
+ * tmpfs_open
+ * DESCRIPTION: open operation for tmpfs files
+ * INPUTS: fd: free descriptor to set up, picked by the caller
+ *         name: name relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there's no such file
+ */
+int32_t tmpfs_open(int32_t fd, const uint8_t* name) {
+    int32_t idx;
+
+    if (fd < FD_FIRST || fd >= MAX_FDS || name == NULL || (idx = find_file(name)) < 0) {
+        return -1;
+    }
+    files[idx]->n_open++;
+    (cur_pcb->file_array)[fd].inode = idx;
+    (cur_pcb->file_array)[fd].file_pos = 0;
+    (cur_pcb->file_array)[fd].flags = USE_MASK | (REG_FILE << TYPE_SHIFT);
+    return 0;
+}
+
+/*
+ * tmpfs_close
+ * DESCRIPTION: close operation for tmpfs files
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if fd isn't an open tmpfs file
+ */
+int32_t tmpfs_close(int32_t fd) {
+    tmpfs_file_t* file;
+
+    if ((file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+    file->n_open--;
+    (cur_pcb->file_array)[fd].flags = 0;
+    return 0;
+}
+
+/*
+ * tmpfs_read
+ * DESCRIPTION: read operation for tmpfs files; reads at the file position and moves it on
+ * INPUTS: fd: the descriptor
+ *         buf: where to copy to
+ *         nbytes: bytes wanted
+ * OUTPUTS: none
+ * RETURN VALUE: bytes read, 0 at the end of the file, -1 on failure
+ */
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes) {
+    tmpfs_file_t* file;
+    int32_t ret_val;
+
+    if (buf == NULL || nbytes < 0 || (file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+    ret_val = read_at(file, (cur_pcb->file_array)[fd].file_pos, buf, nbytes);
+    (cur_pcb->file_array)[fd].file_pos += ret_val;
+    return ret_val;
+}
+
+/*
+ * tmpfs_write
+ * DESCRIPTION: write operation for tmpfs files; writes at the file position, growing the file
+ *              when they reach past its end, and moves the position on
+ * INPUTS: fd: the descriptor
+ *         buf: data to write
+ *         nbytes: bytes to write
+ * OUTPUTS: none
+ * RETURN VALUE: bytes written, or -1 on failure
+ */
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes) {
+    tmpfs_file_t* file;
+    int32_t ret_val;
+
+    if (buf == NULL || nbytes < 0 || (file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+    ret_val = write_at(file, (cur_pcb->file_array)[fd].file_pos, buf, nbytes);
+    if (ret_val > 0) {
+        (cur_pcb->file_array)[fd].file_pos += ret_val;
+    }
+    return ret_val;
+}
+
+/*
+ * tmpfs_lseek
+ * DESCRIPTION: moves the file position of a tmpfs file, within the file or to its end
+ * INPUTS: fd: the descriptor
+ *         offset: byte offset relative to whence
+ *         whence: SEEK_SET, SEEK_CUR or SEEK_END
+ * OUTPUTS: none
+ * RETURN VALUE: the new file position, or -1 on failure
+ */
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence) {
+    tmpfs_file_t* file;
+    uint32_t base;
+
+    if ((file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = (cur_pcb->file_array)[fd].file_pos;
+            break;
+        case SEEK_END:
+            base = file->length;
+            break;
+        default:
+            return -1;
+    }
+
+    if ((offset < 0 && (uint32_t) -offset > base) || base + offset > file->length) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].file_pos = base + offset;
+    return base + offset;
+}
+
+/*
+ * tmpfs_pread
+ * DESCRIPTION: reads a tmpfs file at an offset, leaving the file position alone
+ * INPUTS: fd: the descriptor
+ *         buf: where to copy to
+ *         nbytes: bytes wanted
+ *         offset: byte offset from the start of the file
+ * OUTPUTS: none
+ * RETURN VALUE: bytes read, 0 at or past the end of the file, -1 on failure
+ */
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset) {
+    tmpfs_file_t* file;
+
+    if (buf == NULL || nbytes < 0 || (file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+    return read_at(file, offset, buf, nbytes);
+}
+
+/*
+ * tmpfs_truncate
+ * DESCRIPTION: shortens a tmpfs file, giving the pages past its new end back to the pool and
+ *              pulling the file position back if needed
+ * INPUTS: fd: the descriptor
+ *         length: new length, at most the current one
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t tmpfs_truncate(int32_t fd, uint32_t length) {
+    tmpfs_file_t* file;
+
+    if ((file = fd_file(fd)) == NULL || length > file->length) {
+        return -1;
+    }
+    file->length = length;
+    free_pages_from(file, (length + FOUR_KB - 1) / FOUR_KB);
+    if ((cur_pcb->file_array)[fd].file_pos > length) {
+        (cur_pcb->file_array)[fd].file_pos = length;
+    }
+    return 0;
+}
+
+/*
+ * tmpfs_fstat
+ * DESCRIPTION: fills in file information for an open tmpfs file
+ * INPUTS: fd: the descriptor
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t tmpfs_fstat(int32_t fd, stat_t* st) {
+    tmpfs_file_t* file;
+
+    if (st == NULL || (file = fd_file(fd)) == NULL) {
+        return -1;
+    }
+    return tmpfs_stat(file->name, st);
+}
+
+/*
+ * tmpfs_dir_open
+ * DESCRIPTION: open operation for the tmpfs directory; the file position is the slot of the
+ *              next file to list
+ * INPUTS: fd: free descriptor to set up, picked by the caller
+ *         name: "" (the mount point)
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t tmpfs_dir_open(int32_t fd, const uint8_t* name) {
+    if (fd < FD_FIRST || fd >= MAX_FDS || name == NULL || name[0] != '\0') {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].inode = 0;
+    (cur_pcb->file_array)[fd].file_pos = 0;
+    (cur_pcb->file_array)[fd].flags = USE_MASK | (DIR_FILE << TYPE_SHIFT);
+    return 0;
+}
+
+/*
+ * tmpfs_dir_close
+ * DESCRIPTION: close operation for the tmpfs directory
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if fd isn't open on the directory
+ */
+int32_t tmpfs_dir_close(int32_t fd) {
+    if (fd_desc(fd, &tmpfs_dir_table) == NULL) {
+        return -1;
+    }
+    (cur_pcb->file_array)[fd].flags = 0;
+    return 0;
+}
+
+/*
+ * next_file
+ * DESCRIPTION: finds the next file to list from a directory descriptor's position, and moves
+ *              the position past it
+ * INPUTS: fd: an open directory descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: index of the file, or -1 at the end of the directory
+ */
+static int32_t next_file(int32_t fd) {
+    uint32_t idx;
+
+    for (idx = (cur_pcb->file_array)[fd].file_pos; idx < TMPFS_MAX_FILES; idx++) {
+        if (files[idx] != NULL) {
+            (cur_pcb->file_array)[fd].file_pos = idx + 1;
+            return idx;
+        }
+    }
+    (cur_pcb->file_array)[fd].file_pos = TMPFS_MAX_FILES;
+    return -1;
+}
+
+/*
+ * tmpfs_dir_read
+ * DESCRIPTION: read operation for the tmpfs directory; one name per call, like dir_read
+ * INPUTS: fd: the descriptor
+ *         buf: where to copy the name
+ *         nbytes: room in buf
+ * OUTPUTS: none
+ * RETURN VALUE: characters copied, 0 once every file has been listed, -1 on failure
+ */
+int32_t tmpfs_dir_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint8_t* buf_ptr = (uint8_t*) buf;
+    int32_t idx;
+    int32_t cnt;
+
+    if (buf == NULL || nbytes < 0 || fd_desc(fd, &tmpfs_dir_table) == NULL) {
+        return -1;
+    }
+    if ((idx = next_file(fd)) < 0) {
+        return 0;
+    }
+
+    for (cnt = 0; cnt < nbytes && cnt < NAME_LEN && files[idx]->name[cnt] != '\0'; cnt++) {
+        buf_ptr[cnt] = files[idx]->name[cnt];
+    }
+    if (cnt < nbytes) {
+        buf_ptr[cnt] = 0;
+    }
+    return cnt;
+}
+
+/*
+ * tmpfs_dir_write
+ * DESCRIPTION: write operation for the tmpfs directory; writing a name creates an empty file
+ * INPUTS: fd: the descriptor
+ *         buf: name of the file to create
+ *         nbytes: length of the name
+ * OUTPUTS: none
+ * RETURN VALUE: nbytes on success, or -1 on failure
+ */
+int32_t tmpfs_dir_write(int32_t fd, const void* buf, int32_t nbytes) {
+    uint8_t name[NAME_LEN + 1];
+
+    if (buf == NULL || nbytes <= 0 || nbytes > NAME_LEN || fd_desc(fd, &tmpfs_dir_table) == NULL) {
+        return -1;
+    }
+    memcpy(name, buf, nbytes);
+    name[nbytes] = 0;
+    return (tmpfs_create(name) == 0) ? nbytes : -1;
+}
+
+/*
+ * tmpfs_dir_getdents
+ * DESCRIPTION: reads as many directory records as fit in the buffer, like dir_getdents
+ * INPUTS: fd: the descriptor
+ *         buf: where to write the dirent_t records
+ *         nbytes: size of buf
+ * OUTPUTS: none
+ * RETURN VALUE: bytes written (a multiple of sizeof(dirent_t)), 0 at the end of the directory,
+ *               -1 on failure
+ */
+int32_t tmpfs_dir_getdents(int32_t fd, void* buf, int32_t nbytes) {
+    dirent_t* ent = (dirent_t*) buf;
+    uint32_t n_fit;
+    uint32_t cnt;
+    int32_t idx;
+
+    if (buf == NULL || nbytes < (int32_t) sizeof(dirent_t) || fd_desc(fd, &tmpfs_dir_table) == NULL) {
+        return -1;
+    }
+
+    n_fit = nbytes / sizeof(dirent_t);
+    for (cnt = 0; cnt < n_fit && (idx = next_file(fd)) >= 0; cnt++) {
+        memcpy(ent[cnt].name, files[idx]->name, NAME_LEN + 1);
+        ent[cnt].pad[0] = ent[cnt].pad[1] = ent[cnt].pad[2] = 0;
+        ent[cnt].type = REG_FILE;
+        ent[cnt].inode = idx;
+        ent[cnt].size = files[idx]->length;
+    }
+    return cnt * sizeof(dirent_t);
+}
@@ -0,0 +1,52 @@
+#ifndef _TMPFS_H
+#define _TMPFS_H
+
+#include "types.h"
+#include "pcb.h"
+#include "filesys.h"
+
+#ifndef TMPFS_PAGES
+#define TMPFS_PAGES         256         /* 4kB pages shared by all files (1MB)                  */
+#endif
+#define TMPFS_MAX_FILES     64          /* files that can exist at once                         */
+#define TMPFS_FILE_PAGES    TMPFS_PAGES /* pages one file can have                              */
+#define TMPFS_MOUNT         "tmp"       /* where the kernel mounts it                           */
+
+/* a file held in memory, from a slab cache; its data is in whole pages from the shared pool, */
+/* allocated as it grows */
+typedef struct tmpfs_file {
+    uint8_t name[NAME_LEN + 1];         /* 0 terminated                                         */
+    uint32_t length;                    /* bytes in the file                                    */
+    uint32_t n_pages;                   /* pages holding its data                               */
+    uint32_t n_open;                    /* descriptors open on it; it can't be unlinked until 0 */
+    uint16_t pages[TMPFS_FILE_PAGES];   /* pool index of each page, in file order               */
+} tmpfs_file_t;
+
+/* empties the filesystem and puts every page in the pool; after slab_init */
+void tmpfs_init(void);
+/* pages left in the pool */
+uint32_t tmpfs_free_pages(void);
+
+/* names relative to the mount point; "" is its directory */
+int32_t tmpfs_stat(const uint8_t* name, stat_t* st);
+int32_t tmpfs_create(const uint8_t* name);
+int32_t tmpfs_unlink(const uint8_t* name);
+
+/* file driver functions */
+int32_t tmpfs_open(int32_t fd, const uint8_t* name);
+int32_t tmpfs_close(int32_t fd);
+int32_t tmpfs_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t tmpfs_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t tmpfs_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t tmpfs_truncate(int32_t fd, uint32_t length);
+int32_t tmpfs_fstat(int32_t fd, stat_t* st);
+
+/* directory driver functions */
+int32_t tmpfs_dir_open(int32_t fd, const uint8_t* name);
+int32_t tmpfs_dir_close(int32_t fd);
+int32_t tmpfs_dir_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t tmpfs_dir_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t tmpfs_dir_getdents(int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* _TMPFS_H */
@@ -0,0 +1,285 @@
+#include "vfs.h"
+
+/* a filesystem and the path prefix it is mounted at */
+typedef struct vfs_mount {
+    uint8_t prefix[NAME_LEN + 1];   /* mount point; "" for the root                         */
+    uint32_t prefix_len;            /* strlen(prefix)                                       */
+    vfs_fs_t* fs;                   /* NULL if the slot is free                             */
+} vfs_mount_t;
+
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];
+static fd_ops_t* type_ops[VFS_MAX_TYPES];
+
+/*
+ * vfs_register_type
+ * DESCRIPTION: registers the operations for a file type, so a filesystem holding a file of that
+ *              type (a device such as the RTC) can hand opens of it to the driver
+ * INPUTS: type: file type
+ *         ops: the driver's operations
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the type is out of range
+ */
+int32_t vfs_register_type(uint32_t type, fd_ops_t* ops) {
+    if (type >= VFS_MAX_TYPES || ops == NULL) {
+        return -1;
+    }
+    type_ops[type] = ops;
+    return 0;
+}
+
+/*
+ * vfs_type_ops
+ * DESCRIPTION: looks up the operations registered for a file type
+ * INPUTS: type: file type
+ * OUTPUTS: none
+ * RETURN VALUE: the operations, or NULL if no driver registered the type
+ */
+fd_ops_t* vfs_type_ops(uint32_t type) {
+    return (type < VFS_MAX_TYPES) ? type_ops[type] : NULL;
+}
+
+/*
+ * vfs_mount
+ * DESCRIPTION: mounts a filesystem at a path prefix; paths "prefix/name" are resolved by it
+ *              as "name", and "" mounts it as the root, which resolves everything not under
+ *              another mount point. Mounting again at the same prefix replaces the filesystem
+ * INPUTS: prefix: mount point, without separators
+ *         fs: the filesystem
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the prefix is invalid or the mount table is full
+ */
+int32_t vfs_mount(const uint8_t* prefix, vfs_fs_t* fs) {
+    uint32_t len;
+    uint32_t it;
+    vfs_mount_t* slot = NULL;
+
+    if (prefix == NULL || fs == NULL || fs->lookup == NULL || (len = strlen((int8_t*) prefix)) > NAME_LEN) {
+        return -1;
+    }
+    for (it = 0; it < len; it++) {
+        if (prefix[it] == PATH_SEP) {
+            return -1;
+        }
+    }
+
+    for (it = 0; it < VFS_MAX_MOUNTS; it++) {
+        if (mounts[it].fs != NULL && mounts[it].prefix_len == len &&
+            strncmp((int8_t*) mounts[it].prefix, (int8_t*) prefix, len) == 0) {
+            slot = &mounts[it];
+            break;
+        }
+        if (mounts[it].fs == NULL && slot == NULL) {
+            slot = &mounts[it];
+        }
+    }
+    if (slot == NULL) {
+        return -1;
+    }
+
+    strncpy((int8_t*) slot->prefix, (int8_t*) prefix, NAME_LEN + 1);
+    slot->prefix_len = len;
+    slot->fs = fs;
+    return 0;
+}
+
+/*
+ * resolve
+ * DESCRIPTION: finds the filesystem a path belongs to: the mount point the path starts with,
+ *              followed by a separator or the end of the path, or else the root
+ * INPUTS: path: the path
+ *         name: where to write the rest of the path, relative to the mount point
+ * OUTPUTS: none
+ * RETURN VALUE: the filesystem, or NULL if nothing is mounted there
+ */
+static vfs_fs_t* resolve(const uint8_t* path, const uint8_t** name) {
+    vfs_mount_t* best = NULL;
+    uint32_t len;
+    uint32_t it;
+
+    for (it = 0; it < VFS_MAX_MOUNTS; it++) {
+        len = mounts[it].prefix_len;
+        if (mounts[it].fs == NULL || (best != NULL && len <= best->prefix_len)) {
+            continue;
+        }
+        if (len == 0 || (strncmp((int8_t*) path, (int8_t*) mounts[it].prefix, len) == 0 &&
+                         (path[len] == PATH_SEP || path[len] == '\0'))) {
+            best = &mounts[it];
+        }
+    }
+    if (best == NULL) {
+        return NULL;
+    }
+
+    len = best->prefix_len;
+    *name = path + len + (len != 0 && path[len] == PATH_SEP);
+    return best->fs;
+}
+
+/*
+ * vfs_open
+ * DESCRIPTION: opens a path: the filesystem it resolves to picks the operations, the first free
+ *              descriptor of the current process gets them, and the driver's open sets it up
+ * INPUTS: path: the path
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor, or -1 if the path doesn't exist, can't be opened, or the
+ *               process has no free descriptor
+ */
+int32_t vfs_open(const uint8_t* path) {
+    vfs_fs_t* fs;
+    fd_ops_t* ops;
+    const uint8_t* name;
+    file_desc_t* desc;
+    int32_t fd;
+
+    if (path == NULL || (fs = resolve(path, &name)) == NULL || (ops = fs->lookup(name)) == NULL) {
+        return -1;
+    }
+
+    for (fd = FD_FIRST; fd < MAX_FDS; fd++) {
+        if (((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) {
+            break;
+        }
+    }
+    if (fd >= MAX_FDS) {
+        return -1;
+    }
+
+    /* the driver fills in the rest; the slot stays free if it refuses */
+    desc = &(cur_pcb->file_array)[fd];
+    desc->file_op_ptr = ops;
+    desc->inode = 0;
+    desc->file_pos = 0;
+    desc->flags = 0;
+    if (ops->open_ptr(fd, name) != 0) {
+        desc->flags = 0;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * vfs_close
+ * DESCRIPTION: lets the driver release an open descriptor of the current process and frees it
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: what the driver's close returned, or -1 if fd isn't open
+ */
+int32_t vfs_close(int32_t fd) {
+    file_desc_t* desc;
+    int32_t ret;
+
+    if ((desc = vfs_get_fd(fd)) == NULL) {
+        return -1;
+    }
+    ret = desc->file_op_ptr->close_ptr(fd);
+    desc->flags = 0;
+    return ret;
+}
+
+/*
+ * vfs_get_fd
+ * DESCRIPTION: checks a descriptor of the current process is in range and open
+ * INPUTS: fd: the descriptor
+ * OUTPUTS: none
+ * RETURN VALUE: the descriptor's entry in the file array, or NULL
+ */
+file_desc_t* vfs_get_fd(int32_t fd) {
+    if (fd < 0 || fd >= MAX_FDS || ((cur_pcb->file_array)[fd].flags & USE_MASK) == 0) {
+        return NULL;
+    }
+    return &(cur_pcb->file_array)[fd];
+}
+
+/*
+ * vfs_sendfile
+ * DESCRIPTION: copies bytes from the position of one open descriptor to another inside the
+ *              kernel. Files whose operations can send themselves do it (image files pass
+ *              their data in place); anything else readable is read into a kernel buffer and
+ *              written out from there
+ * INPUTS: out_fd: descriptor to write to
+ *         in_fd: descriptor to read from; its position moves past what was sent
+ *         count: most bytes to send
+ * OUTPUTS: none
+ * RETURN VALUE: number of bytes sent, 0 at the end of in_fd, -1 on failure
+ */
+int32_t vfs_sendfile(int32_t out_fd, int32_t in_fd, uint32_t count) {
+    uint8_t buf[SENDFILE_CHUNK];
+    file_desc_t* in;
+    file_desc_t* out;
+    uint32_t sent;
+    int32_t cnt;
+    int32_t written;
+
+    if ((in = vfs_get_fd(in_fd)) == NULL || (out = vfs_get_fd(out_fd)) == NULL || out->file_op_ptr->write_ptr == NULL) {
+        return -1;
+    }
+    if (in->file_op_ptr->sendfile_ptr != NULL) {
+        return (in->file_op_ptr->sendfile_ptr)(in_fd, out_fd, count);
+    }
+
+    for (sent = 0; sent < count; sent += written) {
+        cnt = (count - sent > SENDFILE_CHUNK) ? SENDFILE_CHUNK : count - sent;
+        if ((cnt = (in->file_op_ptr->read_ptr)(in_fd, buf, cnt)) <= 0) {
+            return (sent == 0) ? cnt : (int32_t) sent;
+        }
+        if ((written = (out->file_op_ptr->write_ptr)(out_fd, buf, cnt)) <= 0) {
+            return (sent == 0) ? written : (int32_t) sent;
+        }
+        if (written < cnt) {
+            return sent + written;
+        }
+    }
+    return sent;
+}
+
+/*
+ * vfs_stat
+ * DESCRIPTION: fills in file information for a path
+ * INPUTS: path: the path
+ *         st: where to write the information
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if the path doesn't exist or its filesystem can't stat
+ */
+int32_t vfs_stat(const uint8_t* path, stat_t* st) {
+    vfs_fs_t* fs;
+    const uint8_t* name;
+
+    if (path == NULL || (fs = resolve(path, &name)) == NULL || fs->stat == NULL) {
+        return -1;
+    }
+    return fs->stat(name, st);
+}
+
+/*
+ * vfs_create
+ * DESCRIPTION: adds an empty regular file at a path
+ * INPUTS: path: the path
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if it exists or its filesystem can't create files
+ */
+int32_t vfs_create(const uint8_t* path) {
+    vfs_fs_t* fs;
+    const uint8_t* name;
+
+    if (path == NULL || (fs = resolve(path, &name)) == NULL || fs->create == NULL) {
+        return -1;
+    }
+    return fs->create(name);
+}
+
+/*
+ * vfs_unlink
+ * DESCRIPTION: removes the regular file at a path
+ * INPUTS: path: the path
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if it can't be removed
+ */
+int32_t vfs_unlink(const uint8_t* path) {
+    vfs_fs_t* fs;
+    const uint8_t* name;
+
+    if (path == NULL || (fs = resolve(path, &name)) == NULL || fs->unlink == NULL) {
+        return -1;
+    }
+    return fs->unlink(name);
+}
@@ -0,0 +1,51 @@
+#ifndef _VFS_H
+#define _VFS_H
+
+#include "types.h"
+#include "pcb.h"
+#include "filesys.h"
+
+#define FD_FIRST        2           /* first descriptor open hands out                          */
+#define VFS_MAX_MOUNTS  8           /* filesystems that can be mounted at once                  */
+#define VFS_MAX_TYPES   4           /* file types a driver can register operations for          */
+#define TERMINAL_FILE   3           /* file type of stdin and stdout; never in a directory      */
+#define PATH_SEP        '/'         /* separates a mount point from the name below it           */
+
+/*
+ * A mounted filesystem. Names passed in are relative to the mount point ("" is the mount point
+ * itself); entries other than lookup are NULL when the filesystem doesn't support them.
+ */
+typedef struct vfs_fs {
+    fd_ops_t* (*lookup)(const uint8_t* name);           /* operations for opening name, or NULL */
+    int32_t (*stat)(const uint8_t* name, stat_t* st);   /* file information by name             */
+    int32_t (*create)(const uint8_t* name);             /* adds an empty regular file           */
+    int32_t (*unlink)(const uint8_t* name);             /* removes a regular file               */
+} vfs_fs_t;
+
+/* filesystems that can be mounted */
+extern vfs_fs_t image_fs;                               /* the boot module image, filesys.c     */
+extern vfs_fs_t tmpfs_fs;                               /* scratch files in memory, tmpfs.c     */
+extern vfs_fs_t procfs_fs;                              /* kernel statistics, procfs.c          */
+
+/* registers the operations for a file type a filesystem can't open itself (devices) */
+int32_t vfs_register_type(uint32_t type, fd_ops_t* ops);
+/* operations registered for a file type, or NULL */
+fd_ops_t* vfs_type_ops(uint32_t type);
+/* mounts a filesystem at a path prefix; "" is the root */
+int32_t vfs_mount(const uint8_t* prefix, vfs_fs_t* fs);
+
+/* opens a path in the current process; returns the descriptor */
+int32_t vfs_open(const uint8_t* path);
+/* closes a descriptor of the current process */
+int32_t vfs_close(int32_t fd);
+/* open descriptor fd of the current process, or NULL */
+file_desc_t* vfs_get_fd(int32_t fd);
+/* copies bytes from one descriptor's position to another without a user buffer */
+int32_t vfs_sendfile(int32_t out_fd, int32_t in_fd, uint32_t count);
+
+/* file information, creation and removal by path */
+int32_t vfs_stat(const uint8_t* path, stat_t* st);
+int32_t vfs_create(const uint8_t* path);
+int32_t vfs_unlink(const uint8_t* path);
+
+#endif /* _VFS_H */
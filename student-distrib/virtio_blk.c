@@ -0,0 +1,318 @@
+#include "virtio_blk.h"
+#include "pci.h"
+#include "lib.h"
+
+cache_backend_t virtio_blk_backend = {&virtio_blk_read_block, &virtio_blk_write_block, &virtio_blk_read_blocks};
+
+/* the one virtqueue: descriptor table, avail ring, then the used ring on the next page */
+static uint8_t queue_mem[VIRTQ_BYTES] __attribute__((aligned(VIRTQ_ALIGN)));
+static virtq_desc_t* desc;
+static volatile virtq_avail_t* avail;
+static volatile virtq_used_t* used;
+static uint32_t queue_size;             /* entries in each ring, set by the device              */
+static uint32_t batch_max;              /* requests that fit in the queue at once               */
+static uint16_t last_used;              /* used ring entries the interrupt handler has taken    */
+
+static uint32_t io_base;                /* legacy registers, 0 if there is no device            */
+static uint32_t n_blocks;               /* 4kB blocks on the disk, 0 if there is none           */
+static int32_t read_only;
+static int32_t irq_registered;
+static blk_stats_t stats;
+
+/* request i of a batch uses descriptors VIRTIO_BLK_DESCS * i and on, and these */
+static virtio_blk_req_t headers[VIRTIO_BLK_BATCH];
+static volatile uint8_t statuses[VIRTIO_BLK_BATCH];
+
+/* the batch in flight, completed by the interrupt handler */
+static volatile uint32_t batch_done;
+static volatile uint32_t batch_failed;
+static uint32_t batch_start;
+
+/*
+ * run_batch
+ * DESCRIPTION: posts one request per block, each a chain of header, data and status
+ *              descriptors, rings the doorbell once for all of them and waits for the
+ *              interrupt handler to see them all completed
+ * INPUTS: blocks: block number of each request, all on the disk
+ *         bufs: one CACHE_BLOCK_SIZE buffer per request
+ *         count: number of requests, 1 to batch_max
+ *         write: nonzero to write the buffers to the disk
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if every request succeeded, else -1
+ */
+static int32_t run_batch(const uint32_t* blocks, uint8_t** bufs, uint32_t count, int32_t write) {
+    uint32_t head;
+    uint32_t spins;
+    uint32_t it;
+
+    for (it = 0; it < count; it++) {
+        head = it * VIRTIO_BLK_DESCS;
+        headers[it].type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+        headers[it].reserved = 0;
+        headers[it].sector = blocks[it] * VIRTIO_BLOCK_SECTORS;
+        headers[it].sector_high = 0;
+        statuses[it] = VIRTIO_BLK_S_NONE;
+
+        desc[head].addr = (uint32_t) &headers[it];
+        desc[head].addr_high = 0;
+        desc[head].len = sizeof(virtio_blk_req_t);
+        desc[head].flags = VIRTQ_DESC_F_NEXT;
+        desc[head].next = head + 1;
+
+        desc[head + 1].addr = (uint32_t) bufs[it];
+        desc[head + 1].addr_high = 0;
+        desc[head + 1].len = CACHE_BLOCK_SIZE;
+        desc[head + 1].flags = VIRTQ_DESC_F_NEXT | (write ? 0 : VIRTQ_DESC_F_WRITE);
+        desc[head + 1].next = head + 2;
+
+        desc[head + 2].addr = (uint32_t) &statuses[it];
+        desc[head + 2].addr_high = 0;
+        desc[head + 2].len = 1;
+        desc[head + 2].flags = VIRTQ_DESC_F_WRITE;
+        desc[head + 2].next = 0;
+
+        avail->ring[(avail->idx + it) % queue_size] = head;
+    }
+
+    batch_done = 0;
+    batch_failed = 0;
+    batch_start = rdtsc();
+
+    /* the descriptors must be in memory before the device can see the new index */
+    asm volatile ("" : : : "memory");
+    avail->idx += count;
+    outw(0, io_base + VIRTIO_REG_QUEUE_NOTIFY);
+    stats.submits++;
+
+    for (spins = 0; spins < VIRTIO_BLK_TIMEOUT; spins++) {
+        cli();
+        if (batch_done == count) {
+            sti();
+            return batch_failed ? -1 : 0;
+        }
+        sti();
+    }
+
+    /* the device still owns the buffers; resetting it makes it let go, and it isn't used again */
+    outb(0, io_base + VIRTIO_REG_STATUS);
+    stats.errors += count - batch_done;
+    stats.requests += count - batch_done;
+    n_blocks = 0;
+    return -1;
+}
+
+/*
+ * virtio_blk_init
+ * DESCRIPTION: finds the virtio block device among the PCI functions, resets it, gives it the
+ *              queue memory and hooks its interrupt line
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if there is a virtio disk to use, else -1
+ */
+int32_t virtio_blk_init(void) {
+    pci_dev_t* pdev;
+    uint32_t base;
+    uint32_t used_offset;
+
+    n_blocks = 0;
+    io_base = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    if ((pdev = pci_find(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE)) == NULL || (base = pci_io_base(pdev, VIRTIO_BAR)) == 0) {
+        return -1;
+    }
+    pci_enable(pdev);
+
+    outb(0, base + VIRTIO_REG_STATUS);
+    outb(VIRTIO_STATUS_ACK, base + VIRTIO_REG_STATUS);
+    outb(VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER, base + VIRTIO_REG_STATUS);
+
+    /* none of the optional features are needed; without a flush feature, writes are write-through */
+    read_only = (inl(base + VIRTIO_REG_DEVICE_FEATURES) & VIRTIO_BLK_F_RO) != 0;
+    outl(0, base + VIRTIO_REG_GUEST_FEATURES);
+
+    outw(0, base + VIRTIO_REG_QUEUE_SELECT);
+    queue_size = inw(base + VIRTIO_REG_QUEUE_SIZE);
+    if (queue_size < VIRTIO_BLK_DESCS || queue_size > VIRTQ_MAX_SIZE) {
+        outb(0, base + VIRTIO_REG_STATUS);
+        return -1;
+    }
+
+    /* legacy layout: the used ring starts on the first page boundary after the avail ring */
+    memset(queue_mem, 0, sizeof(queue_mem));
+    used_offset = sizeof(virtq_desc_t) * queue_size + 3 * sizeof(uint16_t) + sizeof(uint16_t) * queue_size;
+    used_offset = (used_offset + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+    desc = (virtq_desc_t*) queue_mem;
+    avail = (virtq_avail_t*) (queue_mem + sizeof(virtq_desc_t) * queue_size);
+    used = (virtq_used_t*) (queue_mem + used_offset);
+    last_used = 0;
+    batch_max = queue_size / VIRTIO_BLK_DESCS;
+    if (batch_max > VIRTIO_BLK_BATCH) {
+        batch_max = VIRTIO_BLK_BATCH;
+    }
+
+    if (!irq_registered && pci_set_irq_handler(pdev, &virtio_blk_handler) != 0) {
+        outb(0, base + VIRTIO_REG_STATUS);
+        return -1;
+    }
+    irq_registered = 1;
+
+    outl((uint32_t) queue_mem / VIRTQ_ALIGN, base + VIRTIO_REG_QUEUE_PFN);
+    outb(VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK, base + VIRTIO_REG_STATUS);
+    io_base = base;
+
+    /* blocks past what a 32-bit block number reaches aren't used */
+    if (inl(base + VIRTIO_REG_CAPACITY + 4) != 0) {
+        n_blocks = 0xFFFFFFFF / VIRTIO_BLOCK_SECTORS;
+    }
+    else {
+        n_blocks = inl(base + VIRTIO_REG_CAPACITY) / VIRTIO_BLOCK_SECTORS;
+    }
+    return (n_blocks != 0) ? 0 : -1;
+}
+
+/*
+ * virtio_blk_block_count
+ * DESCRIPTION: returns the size of the disk
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 4kB blocks on the disk, 0 if virtio_blk_init found none
+ */
+uint32_t virtio_blk_block_count(void) {
+    return n_blocks;
+}
+
+/*
+ * virtio_blk_get_stats
+ * DESCRIPTION: copies the request counters; every block is a request, and submits counts
+ *              doorbells
+ * INPUTS: out: where to copy them
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void virtio_blk_get_stats(blk_stats_t* out) {
+    if (out != NULL) {
+        *out = stats;
+    }
+}
+
+/*
+ * virtio_blk_submit
+ * DESCRIPTION: reads or writes any set of blocks, one request each, in batches of as many as
+ *              the queue holds, so the device sees one doorbell per batch
+ * INPUTS: blocks: block number of each request
+ *         bufs: one CACHE_BLOCK_SIZE buffer per request
+ *         count: number of requests
+ *         write: nonzero to write the buffers to the disk
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if a block is past the end of the disk or a request failed
+ */
+int32_t virtio_blk_submit(const uint32_t* blocks, uint8_t** bufs, uint32_t count, int32_t write) {
+    uint32_t it;
+    uint32_t n;
+
+    if (blocks == NULL || bufs == NULL || count == 0 || (write && read_only)) {
+        return -1;
+    }
+    for (it = 0; it < count; it++) {
+        if (blocks[it] >= n_blocks || bufs[it] == NULL) {
+            return -1;
+        }
+    }
+
+    for (it = 0; it < count; it += n) {
+        n = (count - it > batch_max) ? batch_max : count - it;
+        if (run_batch(blocks + it, bufs + it, n, write) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * virtio_blk_read_block
+ * DESCRIPTION: block cache backend; reads one 4kB block
+ * INPUTS: block: block number on the disk
+ *         buf: CACHE_BLOCK_SIZE buffer to read to
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t virtio_blk_read_block(uint32_t block, uint8_t* buf) {
+    return virtio_blk_submit(&block, &buf, 1, 0);
+}
+
+/*
+ * virtio_blk_write_block
+ * DESCRIPTION: block cache backend; writes one 4kB block
+ * INPUTS: block: block number on the disk
+ *         buf: CACHE_BLOCK_SIZE buffer to write from
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t virtio_blk_write_block(uint32_t block, const uint8_t* buf) {
+    return virtio_blk_submit(&block, (uint8_t**) &buf, 1, 1);
+}
+
+/*
+ * virtio_blk_read_blocks
+ * DESCRIPTION: block cache backend; reads consecutive blocks with one doorbell per batch,
+ *              for readahead
+ * INPUTS: block: first block number on the disk
+ *         count: number of blocks
+ *         bufs: one CACHE_BLOCK_SIZE buffer per block
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ */
+int32_t virtio_blk_read_blocks(uint32_t block, uint32_t count, uint8_t** bufs) {
+    uint32_t blocks[VIRTIO_BLK_BATCH];
+    uint32_t done;
+    uint32_t n;
+    uint32_t it;
+
+    if (bufs == NULL) {
+        return -1;
+    }
+    for (done = 0; done < count; done += n) {
+        n = (count - done > VIRTIO_BLK_BATCH) ? VIRTIO_BLK_BATCH : count - done;
+        for (it = 0; it < n; it++) {
+            blocks[it] = block + done + it;
+        }
+        if (virtio_blk_submit(blocks, bufs + done, n, 0) != 0) {
+            return -1;
+        }
+    }
+    return (count != 0) ? 0 : -1;
+}
+
+/*
+ * virtio_blk_handler
+ * DESCRIPTION: interrupt handler; reading the ISR acknowledges the device, then every request
+ *              the device has put on the used ring since the last interrupt is completed and
+ *              its latency counted
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ */
+void virtio_blk_handler(void) {
+    uint32_t now;
+    uint32_t req;
+
+    if (io_base == 0) {
+        return;
+    }
+    inb(io_base + VIRTIO_REG_ISR);
+
+    now = rdtsc();
+    while (last_used != used->idx) {
+        req = used->ring[last_used % queue_size].id / VIRTIO_BLK_DESCS;
+        last_used++;
+        if (req >= VIRTIO_BLK_BATCH) {
+            continue;
+        }
+        if (statuses[req] != VIRTIO_BLK_S_OK) {
+            batch_failed = 1;
+        }
+        blk_stats_add(&stats, now - batch_start, (statuses[req] == VIRTIO_BLK_S_OK) ? 1 : 0);
+        batch_done++;
+    }
+}
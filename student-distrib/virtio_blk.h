@@ -0,0 +1,106 @@
+#ifndef _VIRTIO_BLK_H
+#define _VIRTIO_BLK_H
+
+#include "types.h"
+#include "block_cache.h"
+
+/* transitional virtio block device, driven through its legacy I/O interface */
+#define VIRTIO_VENDOR       0x1AF4
+#define VIRTIO_BLK_DEVICE   0x1001
+#define VIRTIO_BAR          0           /* I/O BAR of the legacy registers                      */
+
+/* legacy register offsets, without MSI-X */
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES  0x04
+#define VIRTIO_REG_QUEUE_PFN       0x08 /* physical page of the queue memory                    */
+#define VIRTIO_REG_QUEUE_SIZE      0x0C
+#define VIRTIO_REG_QUEUE_SELECT    0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY    0x10 /* the doorbell: write the queue number                 */
+#define VIRTIO_REG_STATUS          0x12
+#define VIRTIO_REG_ISR             0x13 /* reading it acknowledges the interrupt                */
+#define VIRTIO_REG_CAPACITY        0x14 /* 64-bit count of 512 byte sectors                     */
+
+/* device status bits */
+#define VIRTIO_STATUS_ACK          0x01
+#define VIRTIO_STATUS_DRIVER       0x02
+#define VIRTIO_STATUS_DRIVER_OK    0x04
+
+#define VIRTIO_BLK_F_RO            0x00000020 /* feature: the disk is read-only             */
+
+/* virtqueue layout */
+#define VIRTQ_MAX_SIZE      256         /* largest queue the static queue memory can hold      */
+#define VIRTQ_ALIGN         0x1000      /* the used ring starts on a page boundary             */
+#define VIRTQ_BYTES         (3 * VIRTQ_ALIGN) /* descriptors, avail ring, used ring for 256    */
+#define VIRTQ_DESC_F_NEXT   0x1
+#define VIRTQ_DESC_F_WRITE  0x2         /* the device writes the buffer                         */
+
+/* requests */
+#define VIRTIO_BLK_T_IN     0
+#define VIRTIO_BLK_T_OUT    1
+#define VIRTIO_BLK_S_OK     0
+#define VIRTIO_BLK_S_NONE   0xFF        /* status before the device has answered               */
+#define VIRTIO_BLK_DESCS    3           /* descriptors per request: header, data, status       */
+#define VIRTIO_BLK_BATCH    32          /* requests posted per doorbell                         */
+#define VIRTIO_BLK_TIMEOUT  10000000    /* polls before a batch is given up on                  */
+#define VIRTIO_SECTOR_SIZE  512
+#define VIRTIO_BLOCK_SECTORS (CACHE_BLOCK_SIZE / VIRTIO_SECTOR_SIZE)
+
+/* one buffer of a request */
+typedef struct virtq_desc {
+    uint32_t addr;                      /* physical address, low half                          */
+    uint32_t addr_high;                 /* physical address, high half                         */
+    uint32_t len;
+    uint16_t flags;                     /* VIRTQ_DESC_F_*                                      */
+    uint16_t next;                      /* next descriptor if VIRTQ_DESC_F_NEXT                 */
+} virtq_desc_t;
+
+/* requests offered to the device; ring[] follows */
+typedef struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;                       /* where the driver puts the next entry, never wrapped  */
+    uint16_t ring[1];
+} virtq_avail_t;
+
+/* one request the device has finished */
+typedef struct virtq_used_elem {
+    uint32_t id;                        /* first descriptor of the request                      */
+    uint32_t len;                       /* bytes the device wrote                               */
+} virtq_used_elem_t;
+
+/* requests finished by the device; ring[] follows */
+typedef struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;                       /* where the device puts the next entry, never wrapped  */
+    virtq_used_elem_t ring[1];
+} virtq_used_t;
+
+/* header of a request, read by the device */
+typedef struct virtio_blk_req {
+    uint32_t type;                      /* VIRTIO_BLK_T_*                                       */
+    uint32_t reserved;
+    uint32_t sector;                    /* first 512 byte sector, low half                      */
+    uint32_t sector_high;
+} virtio_blk_req_t;
+
+/* finds the device, sets up its queue and unmasks its interrupt; 0 if there's a disk to use */
+int32_t virtio_blk_init(void);
+/* 4kB blocks on the disk, 0 if there is none */
+uint32_t virtio_blk_block_count(void);
+/* request counters and latencies since virtio_blk_init */
+void virtio_blk_get_stats(blk_stats_t* out);
+
+/* moves any blocks, one request per block, posting up to VIRTIO_BLK_BATCH per doorbell */
+int32_t virtio_blk_submit(const uint32_t* blocks, uint8_t** bufs, uint32_t count, int32_t write);
+
+/* block cache backend functions; buffers must be in identity mapped kernel memory */
+int32_t virtio_blk_read_block(uint32_t block, uint8_t* buf);
+int32_t virtio_blk_write_block(uint32_t block, const uint8_t* buf);
+int32_t virtio_blk_read_blocks(uint32_t block, uint32_t count, uint8_t** bufs);
+
+/* the disk as a block cache backend, for init_filesys_disk */
+extern cache_backend_t virtio_blk_backend;
+
+/* interrupt handler, called through pci_irq_handler */
+void virtio_blk_handler(void);
+
+#endif /* _VIRTIO_BLK_H */
@@ -4,7 +4,7 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
-#define SBUFSIZE 33
+#define NDIRENTS 16
 
 int32_t
 do_one_file (const char* s, const char* fname) 
@@ -67,8 +67,8 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, rec;
+    struct ece391_dirent ents[NDIRENTS];
     uint8_t search[BUFSIZE];
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
@@ -81,16 +81,17 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
-	if ('.' == buf[0]) /* a directory... */
-	    continue;
-	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
-	    return 3;
+	for (rec = 0; rec < cnt / (int32_t)sizeof (ents[0]); rec++) {
+	    if (2 != ents[rec].type) /* a directory or device... */
+		continue;
+	    if (0 != do_one_file ((char*)search, (char*)ents[rec].name))
+		return 3;
+	}
     }
 
     return 0;
@@ -4,24 +4,71 @@
 #include "ece391syscall.h"
 
 #define SBUFSIZE 33
+#define LBUFSIZE 64
+#define NDIRENTS 16
+
+/* appends s to buf right-aligned in width columns, returns the new length */
+static int32_t
+put_field (uint8_t* buf, int32_t out, const uint8_t* s, int32_t width)
+{
+    int32_t len = ece391_strlen (s);
+
+    while (width-- > len)
+        buf[out++] = ' ';
+    ece391_strcpy (buf + out, s);
+    return out + len;
+}
+
+/* appends a long listing line for one entry: type, inode, size, blocks, name */
+static int32_t
+put_long (uint8_t* buf, int32_t out, const uint8_t* name)
+{
+    struct ece391_stat st;
+    uint8_t num[SBUFSIZE];
+
+    if (0 != ece391_stat (name, &st))
+        return -1;
+
+    buf[out++] = (2 == st.type) ? '-' : (1 == st.type) ? 'd' : 'c';
+    out = put_field (buf, out, ece391_itoa (st.inode, num, 10), 6);
+    out = put_field (buf, out, ece391_itoa (st.size, num, 10), 9);
+    out = put_field (buf, out, ece391_itoa (st.blocks, num, 10), 5);
+    buf[out++] = ' ';
+    return out;
+}
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, rec, out, long_mode;
+    struct ece391_dirent ents[NDIRENTS];
+    uint8_t buf[NDIRENTS * LBUFSIZE];
+    uint8_t args[SBUFSIZE];
+
+    long_mode = (0 == ece391_getargs (args, SBUFSIZE) &&
+                 0 == ece391_strcmp (args, (uint8_t*)"-l"));
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* one getdents and one write per batch of entries */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+	    out = 0;
+	    for (rec = 0; rec < cnt / (int32_t)sizeof (ents[0]); rec++) {
+	        if (long_mode && -1 == (out = put_long (buf, out, ents[rec].name))) {
+	            ece391_fdputs (1, (uint8_t*)"stat failed\n");
+	            return 3;
+	        }
+	        ece391_strcpy (buf + out, ents[rec].name);
+	        out += ece391_strlen (ents[rec].name);
+	        buf[out++] = '\n';
+	    }
+	    if (-1 == ece391_write (1, buf, out))
 	        return 3;
     }
 
@@ -22,6 +22,66 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Maps an open regular file read-only (copy-on-write) into the caller's
+ * address space.  Returns the file length and sets *start to its first byte.
+ */
+extern int32_t ece391_mmap (int32_t fd, uint8_t** start);
+
+/*
+ * Create makes an empty regular file; unlink removes one that no process
+ * has open.  Writes to an open file start at the current file position
+ * and extend the file past its end; truncate shortens an open file.
+ */
+extern int32_t ece391_create (const uint8_t* filename);
+extern int32_t ece391_unlink (const uint8_t* filename);
+extern int32_t ece391_truncate (int32_t fd, uint32_t length);
+
+/*
+ * Reads as many directory entries as fit in buf from an open directory,
+ * one fixed-size record each.  Returns the number of bytes filled in (a
+ * multiple of sizeof (struct ece391_dirent)), or 0 at the end.
+ */
+struct ece391_dirent {
+	uint8_t name[33];	/* always NUL terminated */
+	uint8_t pad[3];
+	uint32_t type;		/* 0 rtc, 1 directory, 2 regular file */
+	uint32_t inode;
+	uint32_t size;		/* bytes, regular files only */
+};
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * Lseek moves the position of an open file (in bytes) or directory (in
+ * entries) and returns it; a file position can't go past the end of the
+ * file.  Pread reads at an offset without moving the position.
+ */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/*
+ * Stat and fstat report a file's type, inode, size and data block count
+ * without reading it.  Only regular files have an inode, size and blocks.
+ */
+struct ece391_stat {
+	uint32_t type;		/* 0 rtc, 1 directory, 2 regular file, 3 terminal */
+	uint32_t inode;
+	uint32_t size;		/* bytes */
+	uint32_t blocks;	/* 4kB data blocks */
+};
+extern int32_t ece391_stat (const uint8_t* filename, struct ece391_stat* buf);
+extern int32_t ece391_fstat (int32_t fd, struct ece391_stat* buf);
+
+/*
+ * Sendfile copies up to count bytes from the position of in_fd to out_fd
+ * inside the kernel, moving in_fd's position, and returns the bytes sent,
+ * 0 at the end of in_fd.  Nothing passes through a user buffer.
+ */
+extern int32_t ece391_sendfile (int32_t out_fd, int32_t in_fd, int32_t count);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
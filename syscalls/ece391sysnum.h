@@ -11,5 +11,15 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_MMAP    11
+#define SYS_CREATE  12
+#define SYS_UNLINK  13
+#define SYS_TRUNCATE 14
+#define SYS_GETDENTS 15
+#define SYS_LSEEK   16
+#define SYS_PREAD   17
+#define SYS_STAT    18
+#define SYS_FSTAT   19
+#define SYS_SENDFILE 20
 
 #endif /* ECE391SYSNUM_H */